@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+// Writes a tracefile of num_files source files to folder, about 35 KB each: 9000 files make 300 MB. The sources are symlinks to the same
+// 2000-line file, only read if something asks for their text
+std::filesystem::path bench_lcov_generate(std::filesystem::path folder, size_t num_files) {
+
+    const size_t num_lines = 2000;
+    const size_t lines_per_function = 20;
+
+    std::filesystem::create_directories(folder / "src");
+
+    std::ofstream source(folder / "source.c");
+    for (size_t i = 1; i <= num_lines; i++) {
+        source << "    x = x * " << i << " + 1;\n";
+    }
+    source.close();
+
+    std::filesystem::path tracefile_path = folder / "bench.info";
+    std::ofstream tracefile(tracefile_path);
+
+    for (size_t f = 0; f < num_files; f++) {
+
+        std::filesystem::path path = folder / "src" / ("file_" + std::to_string(f) + ".c");
+
+        std::error_code ec;
+        std::filesystem::create_symlink(folder / "source.c", path, ec);
+
+        tracefile << "TN:\nSF:" << path.string() << "\n";
+
+        for (size_t l = 1; l <= num_lines; l += lines_per_function) {
+            tracefile << "FN:" << l << "," << l + lines_per_function - 1 << ",function_" << f << "_" << l << "\n";
+        }
+
+        size_t functions_hit = 0;
+        for (size_t l = 1; l <= num_lines; l += lines_per_function) {
+            tracefile << "FNDA:" << (l % 3 ? l : 0) << ",function_" << f << "_" << l << "\n";
+            functions_hit += l % 3 != 0;
+        }
+        tracefile << "FNF:" << num_lines / lines_per_function << "\nFNH:" << functions_hit << "\n";
+
+        size_t taken = 0;
+        for (size_t l = 1; l <= num_lines; l += 10) {
+            tracefile << "BRDA:" << l << ",0,0," << l << "\nBRDA:" << l << ",0,1,-\n";
+            taken++;
+        }
+        tracefile << "BRF:" << taken * 2 << "\nBRH:" << taken << "\n";
+
+        size_t hit = 0;
+        for (size_t l = 1; l <= num_lines; l++) {
+            tracefile << "DA:" << l << "," << (l % 4 ? l * 1000 : 0) << "\n";
+            hit += l % 4 != 0;
+        }
+        tracefile << "LF:" << num_lines << "\nLH:" << hit << "\nend_of_record\n";
+    }
+
+    return tracefile_path;
+}
+
+void bench_lcov_parse(std::filesystem::path tracefile_path) {
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    lcov::Tracefile tracefile(tracefile_path.string());
+
+    if (!tracefile.parse()) {
+        std::cerr << "Error: could not parse " << tracefile_path << std::endl;
+        return;
+    }
+
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    auto duration = duration_cast<std::chrono::milliseconds>(stop - start);
+
+    size_t branches = 0;
+    for (const auto &sf : tracefile.sourceFiles()) {
+        branches += sf->branches().size();
+    }
+
+    double megabytes = std::filesystem::file_size(tracefile_path) / (1024.0 * 1024.0);
+
+    std::cout << "Time elapsed: " << duration.count() << " milliseconds" << std::endl;
+    std::cout << "MB/sec: " << (size_t)(megabytes / (duration.count() / 1e3)) << " (" << tracefile.sourceFiles().size() << " files, "
+              << tracefile.allFunctions().size() << " functions, " << branches << " branches)" << std::endl;
+}
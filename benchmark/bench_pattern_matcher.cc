@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+// Classifies the reports of corpus (such as benchmark/corpus/sanitizer) against each table that triage scans with a pattern_matcher: the
+// glibc heap errors, the sanitizer headers and the gdb signals. One find() per pattern versus one scan
+void bench_pattern_matcher(std::filesystem::path corpus) {
+
+    std::vector<std::string> reports;
+
+    for (const auto &entry : std::filesystem::directory_iterator(corpus)) {
+
+        std::ifstream file(entry.path(), std::ios::binary);
+
+        reports.emplace_back((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    if (reports.empty()) {
+        std::cerr << "Error: no reports in " << corpus << std::endl;
+        return;
+    }
+
+    const size_t rounds = 200000;
+
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < rounds; i++) {
+        bytes += reports[i % reports.size()].size();
+    }
+
+    auto report = [&](const std::string &name, auto classify) {
+
+        size_t found = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (size_t i = 0; i < rounds; i++) {
+            found += classify(reports[i % reports.size()]);
+        }
+
+        auto stop = std::chrono::high_resolution_clock::now();
+
+        auto duration = duration_cast<std::chrono::microseconds>(stop - start);
+
+        std::cout << name << ": " << duration.count() / 1000 << " milliseconds, " << (size_t)(bytes / (duration.count() / 1e6)) / (1024 * 1024)
+                  << " MB/s (" << found << " of " << rounds << " matched)" << std::endl;
+    };
+
+    auto compare = [&](const std::string &table, const std::vector<std::string> &patterns) {
+
+        pattern_matcher matcher;
+
+        for (const std::string &pattern : patterns) {
+            matcher.add(pattern);
+        }
+
+        matcher.compile();
+
+        report(table + ", find() loop", [&](const std::string &output) {
+            for (const std::string &pattern : patterns) {
+                if (output.find(pattern) != std::string::npos) {
+                    return true;
+                }
+            }
+
+            return false;
+        });
+
+        report(table + ", pattern_matcher", [&](const std::string &output) { return matcher.find_first(output).has_value(); });
+    };
+
+    compare("malloc messages", std::vector<std::string>(std::begin(MALLOC_MESSAGES), std::end(MALLOC_MESSAGES)));
+
+    std::vector<std::string> headers;
+
+    for (const SANITIZER_HEADER &header : SANITIZER_HEADERS) {
+        headers.push_back(std::string("ERROR: ") + std::string(header.name));
+        headers.push_back(std::string("WARNING: ") + std::string(header.name));
+    }
+
+    compare("sanitizer headers", headers);
+
+    compare("gdb signals", std::vector<std::string>(std::begin(GDB_SIGNALS), std::end(GDB_SIGNALS)));
+}
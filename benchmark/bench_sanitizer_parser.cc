@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+// corpus is a folder of raw sanitizer reports, such as benchmark/corpus/sanitizer
+void bench_parse_sanitizer_output_NOSYM(std::filesystem::path corpus) {
+
+    std::vector<std::string> reports;
+
+    for (const auto &entry : std::filesystem::directory_iterator(corpus)) {
+
+        std::ifstream file(entry.path(), std::ios::binary);
+
+        reports.emplace_back((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    if (reports.empty()) {
+        std::cerr << "Error: no reports in " << corpus << std::endl;
+        return;
+    }
+
+    const size_t rounds = 200000;
+    size_t parsed = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < rounds; i++) {
+        if (parse_sanitizer_output_NOSYM(reports[i % reports.size()], "", "")) {
+            parsed++;
+        }
+    }
+
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    auto duration = duration_cast<std::chrono::microseconds>(stop - start);
+
+    std::cout << "Time elapsed: " << duration.count() / 1000 << " milliseconds" << std::endl;
+    std::cout << "Reports/sec: " << (size_t)(rounds / (duration.count() / 1e6)) << " (" << parsed << " of " << rounds << " parsed)" << std::endl;
+}
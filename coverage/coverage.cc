@@ -62,7 +62,172 @@ int genhtml_get_version() {
     return version;
 }
 
-void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal &ctx, bool html_report) {
+std::vector<std::filesystem::path> gcda_files(const std::filesystem::path &tree) {
+
+    std::vector<std::filesystem::path> files;
+
+    std::error_code ec;
+
+    for (auto &p : std::filesystem::recursive_directory_iterator(tree, ec)) {
+        if (p.is_regular_file() && p.path().extension().string() == ".gcda") {
+            files.push_back(std::filesystem::relative(p.path(), tree));
+        }
+    }
+
+    return files;
+}
+
+std::filesystem::path merge_gcda_trees(std::vector<std::filesystem::path> trees, const std::filesystem::path &work_dir, size_t num_threads) {
+
+    // gcov-tool fails on a folder without counters, like the tree of a worker that had no input
+    std::erase_if(trees, [](const std::filesystem::path &tree) { return gcda_files(tree).empty(); });
+
+    std::error_code ec;
+    std::filesystem::create_directories(work_dir, ec);
+
+    for (size_t round = 0; trees.size() > 1; round++) {
+
+        std::vector<std::filesystem::path> merged(trees.size() / 2);
+        std::atomic<size_t> next = 0;
+
+        std::vector<std::thread> threads;
+
+        for (size_t t = 0; t < std::max<size_t>(std::min(num_threads, merged.size()), 1); t++) {
+            threads.push_back(std::thread([&]() {
+                for (size_t i = next++; i < merged.size(); i = next++) {
+
+                    std::filesystem::path output = work_dir / std::format("merge_{}_{}", round, i);
+
+                    run("gcov-tool merge -o " + bash_escape(output.string()) + " " + bash_escape(trees[2 * i].string()) + " " +
+                        bash_escape(trees[2 * i + 1].string()));
+
+                    if (std::filesystem::exists(output)) {
+                        merged[i] = output;
+                    }
+                }
+            }));
+        }
+
+        for (auto &th : threads) {
+            th.join();
+        }
+
+        if (std::any_of(merged.begin(), merged.end(), [](const std::filesystem::path &tree) { return tree.empty(); })) {
+            return "";
+        }
+
+        // The odd one goes to the next round as is
+        if (trees.size() % 2 == 1) {
+            merged.push_back(trees.back());
+        }
+
+        trees = merged;
+    }
+
+    return trees.empty() ? "" : trees[0];
+}
+
+bool apply_gcda_tree(const std::filesystem::path &tree, const std::filesystem::path &work_dir) {
+
+    std::vector<std::filesystem::path> files = gcda_files(tree);
+
+    // The counters already there: previous runs of an incremental coverage
+    std::filesystem::path current = work_dir / "current";
+    bool has_current = false;
+
+    for (auto &file : files) {
+
+        std::filesystem::path target = "/" / file;
+
+        if (std::filesystem::exists(target)) {
+            std::filesystem::create_directories((current / file).parent_path());
+            std::filesystem::copy_file(target, current / file, std::filesystem::copy_options::overwrite_existing);
+            has_current = true;
+        }
+    }
+
+    std::filesystem::path source = tree;
+
+    if (has_current) {
+
+        source = merge_gcda_trees({tree, current}, work_dir / "final", 1);
+
+        if (source.empty()) {
+            return false;
+        }
+    }
+
+    for (auto &file : files) {
+
+        std::filesystem::path target = "/" / file;
+
+        std::error_code ec;
+        std::filesystem::create_directories(target.parent_path(), ec);
+
+        if (!std::filesystem::copy_file(source / file, target, std::filesystem::copy_options::overwrite_existing, ec)) {
+            std::cerr << "Error: could not write " << target << ": " << ec.message() << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Entries of the replayed file. false if it's missing or belongs to another binary
+bool load_replayed(const std::filesystem::path &replayed_path, uint64_t binary_hash, std::unordered_set<std::string> &paths,
+                   std::unordered_set<uint64_t> &hashes) {
+
+    std::ifstream file(replayed_path);
+
+    std::string line;
+
+    if (!std::getline(file, line) || line != std::format("{:016x}", binary_hash)) {
+        return false;
+    }
+
+    while (std::getline(file, line)) {
+
+        // A run interrupted while appending leaves a truncated last line
+        if (line.size() < 18 || line[16] != ' ' || line.find_first_not_of("0123456789abcdef") != 16) {
+            continue;
+        }
+
+        hashes.insert(std::stoull(line.substr(0, 16), nullptr, 16));
+        paths.insert(line.substr(17));
+    }
+
+    return true;
+}
+
+bool capture_coverage(const std::filesystem::path &init_folder, bool initial, lcov::Tracefile &tracefile, bool write_info, size_t num_threads) {
+
+    if (gcov::capture(init_folder, tracefile, num_threads, initial)) {
+        return !write_info || tracefile.write(tracefile.getPath());
+    }
+
+    debug() << "Falling back to lcov" << std::endl;
+
+    std::string command = "lcov --directory " + init_folder.string() + " --output-file " + tracefile.getPath();
+
+    if (initial) {
+        command += " --capture --initial --ignore-errors source";
+    } else {
+        command += " --no-checksum --capture";
+    }
+
+    std::string output = run(command);
+    debug() << command << std::endl;
+    debug() << output << std::endl << std::endl;
+
+    if (output.find("Finished .info-file creation") == std::string::npos) {
+        return false;
+    }
+
+    return initial || tracefile.parse();
+}
+
+void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal &ctx, bool html_report, bool incremental,
+              lcov::Tracefile *tracefile) {
 
     // The init_folder is the coverage folder
     std::filesystem::path init_folder = ctx.campaign->campaign_path / "__COV";
@@ -87,11 +252,13 @@ void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal
     std::filesystem::path baseline_cov;
     std::filesystem::path current_cov;
     std::filesystem::path html_folder;
+    std::filesystem::path replayed_path;
 
     if (output_folders.size() == 1) {
         baseline_cov = output_folders[0] / "app.info";
         current_cov = output_folders[0] / "app2.info";
         html_folder = output_folders[0] / "html-coverage";
+        replayed_path = output_folders[0] / COVERAGE_REPLAYED_FILE;
     } else {
 
         // Use the parent folder
@@ -99,6 +266,7 @@ void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal
         baseline_cov = parent_folder / "app.info";
         current_cov = parent_folder / "app2.info";
         html_folder = parent_folder / "html-coverage";
+        replayed_path = parent_folder / COVERAGE_REPLAYED_FILE;
     }
     // std::filesystem::path baseline_cov = output_folder / "app.info";
     // std::filesystem::path current_cov = output_folder / "app2.info";
@@ -115,8 +283,16 @@ void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal
     int genhtml_version = genhtml_get_version();
     debug() << "genhtml version: " << genhtml_version << std::endl << std::endl;
 
+    uint64_t binary_hash = 0;
+    hash_file(binary_path, binary_hash);
+
+    // Already replayed entries, their counts are in the .gcda files
+    std::unordered_set<std::string> replayed_paths;
+    std::unordered_set<uint64_t> replayed_hashes;
+
+    bool resume = incremental && std::filesystem::exists(baseline_cov) && load_replayed(replayed_path, binary_hash, replayed_paths, replayed_hashes);
+
     // Delete previous coverage files
-    std::filesystem::remove(baseline_cov);
     std::filesystem::remove(current_cov);
     // std::filesystem::remove_all(html_folder);
 
@@ -125,17 +301,22 @@ void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal
     // std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
     // std::filesystem::create_directory(tmp_folder);
 
-    std::string command = "lcov --zerocounters --directory " + init_folder.string();
-    std::string output = run(command);
+    std::string command;
+    std::string output;
 
-    command = "lcov --capture --initial --ignore-errors source --directory " + init_folder.string() + " --output-file " + baseline_cov.string();
-    output = run(command);
+    if (!resume) {
 
-    debug() << output << std::endl;
+        std::filesystem::remove(baseline_cov);
+        std::filesystem::remove(replayed_path);
 
-    if (output.find("Finished .info-file creation") == std::string::npos) {
-        std::cerr << "Error: lcov initial capture failed" << std::endl;
-        exit(EXIT_FAILURE);
+        gcov::zero_counters(init_folder);
+
+        lcov::Tracefile baseline(baseline_cov.string());
+
+        if (!capture_coverage(init_folder, true, baseline, true, ctx.numThreads)) {
+            std::cerr << "Error: initial coverage capture failed" << std::endl;
+            exit(EXIT_FAILURE);
+        }
     }
 
     debug() << "Gathering all input files..." << std::endl;
@@ -143,6 +324,9 @@ void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal
     int num_files = 0;
     std::vector<std::filesystem::path> input_files;
 
+    // Incremental only: the entries to add to the replayed file, executed or not
+    std::vector<std::pair<uint64_t, std::filesystem::path>> new_entries;
+
     for (auto &output_folder : output_folders) {
 
         // Gather coverage from all files inside "queue" folders
@@ -157,6 +341,27 @@ void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal
                     // Check if it is a file
                     if (r.is_regular_file()) {
 
+                        if (incremental) {
+
+                            // Queue entries are never modified, a known path is not read again
+                            if (replayed_paths.contains(r.path().string())) {
+                                continue;
+                            }
+
+                            uint64_t hash;
+
+                            if (!hash_file(r.path(), hash)) {
+                                continue;
+                            }
+
+                            new_entries.push_back({hash, r.path()});
+
+                            // Same contents under another name, like the entries synced from the other instances
+                            if (!replayed_hashes.insert(hash).second) {
+                                continue;
+                            }
+                        }
+
                         // std::filesystem::path new_filename = p.path().filename().string() + "_" + r.path().filename().string();
 
                         // Copy r to tmp_folder
@@ -187,41 +392,107 @@ void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal
 
     debug() << "Command: " << command << std::endl;
 
+    std::filesystem::path forkserver_shim = "";
+
+    if (ctx.use_forkserver) {
+        forkserver_shim = build_forkserver_shim(ctx.FRFUZZ_PATH);
+    }
+
     std::vector<std::thread> threads;
 
-    int numExecsPerThread = num_files / ctx.numThreads;
-    int remainingExecs = num_files % ctx.numThreads;
+    // An incremental run often has fewer new entries than threads, or none
+    size_t num_threads = std::min<size_t>(ctx.numThreads, num_files);
 
-    for (size_t i = 0; i < ctx.numThreads; ++i) {
+    // A single worker does not contend with anyone, it writes the counters in place
+    std::filesystem::path gcov_dir = "";
+
+    if (num_threads > 1) {
+
+        char dir_template[] = "/tmp/frfuzz_gcov_XXXXXX";
+
+        if (run("gcov-tool --version").find("gcov-tool") == std::string::npos) {
+            debug() << "gcov-tool not found, the workers share the .gcda files" << std::endl;
+
+        } else if (mkdtemp(dir_template) != nullptr) {
+            gcov_dir = dir_template;
+        }
+    }
+
+    int numExecsPerThread = num_threads == 0 ? 0 : num_files / num_threads;
+    int remainingExecs = num_threads == 0 ? 0 : num_files % num_threads;
+
+    for (size_t i = 0; i < num_threads; ++i) {
 
         size_t posInicial = i * numExecsPerThread;
 
         size_t posFinal = posInicial + numExecsPerThread - 1;
-        if (i == (ctx.numThreads - 1))
+        if (i == (num_threads - 1))
             posFinal += remainingExecs;
 
-        threads.push_back(std::thread(run_thread, i, input_files, posInicial, posFinal, command, timeout));
+        std::vector<std::string> env;
+
+        if (!gcov_dir.empty()) {
+            env = {"GCOV_PREFIX=" + (gcov_dir / ("worker_" + std::to_string(i))).string(), "GCOV_PREFIX_STRIP=0"};
+        }
+
+        threads.push_back(std::thread(run_thread, i, input_files, posInicial, posFinal, command, timeout, forkserver_shim, env));
     }
 
     for (auto &th : threads) {
         th.join();
     }
 
+    if (!gcov_dir.empty()) {
+
+        std::vector<std::filesystem::path> trees;
+
+        for (size_t i = 0; i < num_threads; i++) {
+            trees.push_back(gcov_dir / ("worker_" + std::to_string(i)));
+        }
+
+        // None if every input crashed before exiting
+        bool has_counters = std::any_of(trees.begin(), trees.end(), [](const std::filesystem::path &tree) { return !gcda_files(tree).empty(); });
+
+        std::filesystem::path merged = merge_gcda_trees(trees, gcov_dir, ctx.numThreads);
+
+        bool applied = !merged.empty() && apply_gcda_tree(merged, gcov_dir);
+
+        std::filesystem::remove_all(gcov_dir);
+
+        if (has_counters && !applied) {
+            std::cerr << "Error: could not merge the coverage counters of the workers" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
     auto end = std::chrono::high_resolution_clock::now();
 
     uint64_t seconds = std::chrono::duration_cast<std::chrono::seconds>(end - begin).count();
     debug() << "Total time: " << std::dec << seconds << "secs" << std::endl;
 
-    command = "lcov --no-checksum --directory " + init_folder.string() + " --capture --output-file " + current_cov.string();
-    output = run(command);
-    debug() << command << std::endl;
-    debug() << output << std::endl << std::endl;
+    lcov::Tracefile current(current_cov.string());
 
-    if (output.find("Finished .info-file creation") == std::string::npos) {
-        std::cerr << "Error: lcov initial capture failed" << std::endl;
+    // genhtml and callers without a tracefile read app2.info
+    if (!capture_coverage(init_folder, false, tracefile != nullptr ? *tracefile : current, html_report || tracefile == nullptr, ctx.numThreads)) {
+        std::cerr << "Error: coverage capture failed" << std::endl;
         exit(EXIT_FAILURE);
     }
 
+    if (incremental) {
+
+        std::ofstream replayed(replayed_path, std::ios::app);
+
+        if (!resume) {
+            replayed << std::format("{:016x}", binary_hash) << "\n";
+        }
+
+        for (auto &[hash, path] : new_entries) {
+            replayed << std::format("{:016x}", hash) << " " << path.string() << "\n";
+        }
+
+        debug() << "Replayed " << num_files << " new entries, " << replayed_paths.size() + new_entries.size() << " in total" << std::endl;
+    }
+
     if (html_report) {
 
         command = "genhtml --highlight";
@@ -2,13 +2,19 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <format>
+#include <fstream>
 #include <iostream>
 #include <regex>
 #include <string>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 
+#include "coverage/gcov.h"
+#include "coverage/lcov.h"
 #include "global.h"
 #include "utils/process.h"
 
@@ -21,6 +27,29 @@ struct coverage {
     int regions;
 };
 
-void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal &ctx, bool html_report = true);
+// Queue entries replayed by the incremental coverage, next to app.info. First line: xxhash64 of the binary, a rebuilt one starts over.
+// Then one "<xxhash64 of the contents> <path>" line per entry
+const std::string COVERAGE_REPLAYED_FILE = "coverage.replayed";
+
+// .gcda files of a GCOV_PREFIX tree, relative to it
+std::vector<std::filesystem::path> gcda_files(const std::filesystem::path &tree);
+
+// Merges the counters of the trees pairwise with gcov-tool, num_threads merges at a time, into folders of work_dir. Returns the tree holding
+// all of them, "" if a merge failed or no tree has counters
+std::filesystem::path merge_gcda_trees(std::vector<std::filesystem::path> trees, const std::filesystem::path &work_dir, size_t num_threads);
+
+// Adds the counters of a tree written with GCOV_PREFIX_STRIP=0 to the .gcda files at their original paths
+bool apply_gcda_tree(const std::filesystem::path &tree, const std::filesystem::path &work_dir);
+
+// Captures the counters under init_folder into tracefile, in process with gcov::capture. write_info also writes it to its path. lcov is the
+// fallback, for note files gcov::capture can't read: it always writes the .info file, parsed back into tracefile unless initial
+bool capture_coverage(const std::filesystem::path &init_folder, bool initial, lcov::Tracefile &tracefile, bool write_info, size_t num_threads);
+
+// Each worker writes its counters under its own GCOV_PREFIX tree, merged once all inputs ran: otherwise the workers contend on the same
+// .gcda files, which libgcov locks and rewrites at every exit. incremental = true keeps the counters of the previous run and only replays
+// the queue entries it has not seen, by path and by contents.
+// tracefile, if given, receives the final capture and app2.info is then only written for the html report
+void coverage(std::vector<std::filesystem::path> output_folders, const FRglobal &ctx, bool html_report = true, bool incremental = false,
+              lcov::Tracefile *tracefile = nullptr);
 
 void do_break(std::string breakpoint, std::vector<std::filesystem::path> output_folders, const FRglobal &ctx);
@@ -0,0 +1,611 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#include "coverage/gcov.h"
+
+namespace gcov {
+
+// Cursor over a note or data file. Before GCC 12, record lengths count 4-byte words and strings are padded to them
+struct Cursor {
+    const std::string &data;
+    size_t pos = 0;
+    bool word_lengths = false;
+
+    bool u32(uint32_t &value) {
+
+        if (pos + 4 > data.size()) {
+            return false;
+        }
+
+        memcpy(&value, data.data() + pos, 4);
+        pos += 4;
+
+        return true;
+    }
+
+    bool u64(uint64_t &value) {
+
+        uint32_t low, high;
+
+        if (!u32(low) || !u32(high)) {
+            return false;
+        }
+
+        value = low | (uint64_t)high << 32;
+
+        return true;
+    }
+
+    bool str(std::string &value) {
+
+        uint32_t length;
+
+        if (!u32(length)) {
+            return false;
+        }
+
+        size_t size = bytes(length);
+
+        if (pos + size > data.size()) {
+            return false;
+        }
+
+        // Up to the NUL, without the padding
+        value.assign(data.data() + pos, strnlen(data.data() + pos, size));
+        pos += size;
+
+        return true;
+    }
+
+    size_t bytes(uint32_t length) const { return word_lengths ? (size_t)length * 4 : length; }
+};
+
+// Magic, version, stamp and, since GCC 12, a checksum. The version is "B22*" for GCC 12.2, "A93*" for 9.3 and "407*" for 4.7
+static bool read_header(Cursor &cur, uint32_t magic, uint32_t &major) {
+
+    uint32_t value, version;
+
+    // Files of another endianness are not supported
+    if (!cur.u32(value) || value != magic || !cur.u32(version)) {
+        return false;
+    }
+
+    char c0 = version >> 24;
+    char c1 = (version >> 16) & 0xff;
+    char c2 = (version >> 8) & 0xff;
+
+    if (c0 >= 'A') {
+        major = (c0 - 'A') * 10 + (c1 - '0');
+
+    } else if (c0 == '4' && (c1 - '0') * 10 + (c2 - '0') >= 7) {
+        major = 4;
+
+    } else {
+        // No cfg checksum before 4.7
+        return false;
+    }
+
+    cur.word_lengths = major < 12;
+
+    if (!cur.u32(value)) {
+        return false;
+    }
+
+    return major < 12 || cur.u32(value);
+}
+
+bool Unit::read_notes(const std::filesystem::path &gcno_path) {
+
+    std::string data = read_file(gcno_path);
+
+    Cursor cur{data};
+
+    if (!read_header(cur, GCOV_NOTE_MAGIC, version)) {
+        return false;
+    }
+
+    std::string text;
+    uint32_t value;
+
+    // Relative sources are relative to the compiler's working directory, only recorded since GCC 9
+    cwd = gcno_path.parent_path();
+
+    if (version >= 9) {
+
+        if (!cur.str(text)) {
+            return false;
+        }
+
+        cwd = text;
+    }
+
+    // has_unexecuted_blocks
+    if (version >= 8 && !cur.u32(value)) {
+        return false;
+    }
+
+    Function *fn = nullptr;
+
+    while (cur.pos < data.size()) {
+
+        uint32_t tag, length;
+
+        // A zero tag ends the file
+        if (!cur.u32(tag) || tag == 0) {
+            break;
+        }
+
+        if (!cur.u32(length)) {
+            return false;
+        }
+
+        size_t end = cur.pos + cur.bytes(length);
+
+        if (end > data.size()) {
+            return false;
+        }
+
+        bool ok = true;
+
+        if (tag == GCOV_TAG_FUNCTION) {
+
+            fn = &functions.emplace_back();
+
+            uint32_t artificial = 0;
+
+            ok = cur.u32(fn->ident) && cur.u32(fn->lineno_checksum) && cur.u32(fn->cfg_checksum) && cur.str(fn->name);
+
+            if (version >= 8) {
+                ok = ok && cur.u32(artificial);
+            }
+
+            ok = ok && cur.str(fn->source) && cur.u32(fn->start_line);
+
+            // Start column and end line. The end column, since GCC 10, is not needed
+            if (version >= 8) {
+                ok = ok && cur.u32(value) && cur.u32(fn->end_line);
+            }
+
+            fn->artificial = artificial != 0;
+
+        } else if (tag == GCOV_TAG_BLOCKS && fn != nullptr) {
+
+            // The block count since GCC 8, one flags word per block before
+            uint32_t count = length;
+
+            if (version >= 8) {
+                ok = cur.u32(count);
+            }
+
+            fn->blocks.resize(count);
+
+        } else if (tag == GCOV_TAG_ARCS && fn != nullptr) {
+
+            uint32_t src;
+
+            ok = cur.u32(src) && src < fn->blocks.size();
+
+            while (ok && cur.pos + 8 <= end) {
+
+                Arc arc;
+                arc.src = src;
+
+                ok = cur.u32(arc.dest) && cur.u32(arc.flags) && arc.dest < fn->blocks.size();
+
+                if (ok) {
+                    fn->blocks[src].succ.push_back(fn->arcs.size());
+                    fn->blocks[arc.dest].pred.push_back(fn->arcs.size());
+                    fn->arcs.push_back(arc);
+                }
+            }
+
+        } else if (tag == GCOV_TAG_LINES && fn != nullptr) {
+
+            uint32_t block = 0;
+
+            ok = cur.u32(block) && block < fn->blocks.size();
+
+            // Line numbers, a 0 followed by a file name switches the source, by an empty one ends the list
+            std::string source = fn->source;
+
+            while (ok && cur.pos < end) {
+
+                uint32_t line;
+
+                ok = cur.u32(line);
+
+                if (ok && line == 0) {
+
+                    ok = cur.str(text);
+
+                    if (text.empty()) {
+                        break;
+                    }
+
+                    source = text;
+
+                } else if (ok) {
+                    fn->blocks[block].lines.push_back({source, line});
+                }
+            }
+        }
+
+        if (!ok) {
+            return false;
+        }
+
+        cur.pos = end;
+    }
+
+    return true;
+}
+
+bool Unit::read_data(const std::filesystem::path &gcda_path) {
+
+    if (!std::filesystem::exists(gcda_path)) {
+        return true;
+    }
+
+    std::string data = read_file(gcda_path);
+
+    Cursor cur{data};
+
+    uint32_t data_version;
+
+    if (!read_header(cur, GCOV_DATA_MAGIC, data_version) || data_version != version) {
+        return false;
+    }
+
+    std::unordered_map<uint32_t, Function *> by_ident;
+
+    for (auto &fn : functions) {
+        by_ident[fn.ident] = &fn;
+    }
+
+    Function *fn = nullptr;
+
+    while (cur.pos < data.size()) {
+
+        uint32_t tag, length;
+
+        // A zero tag ends the file
+        if (!cur.u32(tag) || tag == 0) {
+            break;
+        }
+
+        if (!cur.u32(length)) {
+            return false;
+        }
+
+        // Counters that are all zero have a negative length and no data, since GCC 12
+        if ((int32_t)length < 0) {
+            continue;
+        }
+
+        size_t end = cur.pos + cur.bytes(length);
+
+        if (end > data.size()) {
+            return false;
+        }
+
+        if (tag == GCOV_TAG_FUNCTION) {
+
+            fn = nullptr;
+
+            uint32_t ident, lineno_checksum, cfg_checksum;
+
+            // An empty record: the function was not emitted
+            if (length != 0 && cur.u32(ident) && cur.u32(lineno_checksum) && cur.u32(cfg_checksum) && by_ident.contains(ident)) {
+
+                Function *match = by_ident[ident];
+
+                if (match->lineno_checksum == lineno_checksum && match->cfg_checksum == cfg_checksum) {
+                    fn = match;
+                }
+            }
+
+        } else if (tag == GCOV_TAG_COUNTER_ARCS && fn != nullptr) {
+
+            // One counter per arc that is not on the spanning tree, in order
+            for (auto &arc : fn->arcs) {
+
+                if (arc.flags & GCOV_ARC_ON_TREE) {
+                    continue;
+                }
+
+                uint64_t count;
+
+                if (cur.pos + 8 > end || !cur.u64(count)) {
+                    break;
+                }
+
+                arc.count += count;
+            }
+        }
+
+        cur.pos = end;
+    }
+
+    return true;
+}
+
+void Unit::solve() {
+
+    for (auto &fn : functions) {
+
+        if (fn.blocks.empty()) {
+            continue;
+        }
+
+        // The instrumentation puts an exit -> entry arc on the spanning tree, so that every block balances. The exit block is 1 since
+        // GCC 4.8, the last one before
+        uint32_t exit = fn.blocks.size() > 1 && fn.blocks[1].succ.empty() ? 1 : fn.blocks.size() - 1;
+
+        fn.blocks[exit].succ.push_back(fn.arcs.size());
+        fn.blocks[0].pred.push_back(fn.arcs.size());
+        fn.arcs.push_back({exit, 0, GCOV_ARC_ON_TREE});
+
+        for (auto &arc : fn.arcs) {
+            arc.valid = !(arc.flags & GCOV_ARC_ON_TREE);
+        }
+
+        for (auto &block : fn.blocks) {
+            block.valid = false;
+        }
+
+        // A block's count is known once all the arcs on one side are, and then the only unknown arc of a side is known too
+        std::vector<uint32_t> pending(fn.blocks.size());
+
+        for (size_t i = 0; i < pending.size(); i++) {
+            pending[i] = i;
+        }
+
+        auto unknown = [&](const std::vector<uint32_t> &arcs, uint64_t &known) {
+            size_t count = 0;
+            known = 0;
+
+            for (uint32_t a : arcs) {
+                if (fn.arcs[a].valid) {
+                    known += fn.arcs[a].count;
+                } else {
+                    count++;
+                }
+            }
+
+            return count;
+        };
+
+        while (!pending.empty()) {
+
+            Block &block = fn.blocks[pending.back()];
+            pending.pop_back();
+
+            uint64_t succ_known, pred_known;
+
+            size_t succ_unknown = unknown(block.succ, succ_known);
+            size_t pred_unknown = unknown(block.pred, pred_known);
+
+            if (!block.valid && (succ_unknown == 0 || pred_unknown == 0)) {
+                block.count = succ_unknown == 0 ? succ_known : pred_known;
+                block.valid = true;
+            }
+
+            if (!block.valid) {
+                continue;
+            }
+
+            for (auto [arcs, num_unknown, known] :
+                 {std::tuple{&block.succ, succ_unknown, succ_known}, std::tuple{&block.pred, pred_unknown, pred_known}}) {
+
+                if (num_unknown != 1) {
+                    continue;
+                }
+
+                for (uint32_t a : *arcs) {
+
+                    Arc &arc = fn.arcs[a];
+
+                    if (!arc.valid) {
+                        arc.count = block.count > known ? block.count - known : 0;
+                        arc.valid = true;
+
+                        pending.push_back(arc.src);
+                        pending.push_back(arc.dest);
+                    }
+                }
+            }
+        }
+
+        fn.arcs.pop_back();
+        fn.blocks[exit].succ.pop_back();
+        fn.blocks[0].pred.pop_back();
+    }
+}
+
+std::filesystem::path Unit::source_path(const std::string &name) const {
+
+    std::filesystem::path path = name;
+
+    if (path.is_relative()) {
+        path = cwd / path;
+    }
+
+    return path.lexically_normal();
+}
+
+void Unit::collect(std::unordered_map<std::string, SourceCounts> &sources) const {
+
+    for (auto &fn : functions) {
+
+        if (fn.artificial || fn.blocks.empty() || fn.start_line == 0) {
+            continue;
+        }
+
+        // Hottest block of each line of the function
+        std::map<std::pair<std::string, uint32_t>, uint64_t> lines;
+
+        uint32_t last_line = fn.start_line;
+
+        for (auto &block : fn.blocks) {
+
+            for (auto &[source, line] : block.lines) {
+
+                uint64_t &count = lines[{source, line}];
+                count = std::max(count, block.count);
+
+                if (source == fn.source) {
+                    last_line = std::max(last_line, line);
+                }
+            }
+        }
+
+        for (auto &[line, count] : lines) {
+            sources[source_path(line.first).string()].lines[line.second] += count;
+        }
+
+        SourceCounts::FunctionCounts &function = sources[source_path(fn.source).string()].functions[fn.name];
+
+        function.start_line = fn.start_line;
+        function.end_line = std::max(fn.start_line, fn.end_line != 0 ? fn.end_line : last_line);
+        function.count += fn.blocks[0].count;
+    }
+}
+
+bool capture(const std::filesystem::path &directory, lcov::Tracefile &tracefile, size_t num_threads, bool initial) {
+
+    std::vector<std::filesystem::path> notes;
+
+    std::error_code ec;
+
+    for (auto &p : std::filesystem::recursive_directory_iterator(directory, ec)) {
+        if (p.is_regular_file() && p.path().extension().string() == ".gcno") {
+            notes.push_back(p.path());
+        }
+    }
+
+    std::sort(notes.begin(), notes.end());
+
+    num_threads = std::max<size_t>(std::min(num_threads, notes.size()), 1);
+
+    // Per thread, summed at the end
+    std::vector<std::unordered_map<std::string, SourceCounts>> counts(num_threads);
+
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> ok = true;
+
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < num_threads; t++) {
+        threads.push_back(std::thread([&, t]() {
+            for (size_t i = next++; i < notes.size(); i = next++) {
+
+                Unit unit;
+
+                if (!unit.read_notes(notes[i])) {
+                    std::cerr << "Error: could not read the coverage notes " << notes[i] << std::endl;
+                    ok = false;
+                    continue;
+                }
+
+                std::filesystem::path data = notes[i];
+                data.replace_extension(".gcda");
+
+                // Written by another build of the unit: its counters don't apply
+                if (!initial && !unit.read_data(data)) {
+                    debug() << "Skipping the counters of " << data << ", they don't match the notes" << std::endl;
+                    unit = Unit();
+                    unit.read_notes(notes[i]);
+                }
+
+                unit.solve();
+                unit.collect(counts[t]);
+            }
+        }));
+    }
+
+    for (auto &th : threads) {
+        th.join();
+    }
+
+    if (!ok) {
+        return false;
+    }
+
+    // Sources included by several units, like headers, add up
+    std::map<std::string, SourceCounts> sources;
+
+    for (auto &thread_counts : counts) {
+
+        for (auto &[path, source] : thread_counts) {
+
+            SourceCounts &total = sources[path];
+
+            for (auto &[line, count] : source.lines) {
+                total.lines[line] += count;
+            }
+
+            for (auto &[name, function] : source.functions) {
+
+                SourceCounts::FunctionCounts &f = total.functions[name];
+
+                f.start_line = function.start_line;
+                f.end_line = function.end_line;
+                f.count += function.count;
+            }
+        }
+    }
+
+    auto clamp = [](uint64_t count) { return (int)std::min<uint64_t>(count, std::numeric_limits<int>::max()); };
+
+    for (auto &[path, source] : sources) {
+
+        lcov::SourceFile *sf = new lcov::SourceFile(path, &tracefile);
+
+        tracefile.addSourceFile(sf);
+
+        // Sized once, instead of growing with each function and line
+        uint32_t last_line = source.lines.empty() ? 0 : source.lines.rbegin()->first;
+
+        for (auto &[name, function] : source.functions) {
+            last_line = std::max(last_line, function.end_line);
+        }
+
+        sf->padLines(last_line);
+
+        std::vector<std::pair<std::string, SourceCounts::FunctionCounts>> functions(source.functions.begin(), source.functions.end());
+
+        std::stable_sort(functions.begin(), functions.end(), [](const auto &a, const auto &b) { return a.second.start_line < b.second.start_line; });
+
+        int functions_hit = 0;
+
+        for (auto &[name, function] : functions) {
+
+            lcov::Function *f = new lcov::Function(name, function.start_line, function.end_line, sf);
+            f->setExecutionCount(clamp(function.count));
+
+            sf->addFunction(f);
+
+            functions_hit += function.count > 0;
+        }
+
+        sf->setNumFunctions(functions.size());
+        sf->setFunctionsHit(functions_hit);
+
+        for (auto &[line, count] : source.lines) {
+            sf->setLineHits(line, clamp(count));
+        }
+    }
+
+    return true;
+}
+
+void zero_counters(const std::filesystem::path &directory) {
+
+    std::error_code ec;
+
+    for (auto &p : std::filesystem::recursive_directory_iterator(directory, ec)) {
+        if (p.is_regular_file() && p.path().extension().string() == ".gcda") {
+            std::filesystem::remove(p.path(), ec);
+        }
+    }
+}
+
+} // namespace gcov
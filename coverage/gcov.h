@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "coverage/lcov.h"
+#include "utils/debug.h"
+#include "utils/filesys.h"
+
+namespace gcov {
+
+const uint32_t GCOV_NOTE_MAGIC = 0x67636e6f; // "gcno"
+const uint32_t GCOV_DATA_MAGIC = 0x67636461; // "gcda"
+
+// Record tags (gcc/gcov-io.h)
+enum GCOV_TAG : uint32_t {
+    GCOV_TAG_FUNCTION = 0x01000000,
+    GCOV_TAG_BLOCKS = 0x01410000,
+    GCOV_TAG_ARCS = 0x01430000,
+    GCOV_TAG_LINES = 0x01450000,
+    GCOV_TAG_COUNTER_ARCS = 0x01a10000,
+    GCOV_TAG_OBJECT_SUMMARY = 0xa1000000,
+    GCOV_TAG_PROGRAM_SUMMARY = 0xa3000000
+};
+
+enum GCOV_ARC : uint32_t {
+    GCOV_ARC_ON_TREE = 1, // No counter, derived from the others by flow conservation
+    GCOV_ARC_FAKE = 2,
+    GCOV_ARC_FALLTHROUGH = 4
+};
+
+struct Arc {
+    uint32_t src;
+    uint32_t dest;
+    uint32_t flags;
+    uint64_t count = 0;
+    bool valid = false;
+};
+
+struct Block {
+    std::vector<uint32_t> succ; // Indexes in Function::arcs
+    std::vector<uint32_t> pred;
+    std::vector<std::pair<std::string, uint32_t>> lines; // Source, line
+    uint64_t count = 0;
+    bool valid = false;
+};
+
+struct Function {
+    uint32_t ident = 0;
+    uint32_t lineno_checksum = 0;
+    uint32_t cfg_checksum = 0;
+    std::string name = "";
+    bool artificial = false; // Generated by the compiler, like static initializers. Not reported
+    std::string source = "";
+    uint32_t start_line = 0;
+    uint32_t end_line = 0; // 0 before GCC 8, the last line of its blocks is used then
+    std::vector<Block> blocks;
+    std::vector<Arc> arcs;
+};
+
+// Counts of one source file, summed over the compilation units that include it
+struct SourceCounts {
+    std::map<uint32_t, uint64_t> lines;
+
+    struct FunctionCounts {
+        uint32_t start_line = 0;
+        uint32_t end_line = 0;
+        uint64_t count = 0; // Calls
+    };
+
+    std::map<std::string, FunctionCounts> functions;
+};
+
+// One compilation unit: its note file, written by the compiler, and its data file, written by the instrumented program at exit. Supports the
+// formats of GCC 4.7 and later, and of clang with -coverage-version set to one of them
+class Unit {
+
+  public:
+    Unit() {}
+
+    bool read_notes(const std::filesystem::path &gcno_path);
+
+    // A missing data file is not an error: nothing of the unit ran. Functions that don't match the notes are skipped
+    bool read_data(const std::filesystem::path &gcda_path);
+
+    // Block counts from the arc counters
+    void solve();
+
+    // A line counts as much as its hottest block, functions as their entry block
+    void collect(std::unordered_map<std::string, SourceCounts> &sources) const;
+
+  private:
+    uint32_t version = 0; // GCC major version the files were written for
+    std::filesystem::path cwd = "";
+    std::vector<Function> functions;
+
+    std::filesystem::path source_path(const std::string &name) const;
+};
+
+// Reads the .gcno files under directory and the .gcda files next to them into tracefile, one compilation unit per thread. initial = true
+// ignores the .gcda files, like lcov --capture --initial. false if a note file could not be read
+bool capture(const std::filesystem::path &directory, lcov::Tracefile &tracefile, size_t num_threads, bool initial = false);
+
+// Deletes the .gcda files under directory, like lcov --zerocounters
+void zero_counters(const std::filesystem::path &directory);
+
+} // namespace gcov
@@ -1,4 +1,11 @@
 /* SPDX-License-Identifier: AGPL-3.0-only */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <climits>
 #include <fstream>
 #include <iostream>
 
@@ -9,34 +16,134 @@ namespace lcov {
 
 Tracefile::Tracefile(const std::string &path) { path_ = path; }
 
+Tracefile::~Tracefile() {
+    for (auto sf : sourceFiles_) {
+        delete sf;
+    }
+}
+
+void Tracefile::addSourceFile(SourceFile *sf) {
+    sourceFiles_.push_back(sf);
+    sourceFileIndex_.emplace(sf->getPath(), sf);
+}
+
 bool Tracefile::parse() {
 
-    std::string file_content = read_file(path_);
-    if (file_content.empty()) {
+    int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
         return false;
     }
 
-    std::istringstream file_stream(file_content);
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    // Read front to back once
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    std::string_view content(static_cast<const char *>(data), st.st_size);
+
+    bool ok = true;
+
+    while (!content.empty()) {
+
+        size_t newline = content.find('\n');
+        std::string_view line = content.substr(0, newline);
+        content.remove_prefix(newline == std::string_view::npos ? content.size() : newline + 1);
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
 
-    std::string line;
-    while (std::getline(file_stream, line)) {
         if (!parse_line(line)) {
             std::cerr << "Error parsing line: " << line << std::endl;
-            return false;
+            ok = false;
+            break;
         }
     }
 
-    /*
-      std::ifstream in(path_);
-      if (!in) return false;
-      std::string line;
-      while (std::getline(in, line)) lines_.push_back(line);
+    munmap(data, st.st_size);
 
-    */
+    return ok;
+}
+
+bool Tracefile::write(const std::string &path) const {
+
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Error writing file: " << path << std::endl;
+        return false;
+    }
+
+    for (const auto &sf : sourceFiles_) {
+        file << "TN:\nSF:" << sf->getPath() << "\n";
+
+        int functions_hit = 0;
+        for (const auto &f : sf->functions()) {
+            file << "FN:" << f->getStartLine() << "," << f->getEndLine() << "," << f->getName() << "\n";
+            functions_hit += f->getExecutionCount() > 0;
+        }
+        for (const auto &f : sf->functions()) {
+            file << "FNDA:" << f->getExecutionCount() << "," << f->getName() << "\n";
+        }
+        file << "FNF:" << sf->functions().size() << "\nFNH:" << functions_hit << "\n";
+
+        for (const auto &br : sf->branches()) {
+            file << "BRDA:" << br.line << "," << (br.exception ? "e" : "") << br.block << "," << br.branch << ",";
+            if (br.taken < 0) {
+                file << "-\n";
+            } else {
+                file << br.taken << "\n";
+            }
+        }
+        if (!sf->branches().empty()) {
+            file << "BRF:" << sf->getNumBranches() << "\nBRH:" << sf->getBranchesHit() << "\n";
+        }
+
+        const std::vector<Line> &lines = sf->lines();
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (lines[i].isLcovTrackedLine()) {
+                file << "DA:" << i + 1 << "," << lines[i].getHits() << "\n";
+            }
+        }
+        file << "LF:" << sf->getLcovLines() << "\nLH:" << sf->getHittedLines() << "\nend_of_record\n";
+    }
+
+    return (bool)file;
+}
+
+// Fields of a record are separated by commas
+static std::string_view next_field(std::string_view &val) {
+
+    size_t comma = val.find(',');
+    std::string_view field = val.substr(0, comma);
+    val.remove_prefix(comma == std::string_view::npos ? val.size() : comma + 1);
+    return field;
+}
+
+// lcov counts are 64 bits, they are clamped to int
+static bool parse_int(std::string_view text, int &value) {
+
+    int64_t number = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), number);
+    if (ec != std::errc() || end != text.data() + text.size() || text.empty()) {
+        return false;
+    }
+    value = std::clamp<int64_t>(number, INT_MIN, INT_MAX);
     return true;
 }
 
-bool Tracefile::parse_line(const std::string &line) {
+bool Tracefile::parse_line(std::string_view line) {
 
     if (line.empty()) {
         return false;
@@ -58,8 +165,14 @@ bool Tracefile::parse_line(const std::string &line) {
         return false;
     }
 
-    std::string key = line.substr(0, colon);
-    std::string val = line.substr(colon + 1);
+    std::string_view key = line.substr(0, colon);
+    std::string_view val = line.substr(colon + 1);
+
+    // Every record but TN and SF belongs to a source file
+    if (key != "TN" && key != "SF" && currentSourceFile == nullptr) {
+        std::cerr << "Error: " << key << " record found before SF record" << std::endl;
+        return false;
+    }
 
     // Test Name
     if (key == "TN") {
@@ -70,51 +183,29 @@ bool Tracefile::parse_line(const std::string &line) {
         // Source File
     } else if (key == "SF") {
 
-        for (const auto &sf : sourceFiles_) {
-            if (sf->getPath() == val) {
-                std::cerr << "Error: Duplicate source file found: " << val << std::endl;
-                return false;
-            }
+        if (findSourceFile(val) != nullptr) {
+            std::cerr << "Error: Duplicate source file found: " << val << std::endl;
+            return false;
         }
 
-        SourceFile *sf = new SourceFile(val, this);
-        this->sourceFiles_.push_back(sf);
+        SourceFile *sf = new SourceFile(std::string(val), this);
+        addSourceFile(sf);
         currentSourceFile = sf;
         currentFunction = nullptr; // Reset current function when a new source file is encountered
 
         // Function Name
     } else if (key == "FN") {
 
-        if (currentSourceFile == nullptr) {
-            std::cerr << "Error: FN record found before SF record" << std::endl;
-            return false;
-        }
-
         // FN contains 3 fields separated by comma: line number start, line number end, function name
         int start_line = 0;
         int end_line = 0;
-        std::string func_name;
 
-        size_t first_comma = val.find(',');
-        if (first_comma == std::string::npos) {
-            std::cerr << "Error: Invalid FN record format" << std::endl;
-            return false;
-        }
-        size_t second_comma = val.find(',', first_comma + 1);
-        if (second_comma == std::string::npos) {
-            std::cerr << "Error: Invalid FN record format" << std::endl;
-            return false;
-        }
-        try {
-            start_line = std::stoi(val.substr(0, first_comma));
-            end_line = std::stoi(val.substr(first_comma + 1, second_comma - first_comma - 1));
-            func_name = val.substr(second_comma + 1);
-        } catch (const std::invalid_argument &e) {
+        if (!parse_int(next_field(val), start_line) || !parse_int(next_field(val), end_line) || val.empty()) {
             std::cerr << "Error: Invalid FN record format" << std::endl;
             return false;
         }
 
-        Function *func = new Function(func_name, start_line, end_line, currentSourceFile);
+        Function *func = new Function(std::string(val), start_line, end_line, currentSourceFile);
         currentSourceFile->addFunction(func);
         currentFunction = func;
 
@@ -125,47 +216,26 @@ bool Tracefile::parse_line(const std::string &line) {
 
         // FNDA contains 2 fields separated by comma: execution count, function name
         int exec_count = 0;
-        std::string func_name;
-        size_t comma = val.find(',');
-        if (comma == std::string::npos) {
-            std::cerr << "Error: Invalid FNDA record format" << std::endl;
-            return false;
-        }
-        try {
-            exec_count = std::stoi(val.substr(0, comma));
-            func_name = val.substr(comma + 1);
-        } catch (const std::invalid_argument &e) {
+
+        if (!parse_int(next_field(val), exec_count)) {
             std::cerr << "Error: Invalid FNDA record format" << std::endl;
             return false;
         }
 
-        // Find the function in the current source file
-        if (currentSourceFile == nullptr) {
-            std::cerr << "Error: FNDA record found before SF record" << std::endl;
+        Function *func = currentSourceFile->findFunction(val);
+        if (func == nullptr) {
+            std::cerr << "Error: FNDA record refers to unknown function: " << val << std::endl;
             return false;
         }
 
-        bool found = false;
-        for (const auto &func : currentSourceFile->functions()) {
-            if (func->getName() == func_name) {
-                func->setExecutionCount(exec_count);
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            std::cerr << "Error: FNDA record refers to unknown function: " << func_name << std::endl;
-            return false;
-        }
+        func->setExecutionCount(exec_count);
 
         // Functions Found
     } else if (key == "FNF") {
 
         int num_functions = 0;
 
-        try {
-            num_functions = std::stoi(val);
-        } catch (const std::invalid_argument &e) {
+        if (!parse_int(val, num_functions)) {
             std::cerr << "Error: Invalid FNF record format" << std::endl;
             return false;
         }
@@ -177,33 +247,92 @@ bool Tracefile::parse_line(const std::string &line) {
 
         int functions_hit = 0;
 
-        try {
-            functions_hit = std::stoi(val);
-        } catch (const std::invalid_argument &e) {
+        if (!parse_int(val, functions_hit)) {
             std::cerr << "Error: Invalid FNH record format" << std::endl;
             return false;
         }
 
         currentSourceFile->setFunctionsHit(functions_hit);
 
+        // Branch Data
+    } else if (key == "BRDA") {
+
+        // BRDA contains 4 fields separated by comma: line number, block, branch, times taken ("-" if the block never ran). lcov 2 marks
+        // exception branches with an "e" before the block, and may name a branch with an expression instead of a number
+        int line_number = 0;
+        int block = 0;
+        int branch = 0;
+        int taken = -1;
+
+        size_t comma = val.rfind(',');
+        std::string_view taken_field = comma == std::string_view::npos ? "" : val.substr(comma + 1);
+        val = val.substr(0, comma);
+
+        std::string_view line_field = next_field(val);
+        std::string_view block_field = next_field(val);
+
+        bool exception = block_field.starts_with('e');
+        if (exception) {
+            block_field.remove_prefix(1);
+        }
+
+        if (!parse_int(line_field, line_number) || !parse_int(block_field, block) || (taken_field != "-" && !parse_int(taken_field, taken))) {
+            std::cerr << "Error: Invalid BRDA record format" << std::endl;
+            return false;
+        }
+
+        if (!parse_int(val, branch)) {
+            branch = currentSourceFile->branches().size();
+        }
+
+        currentSourceFile->addBranch({(uint32_t)line_number, (uint32_t)block, (uint32_t)branch, taken, exception});
+
+        // Branches Found
+    } else if (key == "BRF") {
+
+        int branches_found = 0;
+
+        if (!parse_int(val, branches_found)) {
+            std::cerr << "Error: Invalid BRF record format" << std::endl;
+            return false;
+        }
+
+        if (branches_found != currentSourceFile->getNumBranches()) {
+            std::cerr << "Warning: Number of branches found (" << branches_found << ") does not match number of branches parsed ("
+                      << currentSourceFile->getNumBranches() << ") in file: " << currentSourceFile->getPath() << std::endl;
+        }
+
+        // Branches Hit
+    } else if (key == "BRH") {
+
+        int branches_hit = 0;
+
+        if (!parse_int(val, branches_hit)) {
+            std::cerr << "Error: Invalid BRH record format" << std::endl;
+            return false;
+        }
+
+        if (branches_hit != currentSourceFile->getBranchesHit()) {
+            std::cerr << "Warning: Number of branches hit (" << branches_hit << ") does not match number of branches taken ("
+                      << currentSourceFile->getBranchesHit() << ") in file: " << currentSourceFile->getPath() << std::endl;
+        }
+
         // Line Data
     } else if (key == "DA") {
 
         currentFunction = nullptr;
 
-        // DA contains 2 fields separated by comma: line number, execution count
+        // DA contains 2 fields separated by comma: line number, execution count. lcov --checksum adds a third one
         int line_number = 0;
         int exec_count = 0;
-        size_t comma = val.find(',');
-        if (comma == std::string::npos) {
+
+        if (!parse_int(next_field(val), line_number) || !parse_int(next_field(val), exec_count)) {
             std::cerr << "Error: Invalid DA record format" << std::endl;
             return false;
         }
-        try {
-            line_number = std::stoi(val.substr(0, comma));
-            exec_count = std::stoi(val.substr(comma + 1));
-        } catch (const std::invalid_argument &e) {
-            std::cerr << "Error: Invalid DA record format" << std::endl;
+
+        if (line_number < 1) {
+            std::cerr << "Error: DA record for line " << line_number << " is out of range in file: " << currentSourceFile->getPath() << std::endl;
             return false;
         }
 
@@ -214,18 +343,11 @@ bool Tracefile::parse_line(const std::string &line) {
 
         int lines_found = 0;
 
-        try {
-            lines_found = std::stoi(val);
-        } catch (const std::invalid_argument &e) {
+        if (!parse_int(val, lines_found)) {
             std::cerr << "Error: Invalid LF record format" << std::endl;
             return false;
         }
 
-        if (currentSourceFile == nullptr) {
-            std::cerr << "Error: LF record found before SF record" << std::endl;
-            return false;
-        }
-
         // Check if lines_found matches the number of lcov lines in the source file
         if (lines_found != currentSourceFile->getLcovLines()) {
             std::cerr << "Warning: Number of lines found (" << lines_found << ") does not match total lines in source file ("
@@ -237,18 +359,11 @@ bool Tracefile::parse_line(const std::string &line) {
 
         int lines_hit = 0;
 
-        try {
-            lines_hit = std::stoi(val);
-        } catch (const std::invalid_argument &e) {
+        if (!parse_int(val, lines_hit)) {
             std::cerr << "Error: Invalid LH record format" << std::endl;
             return false;
         }
 
-        if (currentSourceFile == nullptr) {
-            std::cerr << "Error: LH record found before SF record" << std::endl;
-            return false;
-        }
-
         // Check if lines_hit matches the number of lines with hits in the source file
         if (lines_hit != currentSourceFile->getHittedLines()) {
             std::cerr << "Warning: Number of lines hit (" << lines_hit << ") does not match number of lines with hits in source file ("
@@ -296,35 +411,84 @@ std::ostream &operator<<(std::ostream &os, const Tracefile &tf) {
     return os;
 }
 
+SourceCache &SourceCache::instance() {
+    static SourceCache cache;
+    return cache;
+}
+
+std::shared_ptr<const SourceText> SourceCache::text(const std::string &path) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    struct stat st;
+    if (stat(path.c_str(), &st) == -1) {
+        st.st_size = -1;
+        st.st_mtim = {};
+    }
+
+    auto it = files_.find(path);
+    if (it != files_.end()) {
+
+        const SourceText &cached = *it->second;
+        if (cached.size == st.st_size && cached.mtime.tv_sec == st.st_mtim.tv_sec && cached.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            return it->second;
+        }
+    }
+
+    auto text = std::make_shared<SourceText>();
+
+    text->size = st.st_size;
+    text->mtime = st.st_mtim;
+
+    if (st.st_size == -1) {
+        std::cerr << "Error reading file: " << path << std::endl;
+
+    } else {
+
+        text->content = read_file(path);
+
+        std::string_view content = text->content;
+
+        while (!content.empty()) {
+            size_t newline = content.find('\n');
+            text->lines.push_back(content.substr(0, newline));
+            content.remove_prefix(newline == std::string_view::npos ? content.size() : newline + 1);
+        }
+    }
+
+    // The previous version, if any, stays alive while someone holds it
+    files_.insert_or_assign(path, text);
+
+    return text;
+}
+
 SourceFile::SourceFile(std::string path, Tracefile *parent) {
 
     parentTracefile = parent;
 
     path_ = path;
+}
 
-    file_content_ = read_file(path_);
-    if (file_content_.empty()) {
-        std::cerr << "Error reading file: " << path_ << std::endl;
-        return;
+SourceFile::~SourceFile() {
+    for (auto f : functions_) {
+        delete f;
     }
+}
 
-    total_lines_ = std::count(file_content_.begin(), file_content_.end(), '\n');
-    // TODO: Print it only if debug mode is enabled
-    // std::cout << "Total lines in " << path_ << ": " << total_lines_ << std::endl;
-
-    lines_.reserve(total_lines_);
+// Line line of text, "" past its end
+static std::string_view line_text(const SourceText &text, int line) {
 
-    // Copy these lines into lines_ vector
-    std::istringstream file_stream(file_content_);
-    std::string line;
-    int line_number = 1;
-    while (std::getline(file_stream, line)) {
-        Line l(line_number, 0, line, nullptr);
-        lines_.push_back(l);
-        line_number++;
+    if (line < 1 || line > (int)text.lines.size()) {
+        return "";
     }
+
+    return text.lines[line - 1];
 }
 
+std::string SourceFile::getLineText(int line) const { return std::string(line_text(*getText(), line)); }
+
+std::string Line::getSourceText() const { return sourceFile == nullptr ? "" : sourceFile->getLineText(lineNumber); }
+
 void SourceFile::setNumFunctions(int n) {
     num_functions_ = n;
 
@@ -351,6 +515,8 @@ void SourceFile::setFunctionsHit(int n) {
 
 void SourceFile::setLineHits(int line, int hits) {
 
+    padLines(line);
+
     if (hits > 0) {
         lines_[line - 1].setHits(hits);
         hitted_lines_++;
@@ -359,6 +525,30 @@ void SourceFile::setLineHits(int line, int hits) {
     lines_[line - 1].setLcovTrackedLine(true);
 }
 
+void SourceFile::addFunction(Function *f) {
+    functions_.push_back(f);
+    functionIndex_.emplace(f->getName(), f);
+    parentTracefile->addFunction(f);
+}
+
+int SourceFile::getBranchesHit() const {
+
+    int count = 0;
+    for (const auto &br : branches_) {
+        if (br.taken > 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void SourceFile::padLines(int n) {
+
+    for (int i = lines_.size() + 1; i <= n; i++) {
+        lines_.push_back(Line(i, 0, this, nullptr));
+    }
+}
+
 int SourceFile::getLcovLines() const {
 
     int count = 0;
@@ -382,29 +572,32 @@ Function::Function(std::string fn, int sl, int el, SourceFile *sf) {
     end_line_ = el;
     sourceFile = sf;
 
+    sourceFile->padLines(end_line_);
+
     // Now we need to point these lines to this function
     for (int i = start_line_; i <= end_line_; i++) {
-
-        Line *line = &sourceFile->lines()[i - 1];
-
-        line->setParentFunction(this);
-
-        lines_.push_back(line);
+        sourceFile->lines()[i - 1].setParentFunction(this);
     }
 }
 
+// The source is resolved once: one lookup for the whole function, and all its lines from the same version of the file
 std::string Function::getSourceText() const {
+    std::shared_ptr<const SourceText> source = sourceFile->getText();
+
     std::string text = "";
-    for (const auto &line : lines_) {
-        text += line->getSourceText() + "\n";
+    for (int i = start_line_; i <= end_line_; i++) {
+        text += line_text(*source, i);
+        text += "\n";
     }
     return text;
 }
 
 std::string Function::getCovText() const {
+    std::shared_ptr<const SourceText> source = sourceFile->getText();
+
     std::string text = "";
-    for (const auto &line : lines_) {
-        text += line->getCovText() + "\n";
+    for (int i = start_line_; i <= end_line_; i++) {
+        text += getLine(i)->getCovText(line_text(*source, i)) + "\n";
     }
     return text;
 }
@@ -412,8 +605,8 @@ std::string Function::getCovText() const {
 int Function::getLcovLines() const {
 
     int count = 0;
-    for (const auto &line : lines_) {
-        if (line->isLcovTrackedLine()) {
+    for (int i = start_line_; i <= end_line_; i++) {
+        if (getLine(i)->isLcovTrackedLine()) {
             count++;
         }
     }
@@ -422,8 +615,8 @@ int Function::getLcovLines() const {
 
 int Function::getLinesHit() const {
     int hit = 0;
-    for (const auto &l : lines_) {
-        if (l->getHits() > 0) {
+    for (int i = start_line_; i <= end_line_; i++) {
+        if (getLine(i)->getHits() > 0) {
             hit++;
         }
     }
@@ -1,6 +1,13 @@
 /* SPDX-License-Identifier: AGPL-3.0-only */
 #pragma once
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "utils/filesys.h"
@@ -11,31 +18,91 @@ class Line;
 class Function;
 class SourceFile;
 
+// Lets the indexes be looked up with the string_views of the parser, without a copy
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+template <typename T> using StringIndex = std::unordered_map<std::string, T, StringHash, std::equal_to<>>;
+
+// One version of a source file, split into lines without their newline
+struct SourceText {
+    off_t size = -1; // -1 if the file could not be read
+    struct timespec mtime = {};
+    std::string content;
+    std::vector<std::string_view> lines;
+};
+
+// Source files read on first use, split into lines once and shared by every tracefile. Tracefiles only keep counters: the text is read
+// when something asks for it, like Function::getCovText(). Files are copied, not mapped: a rebuild may rewrite or truncate them
+// under a long running plunger, and they are read again when their size or mtime changes
+class SourceCache {
+
+  public:
+    static SourceCache &instance();
+
+    // Current version of path, empty if it can't be read. Checks its size and mtime: resolve it once for all the lines of a function, so
+    // they come from the same version. An older version is freed when its last holder lets it go
+    std::shared_ptr<const SourceText> text(const std::string &path);
+
+  private:
+    std::mutex mutex_;
+    StringIndex<std::shared_ptr<const SourceText>> files_;
+
+    SourceCache() {}
+};
+
+// One BRDA record
+struct Branch {
+    uint32_t line;
+    uint32_t block;
+    uint32_t branch;
+    int32_t taken; // -1 if the block never ran
+    bool exception;
+};
+
 class Tracefile {
 
   public:
     explicit Tracefile(const std::string &path);
 
-    ~Tracefile() {
-        for (auto sf : sourceFiles_) {
-            delete sf;
-        }
-    }
+    // Out of line: SourceFile is still incomplete here
+    ~Tracefile();
+
+    // Owns its source files
+    Tracefile(const Tracefile &) = delete;
+    Tracefile &operator=(const Tracefile &) = delete;
 
     bool parse();
 
+    // Same format parse() reads. false if path can't be written
+    bool write(const std::string &path) const;
+
+    std::string getPath() const { return path_; }
+
     const std::vector<SourceFile *> &sourceFiles() const { return sourceFiles_; }
 
     const std::vector<Function *> &allFunctions() const { return allFunctions_; }
 
     void addFunction(Function *f) { allFunctions_.push_back(f); }
 
+    // For tracefiles built without parse(), it takes ownership
+    void addSourceFile(SourceFile *sf);
+
+    SourceFile *findSourceFile(std::string_view path) const {
+        auto it = sourceFileIndex_.find(path);
+        return it == sourceFileIndex_.end() ? nullptr : it->second;
+    }
+
   private:
     std::string path_;
     // std::vector<std::string> lines_;
 
     // All source files in the tracefile
     std::vector<SourceFile *> sourceFiles_;
+    StringIndex<SourceFile *> sourceFileIndex_;
 
     // All functions in the tracefile
     std::vector<Function *> allFunctions_;
@@ -46,7 +113,7 @@ class Tracefile {
     // Current function being parsed
     Function *currentFunction = nullptr;
 
-    bool parse_line(const std::string &line);
+    bool parse_line(std::string_view line);
 
     // Overload << operator
     friend std::ostream &operator<<(std::ostream &os, const Tracefile &tf);
@@ -57,17 +124,24 @@ class SourceFile {
   public:
     SourceFile(std::string path, Tracefile *parent);
 
-    ~SourceFile() {
-        for (auto f : functions_) {
-            delete f;
-        }
-    }
+    // Out of line: Function is still incomplete here
+    ~SourceFile();
+
+    void addFunction(Function *f);
 
-    void addFunction(Function *f) {
-        functions_.push_back(f);
-        parentTracefile->addFunction(f);
+    Function *findFunction(std::string_view name) const {
+        auto it = functionIndex_.find(name);
+        return it == functionIndex_.end() ? nullptr : it->second;
     }
 
+    void addBranch(const Branch &b) { branches_.push_back(b); }
+
+    const std::vector<Branch> &branches() const { return branches_; }
+
+    int getNumBranches() const { return branches_.size(); }
+
+    int getBranchesHit() const;
+
     std::string getPath() const { return path_; }
 
     const std::vector<Function *> &functions() const { return functions_; }
@@ -89,13 +163,21 @@ class SourceFile {
     // Return a reference to lines_
     std::vector<Line> &lines() { return lines_; }
 
+    const std::vector<Line> &lines() const { return lines_; }
+
+    // Text of a line, "" past the end of the file or if it can't be read
+    std::string getLineText(int line) const;
+
+    std::shared_ptr<const SourceText> getText() const { return SourceCache::instance().text(path_); }
+
+    // Adds untracked lines up to n. Lines are added as records need them, this only saves the reallocations
+    void padLines(int n);
+
   private:
     Tracefile *parentTracefile = nullptr;
 
     std::string path_;
-    std::string file_content_;
 
-    int total_lines_ = 0; // Total lines in the source file
     // int lcov_lines_ = 0; // Lines tracked by LCOV
     int hitted_lines_ = 0; // Lines with hits
 
@@ -103,7 +185,9 @@ class SourceFile {
     int functions_hit_ = 0;
 
     std::vector<Function *> functions_;
+    StringIndex<Function *> functionIndex_;
     std::vector<Line> lines_;
+    std::vector<Branch> branches_;
 };
 
 class Function {
@@ -120,8 +204,6 @@ class Function {
 
     std::vector<std::string> parameters;
 
-    std::vector<Line *> lines_;
-
     // int num_lines_ = 0;
     // int lines_hit_ = 0;
 
@@ -153,7 +235,7 @@ class Function {
             return nullptr;
         }
 
-        return lines_[numLine - start_line_];
+        return &sourceFile->lines()[numLine - 1];
     }
 
     std::string getName() const { return funcName_; }
@@ -170,7 +252,7 @@ class Function {
 
     int getExecutionCount() const { return execution_count_; }
 
-    int getNumLines() const { return lines_.size(); }
+    int getNumLines() const { return end_line_ - start_line_ + 1; }
 
     int getLcovLines() const;
 
@@ -186,7 +268,7 @@ class Function {
 
     SourceFile *getSourceFile() const { return sourceFile; }
 
-    int size() const { return lines_.size(); }
+    int size() const { return getNumLines(); }
 
     /*
     bool isCalledInside(Function func) {
@@ -255,18 +337,20 @@ class Line {
     int lineNumber = 0;
     bool lcov_tracked_line = false;
     int hits = 0;
-    std::string source = "";
+
+    // The text is in the SourceCache
+    const SourceFile *sourceFile = nullptr;
 
     Function *function = nullptr;
 
   public:
     Line() {}
 
-    Line(int l, int h, std::string s, Function *f) {
+    Line(int l, int h, const SourceFile *sf, Function *f) {
 
         lineNumber = l;
         hits = h;
-        source = s;
+        sourceFile = sf;
         function = f;
     }
 
@@ -282,11 +366,15 @@ class Line {
 
     int getHits() const { return hits; }
 
-    std::string getSourceText() const { return source; }
+    std::string getSourceText() const;
+
+    std::string getCovText() const { return getCovText(getSourceText()); }
 
-    std::string getCovText() const {
+    // With the text of the line, already looked up
+    std::string getCovText(std::string_view source) const {
         std::string covText = "";
-        covText += std::to_string(lineNumber) + "            " + std::to_string(hits) + " :     " + source;
+        covText += std::to_string(lineNumber) + "            " + std::to_string(hits) + " :     ";
+        covText += source;
         return covText;
     }
 
@@ -299,7 +387,7 @@ class Line {
 
     // Overload <<
     friend std::ostream &operator<<(std::ostream &os, const Line &l) {
-        os << l.lineNumber << " | " << l.hits << " | " << l.source;
+        os << l.lineNumber << " | " << l.hits << " | " << l.getSourceText();
         return os;
     }
 };
@@ -157,7 +157,7 @@ bool grDB::create_table(std::string table_name, data::TypedTable table, std::str
     return true;
 }
 
-bool grDB::insert(std::string table_name, data::TypedTable table, std::string primary_key) {
+bool grDB::insert(std::string table_name, data::TypedTable table, std::string primary_key, bool or_ignore) {
 
     // Create table
     if (!create_table(table_name, table, primary_key)) {
@@ -171,7 +171,7 @@ bool grDB::insert(std::string table_name, data::TypedTable table, std::string pr
 
     char *tail;
 
-    std::string sql = "INSERT INTO " + table_name + " (";
+    std::string sql = (or_ignore ? "INSERT OR IGNORE INTO " : "INSERT INTO ") + table_name + " (";
 
     for (auto c : table.header()) {
         sql += c.first + ",";
@@ -162,7 +162,8 @@ public:
 
     bool create_table(std::string table_name, data::TypedTable table, std::string primary_key);
 
-    bool insert(std::string table_name, data::TypedTable table, std::string primary_key = "");
+    // or_ignore = true skips the rows whose primary key is already in the table instead of failing
+    bool insert(std::string table_name, data::TypedTable table, std::string primary_key = "", bool or_ignore = false);
 
     bool update(std::string table_name, std::string column_name, std::string value, std::string where_clause = "");
 
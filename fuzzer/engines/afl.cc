@@ -1071,13 +1071,14 @@ bool AFL_read_config(const std::filesystem::path AFL_folder, AFL_CONFIG &config)
     return config_found;
 }
 
-std::vector<std::filesystem::path> AFL_get_crashes(const std::filesystem::path AFL_folder) {
+// Files of every <findings>/ folder under AFL_folder
+static std::vector<std::filesystem::path> AFL_get_findings(const std::filesystem::path AFL_folder, const std::string &findings) {
 
     std::vector<std::filesystem::path> crashes;
 
     for (auto &p : std::filesystem::recursive_directory_iterator(AFL_folder)) {
 
-        if (p.is_directory() && p.path().filename().string() == "crashes") {
+        if (p.is_directory() && p.path().filename().string() == findings) {
 
             for (auto &q : std::filesystem::directory_iterator(p)) {
 
@@ -1092,6 +1093,10 @@ std::vector<std::filesystem::path> AFL_get_crashes(const std::filesystem::path A
     return crashes;
 }
 
+std::vector<std::filesystem::path> AFL_get_crashes(const std::filesystem::path AFL_folder) { return AFL_get_findings(AFL_folder, "crashes"); }
+
+std::vector<std::filesystem::path> AFL_get_hangs(const std::filesystem::path AFL_folder) { return AFL_get_findings(AFL_folder, "hangs"); }
+
 void fuzz_afl(std::string profileFile, size_t cores, std::string input_path, std::filesystem::path output_path, size_t max_length, size_t timeout,
               size_t memory_limit, std::string extension, std::vector<std::string> dictionary_paths, size_t cache_size, const FRglobal &ctx) {
 
@@ -65,6 +65,9 @@ void fuzz_afl(std::string profileFile, size_t cores, std::string input_path, std
 
 std::vector<std::filesystem::path> AFL_get_crashes(const std::filesystem::path AFL_folder);
 
+// Inputs that timed out, in the hangs/ folders
+std::vector<std::filesystem::path> AFL_get_hangs(const std::filesystem::path AFL_folder);
+
 class afl : public fuzzer {
 
   public:
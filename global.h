@@ -38,6 +38,9 @@ class FRglobal {
 
     size_t numThreads = 1;
 
+    // Replay inputs through a forkserver instead of a new process each (-f)
+    bool use_forkserver = false;
+
     Campaign *campaign;
 
     uint32_t debug_level = 0;
@@ -1,151 +1,179 @@
 /* SPDX-License-Identifier: AGPL-3.0-only */
 #include "elf.h"
 
-bool ELF::open(std::filesystem::path input_file) {
+bool ELF::open_sections(std::filesystem::path input_file) {
+
+    this->file_path = input_file;
 
     this->file_content = read_file(input_file);
 
+    if (this->file_content.size() < sizeof(ElfW(Ehdr))) {
+        return false;
+    }
+
     this->elf_addr = (void *)this->file_content.data(); // 0xd64800
 
     this->header = (ElfW(Ehdr) *)elf_addr;
 
     // ELF magic bytes = 0x7f, 'E', 'L', 'F'
-    if (memcmp(header->e_ident, ELFMAG, SELFMAG) == 0) {
+    if (memcmp(header->e_ident, ELFMAG, SELFMAG) != 0) {
+        return false;
+    }
 
-        // This is a valid elf file
+    // This is a valid elf file
 
-        // https://ics.uci.edu/~aburtsev/238P/hw/hw3-elf/img/typical_elf.jpg
+    // https://ics.uci.edu/~aburtsev/238P/hw/hw3-elf/img/typical_elf.jpg
 
-        sh = (Elf64_Shdr *)(elf_addr + header->e_shoff);
-        this->num_sections = header->e_shnum;
+    sh = (Elf64_Shdr *)(elf_addr + header->e_shoff);
+    this->num_sections = header->e_shnum;
 
-        Elf64_Shdr *sh_str = &sh[header->e_shstrndx];
-        this->section_names = (char *)(elf_addr + sh_str->sh_offset);
+    Elf64_Shdr *sh_str = &sh[header->e_shstrndx];
+    this->section_names = (char *)(elf_addr + sh_str->sh_offset);
 
-        for (int i = 0; i < num_sections; i++) {
+    for (int i = 0; i < num_sections; i++) {
 
-            const char *section_name = section_names + sh[i].sh_name;
+        const char *section_name = section_names + sh[i].sh_name;
 
-            sh_map[section_name] = (Elf64_Addr *)(&sh[i]);
-        }
+        sh_map[section_name] = (Elf64_Addr *)(&sh[i]);
+    }
 
-        Elf64_Shdr *sh_strings = (Elf64_Shdr *)(sh_map[".strtab"]);
-        this->string_table = (char *)(elf_addr + sh_strings->sh_offset);
+    return true;
+}
 
-        Elf64_Shdr *sh_symbols = (Elf64_Shdr *)(sh_map[".symtab"]);
-        this->symbols = (Elf64_Sym *)(elf_addr + sh_symbols->sh_offset);
+bool ELF::open(std::filesystem::path input_file) {
 
-        Elf64_Xword num_symbols = sh_symbols->sh_size / sh_symbols->sh_entsize;
+    if (!open_sections(input_file)) {
+        return false;
+    }
 
-        for (int i = 0; i < num_symbols; i++) {
+    if (!sh_map.contains(".symtab") || !sh_map.contains(".strtab")) {
+        std::cout << "No symbol table" << std::endl;
+        return false;
+    }
 
-            /*
-            Elf64_Word	st_name;		// Symbol name (string tbl index)
-            unsigned char	st_info;		// Symbol type and binding
-            unsigned char st_other;		// Symbol visibility
-            Elf64_Section	st_shndx;		// Section index
-            Elf64_Addr	st_value;		// Symbol value
-            Elf64_Xword	st_size;		// Symbol size
-            */
+    Elf64_Shdr *sh_strings = (Elf64_Shdr *)(sh_map[".strtab"]);
+    this->string_table = (char *)(elf_addr + sh_strings->sh_offset);
 
-            const char *symbol_name = string_table + symbols[i].st_name;
+    Elf64_Shdr *sh_symbols = (Elf64_Shdr *)(sh_map[".symtab"]);
+    this->symbols = (Elf64_Sym *)(elf_addr + sh_symbols->sh_offset);
 
-            symbols_map[symbol_name] = (Elf64_Addr *)(&symbols[i]);
-        }
+    Elf64_Xword num_symbols = sh_symbols->sh_size / sh_symbols->sh_entsize;
 
-        // print_symbol("main");
+    for (int i = 0; i < num_symbols; i++) {
 
-        Elf64_Addr addr = get_symbol_addr("main");
+        /*
+        Elf64_Word	st_name;		// Symbol name (string tbl index)
+        unsigned char	st_info;		// Symbol type and binding
+        unsigned char st_other;		// Symbol visibility
+        Elf64_Section	st_shndx;		// Section index
+        Elf64_Addr	st_value;		// Symbol value
+        Elf64_Xword	st_size;		// Symbol size
+        */
 
-        if (!sh_map.contains(".debug_info")) {
-            std::cout << "No debug_info section" << std::endl;
-            return false;
-        }
-        Elf64_Shdr *sh_debug_info = (Elf64_Shdr *)(sh_map[".debug_info"]);
-        this->debug_info = (unsigned char *)(elf_addr + sh_debug_info->sh_offset);
-        this->debug_info_size = sh_debug_info->sh_size;
-        this->debug_info_end = debug_info + debug_info_size;
-
-        if (!sh_map.contains(".debug_str")) {
-            std::cout << "No debug_str section" << std::endl;
-            return false;
-        }
-        Elf64_Shdr *sh_debug_str = (Elf64_Shdr *)(sh_map[".debug_str"]);
-        this->debug_str = (unsigned char *)(elf_addr + sh_debug_str->sh_offset);
+        const char *symbol_name = string_table + symbols[i].st_name;
 
-        if (!sh_map.contains(".debug_line_str")) {
-            std::cout << "No debug_line_str section" << std::endl;
-            return false;
+        symbols_map[symbol_name] = (Elf64_Addr *)(&symbols[i]);
+
+        if (ELF64_ST_TYPE(symbols[i].st_info) == STT_FUNC && symbols[i].st_value != 0) {
+            function_symbols.push_back(&symbols[i]);
         }
+    }
+
+    std::sort(function_symbols.begin(), function_symbols.end(), [](Elf64_Sym *a, Elf64_Sym *b) { return a->st_value < b->st_value; });
+
+    // print_symbol("main");
+
+    if (!sh_map.contains(".debug_info")) {
+        std::cout << "No debug_info section" << std::endl;
+        return false;
+    }
+    Elf64_Shdr *sh_debug_info = (Elf64_Shdr *)(sh_map[".debug_info"]);
+    this->debug_info = (unsigned char *)(elf_addr + sh_debug_info->sh_offset);
+    this->debug_info_size = sh_debug_info->sh_size;
+    this->debug_info_end = debug_info + debug_info_size;
+
+    if (!sh_map.contains(".debug_str")) {
+        std::cout << "No debug_str section" << std::endl;
+        return false;
+    }
+    Elf64_Shdr *sh_debug_str = (Elf64_Shdr *)(sh_map[".debug_str"]);
+    this->debug_str = (unsigned char *)(elf_addr + sh_debug_str->sh_offset);
+
+    // .debug_line_str is only emitted from DWARF 5 onwards
+    if (sh_map.contains(".debug_line_str")) {
         Elf64_Shdr *sh_debug_line_str = (Elf64_Shdr *)(sh_map[".debug_line_str"]);
         this->debug_line_str = (char *)(elf_addr + sh_debug_line_str->sh_offset);
+    } else {
+        this->debug_line_str = nullptr;
+    }
 
-        if (!sh_map.contains(".debug_abbrev")) {
-            std::cout << "No debug_abbrev section" << std::endl;
-            return false;
-        }
-        Elf64_Shdr *sh_debug_abbrev = (Elf64_Shdr *)(sh_map[".debug_abbrev"]);
-        this->debug_abbrev = (unsigned char *)(elf_addr + sh_debug_abbrev->sh_offset);
-        this->debug_abbrev_size = sh_debug_abbrev->sh_size;
-        this->debug_abbrev_end = debug_abbrev + debug_abbrev_size;
-
-        /*
-        for (const auto &section : sections) {
+    if (!sh_map.contains(".debug_abbrev")) {
+        std::cout << "No debug_abbrev section" << std::endl;
+        return false;
+    }
+    Elf64_Shdr *sh_debug_abbrev = (Elf64_Shdr *)(sh_map[".debug_abbrev"]);
+    this->debug_abbrev = (unsigned char *)(elf_addr + sh_debug_abbrev->sh_offset);
+    this->debug_abbrev_size = sh_debug_abbrev->sh_size;
+    this->debug_abbrev_end = debug_abbrev + debug_abbrev_size;
 
-            if (section.type() == SHT_SYMTAB) {
+    /*
+    for (const auto &section : sections) {
 
-                std::cout << "Symbol table" << std::endl;
+        if (section.type() == SHT_SYMTAB) {
 
-                Elf64_Xword entry_size = section->sh_entsize;
+            std::cout << "Symbol table" << std::endl;
 
-                int num_symbols = section->sh_size / entry_size;
+            Elf64_Xword entry_size = section->sh_entsize;
 
-                std::cout << "Num:    Value          Size Type    Bind   Vis      Ndx Name" << std::endl;
+            int num_symbols = section->sh_size / entry_size;
 
-                Elf64_Off string_table_offset = section_header_string->sh_offset;
-                const char *string_table = (char *)(elf_addr + string_table_offset);
+            std::cout << "Num:    Value          Size Type    Bind   Vis      Ndx Name" << std::endl;
 
-                for (int s = 0; s < num_symbols; s++) {
+            Elf64_Off string_table_offset = section_header_string->sh_offset;
+            const char *string_table = (char *)(elf_addr + string_table_offset);
 
-                    // Elf64_Off string_table_offset = section_header_string->sh_offset;
-                    // const char *string_table = (char *)(elf_addr + string_table_offset);
+            for (int s = 0; s < num_symbols; s++) {
 
-                    Elf64_Sym *symPtr = (Elf64_Sym *)((char *)(elf_addr + section->sh_offset + s * entry_size));
+                // Elf64_Off string_table_offset = section_header_string->sh_offset;
+                // const char *string_table = (char *)(elf_addr + string_table_offset);
 
+                Elf64_Sym *symPtr = (Elf64_Sym *)((char *)(elf_addr + section->sh_offset + s * entry_size));
 
-                    //unsigned char	st_other;	// No defined meaning, 0
-                    //Elf64_Half st_shndx;		// Associated section index
 
+                //unsigned char	st_other;	// No defined meaning, 0
+                //Elf64_Half st_shndx;		// Associated section index
 
-                    const char *sym_name = (char *)(string_table + symPtr->st_name);
 
-                    unsigned char bind = ELF64_ST_BIND(symPtr->st_info); // Symbol's binding
-                    unsigned char type = ELF64_ST_TYPE(symPtr->st_info); // Symbol's type
+                const char *sym_name = (char *)(string_table + symPtr->st_name);
 
-                    Elf64_Xword sym_size = symPtr->st_size; // Size of object (e.g., common)
+                unsigned char bind = ELF64_ST_BIND(symPtr->st_info); // Symbol's binding
+                unsigned char type = ELF64_ST_TYPE(symPtr->st_info); // Symbol's type
 
-                    Elf64_Addr sym_value = symPtr->st_value; // Value of the symbol
+                Elf64_Xword sym_size = symPtr->st_size; // Size of object (e.g., common)
 
-                    Symbol symbol(
-                        sym_name,
-                        sym_value,
-                        sym_size,
-                        bind,
-                        type);
+                Elf64_Addr sym_value = symPtr->st_value; // Value of the symbol
 
-                    std::cout << symbol << std::endl;
-                }
+                Symbol symbol(
+                    sym_name,
+                    sym_value,
+                    sym_size,
+                    bind,
+                    type);
 
-                std::cout << "Debug" << std::endl;
+                std::cout << symbol << std::endl;
             }
+
+            std::cout << "Debug" << std::endl;
         }
+    }
 
-        */
+    */
 
-        // sections = (Elf32_Shdr *)((char *)map_start + header.e_shoff);
+    // sections = (Elf32_Shdr *)((char *)map_start + header.e_shoff);
 
-        Elf64_Off sections = header->e_shoff;
-    }
+    Elf64_Off sections = header->e_shoff;
+
+    return true;
 }
 
 // String table
@@ -185,3 +213,151 @@ void ELF::print_symbol(std::string symbol_name) {
 
     // symTable[i].st_name;
 }
+
+const unsigned char *ELF::get_section(std::string section_name, size_t &size) const {
+
+    auto it = sh_map.find(section_name);
+
+    if (it == sh_map.end()) {
+        size = 0;
+        return nullptr;
+    }
+
+    Elf64_Shdr *section = (Elf64_Shdr *)(it->second);
+
+    if (section->sh_type == SHT_NOBITS || section->sh_offset + section->sh_size > file_content.size()) {
+        size = 0;
+        return nullptr;
+    }
+
+    size = section->sh_size;
+
+    return (const unsigned char *)(elf_addr + section->sh_offset);
+}
+
+Elf64_Addr ELF::get_section_address(std::string section_name) const {
+
+    auto it = sh_map.find(section_name);
+
+    if (it == sh_map.end()) {
+        return 0;
+    }
+
+    return ((Elf64_Shdr *)(it->second))->sh_addr;
+}
+
+std::optional<Elf64_Addr> ELF::offset_to_address(Elf64_Off offset) const {
+
+    if (header->e_phoff == 0 || header->e_phentsize != sizeof(Elf64_Phdr) ||
+        header->e_phoff + (uint64_t)header->e_phnum * sizeof(Elf64_Phdr) > file_content.size()) {
+        return std::nullopt;
+    }
+
+    const Elf64_Phdr *ph = (const Elf64_Phdr *)(file_content.data() + header->e_phoff);
+
+    for (int i = 0; i < header->e_phnum; i++) {
+
+        // Mappings start at the page that holds the segment
+        Elf64_Off page_start = ph[i].p_offset & ~(Elf64_Off)0xfff;
+
+        if (ph[i].p_type == PT_LOAD && offset >= page_start && offset < ph[i].p_offset + ph[i].p_filesz) {
+            return ph[i].p_vaddr - (ph[i].p_offset - offset);
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<std::tuple<std::string, Elf64_Addr>> ELF::find_function(Elf64_Addr addr) const {
+
+    // First symbol that starts after addr
+    auto it = std::upper_bound(function_symbols.begin(), function_symbols.end(), addr,
+                               [](Elf64_Addr a, const Elf64_Sym *sym) { return a < sym->st_value; });
+
+    if (it == function_symbols.begin()) {
+        return std::nullopt;
+    }
+
+    --it;
+
+    const Elf64_Sym *symbol = *it;
+
+    if (addr >= symbol->st_value + std::max<Elf64_Xword>(symbol->st_size, 1)) {
+        return std::nullopt;
+    }
+
+    return std::make_tuple(std::string(string_table + symbol->st_name), symbol->st_value);
+}
+
+std::string read_build_id(std::filesystem::path input_file) {
+
+    int fd = ::open(input_file.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        return "";
+    }
+
+    std::string build_id = "";
+
+    Elf64_Ehdr header;
+
+    if (pread(fd, &header, sizeof(header), 0) == sizeof(header) && memcmp(header.e_ident, ELFMAG, SELFMAG) == 0 &&
+        header.e_ident[EI_CLASS] == ELFCLASS64 && header.e_shentsize == sizeof(Elf64_Shdr)) {
+
+        std::vector<Elf64_Shdr> sections(header.e_shnum);
+
+        size_t sections_size = sections.size() * sizeof(Elf64_Shdr);
+
+        if (pread(fd, sections.data(), sections_size, header.e_shoff) == (ssize_t)sections_size) {
+
+            for (auto &section : sections) {
+
+                if (section.sh_type != SHT_NOTE || section.sh_size > 4096) {
+                    continue;
+                }
+
+                std::vector<unsigned char> note(section.sh_size);
+
+                if (pread(fd, note.data(), note.size(), section.sh_offset) != (ssize_t)note.size()) {
+                    continue;
+                }
+
+                size_t pos = 0;
+
+                while (pos + sizeof(Elf64_Nhdr) <= note.size()) {
+
+                    Elf64_Nhdr *nhdr = (Elf64_Nhdr *)(note.data() + pos);
+
+                    size_t name_pos = pos + sizeof(Elf64_Nhdr);
+                    size_t desc_pos = name_pos + ((nhdr->n_namesz + 3) & ~3);
+
+                    if (desc_pos + nhdr->n_descsz > note.size()) {
+                        break;
+                    }
+
+                    if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 && memcmp(note.data() + name_pos, "GNU", 4) == 0) {
+
+                        std::stringstream ss;
+
+                        for (size_t i = 0; i < nhdr->n_descsz; i++) {
+                            ss << std::hex << std::setw(2) << std::setfill('0') << (int)note[desc_pos + i];
+                        }
+
+                        build_id = ss.str();
+                        break;
+                    }
+
+                    pos = desc_pos + ((nhdr->n_descsz + 3) & ~3);
+                }
+
+                if (build_id != "") {
+                    break;
+                }
+            }
+        }
+    }
+
+    close(fd);
+
+    return build_id;
+}
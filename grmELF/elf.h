@@ -4,8 +4,10 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <stdio.h>
 #include <string.h>
+#include <tuple>
 
 #include <vector>
 
@@ -88,6 +90,9 @@ class ELF {
 
     bool open(std::filesystem::path input_file);
 
+    // Only the section headers, for objects without symbols or debug information (e.g. stripped system libraries)
+    bool open_sections(std::filesystem::path input_file);
+
     // bool close();
 
     // std::string symbol_table(std::string symbol);
@@ -96,6 +101,22 @@ class ELF {
 
     void print_symbol(std::string symbol_name);
 
+    // Raw contents of the given section, or nullptr if the section is not present
+    const unsigned char *get_section(std::string section_name, size_t &size) const;
+
+    // Virtual address of the given section, or 0 if the section is not present
+    Elf64_Addr get_section_address(std::string section_name) const;
+
+    // ET_EXEC, ET_DYN...
+    inline Elf64_Half get_type() const { return header->e_type; }
+
+    // Link time address of a file offset, through the PT_LOAD segment that maps it. Not the offset itself with lld, which puts the
+    // executable segment a page above its file offset
+    std::optional<Elf64_Addr> offset_to_address(Elf64_Off offset) const;
+
+    // Name and start address of the function symbol that contains the given address
+    std::optional<std::tuple<std::string, Elf64_Addr>> find_function(Elf64_Addr addr) const;
+
   private:
     std::filesystem::path file_path;
 
@@ -129,6 +150,12 @@ class ELF {
 
     // Symbol name, symbol address
     std::map<std::string, Elf64_Addr *> symbols_map;
+
+    // STT_FUNC symbols sorted by address
+    std::vector<Elf64_Sym *> function_symbols;
 };
 
 int32_t read_elf_header(const char *elfFile, ElfW(Ehdr) & header);
+
+// GNU build-id of the given ELF file as an hex string, or "" if the file has none. Only the headers and the note are read.
+std::string read_build_id(std::filesystem::path input_file);
@@ -0,0 +1,564 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#include "frame.h"
+
+bool DWARF_frame::load(const ELF &elf) {
+
+    eh_frame = elf.get_section(".eh_frame", eh_frame_size);
+
+    if (eh_frame == nullptr) {
+        return false;
+    }
+
+    eh_frame_addr = elf.get_section_address(".eh_frame");
+
+    cies.clear();
+    fdes.clear();
+
+    // .eh_frame offset of each CIE -> index in cies
+    std::unordered_map<uint64_t, uint32_t> cie_offsets;
+
+    const unsigned char *ptr = eh_frame;
+    const unsigned char *end = eh_frame + eh_frame_size;
+
+    while (ptr + 4 <= end) {
+
+        const unsigned char *entry = ptr;
+
+        uint64_t length = *(uint32_t *)ptr;
+        ptr += 4;
+
+        // Terminator
+        if (length == 0) {
+            break;
+        }
+
+        if (length == 0xffffffff) {
+
+            if (ptr + 8 > end) {
+                return false;
+            }
+
+            length = *(uint64_t *)ptr;
+            ptr += 8;
+        }
+
+        const unsigned char *entry_end = ptr + length;
+
+        if (entry_end > end || length < 4) {
+            return false;
+        }
+
+        const unsigned char *id_ptr = ptr;
+
+        uint32_t id = *(uint32_t *)ptr;
+        ptr += 4;
+
+        if (id == 0) {
+
+            DWARF_CIE cie;
+
+            if (read_cie(ptr, entry_end, cie)) {
+                cie_offsets[entry - eh_frame] = cies.size();
+                cies.push_back(cie);
+            }
+
+        } else {
+
+            // Distance back from the id field to the CIE
+            uint64_t cie_offset = (id_ptr - eh_frame) - id;
+
+            auto it = cie_offsets.find(cie_offset);
+
+            // CIEs always come before their FDEs in the output of the linkers
+            if (it != cie_offsets.end()) {
+
+                const DWARF_CIE &cie = cies[it->second];
+
+                uint64_t pc_begin;
+                uint64_t pc_range;
+
+                if (read_pointer(ptr, entry_end, cie.fde_encoding, pc_begin) && read_pointer(ptr, entry_end, cie.fde_encoding & 0x0f, pc_range)) {
+
+                    if (cie.augmentation_data) {
+
+                        unsigned n;
+                        uint64_t augmentation_length = decodeULEB128(ptr, &n, entry_end);
+                        ptr += n + augmentation_length;
+                    }
+
+                    // Discarded sections leave FDEs for address 0 behind
+                    if (ptr <= entry_end && pc_begin != 0 && pc_range != 0) {
+                        fdes.push_back({pc_begin, pc_begin + pc_range, it->second, ptr, entry_end});
+                    }
+                }
+            }
+        }
+
+        ptr = entry_end;
+    }
+
+    std::sort(fdes.begin(), fdes.end(), [](const DWARF_FDE &a, const DWARF_FDE &b) { return a.pc_begin < b.pc_begin; });
+
+    return !fdes.empty();
+}
+
+bool DWARF_frame::read_cie(const unsigned char *ptr, const unsigned char *end, DWARF_CIE &cie) const {
+
+    unsigned n;
+
+    if (ptr >= end) {
+        return false;
+    }
+
+    uint8_t version = *ptr++;
+
+    if (version != 1 && version != 3 && version != 4) {
+        return false;
+    }
+
+    const char *augmentation = (const char *)ptr;
+    size_t augmentation_size = strnlen(augmentation, end - ptr);
+
+    ptr += augmentation_size + 1;
+
+    // Pre-'z' GCC augmentation with an extra pointer, long gone
+    if (strstr(augmentation, "eh") != nullptr) {
+        return false;
+    }
+
+    if (version == 4) {
+        ptr += 2; // address_size, segment_selector_size
+    }
+
+    cie.code_align = decodeULEB128(ptr, &n, end);
+    ptr += n;
+
+    cie.data_align = decodeSLEB128(ptr, &n, end);
+    ptr += n;
+
+    if (version == 1) {
+        cie.ra_register = *ptr++;
+    } else {
+        cie.ra_register = decodeULEB128(ptr, &n, end);
+        ptr += n;
+    }
+
+    const unsigned char *augmentation_end = nullptr;
+
+    for (size_t i = 0; i < augmentation_size; i++) {
+
+        switch (augmentation[i]) {
+
+        case 'z': {
+            uint64_t augmentation_length = decodeULEB128(ptr, &n, end);
+            ptr += n;
+            augmentation_end = ptr + augmentation_length;
+            cie.augmentation_data = true;
+            break;
+        }
+
+        case 'L':
+            ptr++; // LSDA encoding
+            break;
+
+        case 'P': {
+            uint8_t encoding = *ptr++;
+            uint64_t personality;
+            if (!read_pointer(ptr, end, encoding & ~DW_EH_PE_indirect, personality)) {
+                return false;
+            }
+            break;
+        }
+
+        case 'R':
+            cie.fde_encoding = *ptr++;
+            break;
+
+        case 'S':
+        case 'B':
+            break;
+
+        default:
+            // Unknown augmentation, the rest can only be skipped with 'z'
+            if (augmentation_end == nullptr) {
+                return false;
+            }
+            ptr = augmentation_end;
+            i = augmentation_size;
+            break;
+        }
+    }
+
+    if (augmentation_end != nullptr) {
+        ptr = augmentation_end;
+    }
+
+    if (ptr > end) {
+        return false;
+    }
+
+    cie.instructions = ptr;
+    cie.instructions_end = end;
+
+    return true;
+}
+
+// Fixed-size field, unaligned in .eh_frame. false if it runs past end
+template <typename T> static bool read_fixed(const unsigned char *&ptr, const unsigned char *end, T &value) {
+
+    if (ptr + sizeof(T) > end) {
+        return false;
+    }
+
+    memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+
+    return true;
+}
+
+bool DWARF_frame::read_pointer(const unsigned char *&ptr, const unsigned char *end, uint8_t encoding, uint64_t &value) const {
+
+    if (encoding == DW_EH_PE_omit) {
+        value = 0;
+        return true;
+    }
+
+    // Link time address of the field, for pcrel
+    uint64_t field_addr = eh_frame_addr + (ptr - eh_frame);
+
+    unsigned n;
+
+    switch (encoding & 0x0f) {
+
+    case DW_EH_PE_absptr:
+    case DW_EH_PE_udata8:
+    case DW_EH_PE_sdata8:
+        if (!read_fixed(ptr, end, value)) {
+            return false;
+        }
+        break;
+
+    case DW_EH_PE_udata2: {
+        uint16_t field;
+        if (!read_fixed(ptr, end, field)) {
+            return false;
+        }
+        value = field;
+        break;
+    }
+
+    case DW_EH_PE_sdata2: {
+        int16_t field;
+        if (!read_fixed(ptr, end, field)) {
+            return false;
+        }
+        value = (int64_t)field;
+        break;
+    }
+
+    case DW_EH_PE_udata4: {
+        uint32_t field;
+        if (!read_fixed(ptr, end, field)) {
+            return false;
+        }
+        value = field;
+        break;
+    }
+
+    case DW_EH_PE_sdata4: {
+        int32_t field;
+        if (!read_fixed(ptr, end, field)) {
+            return false;
+        }
+        value = (int64_t)field;
+        break;
+    }
+
+    case DW_EH_PE_uleb128:
+        value = decodeULEB128(ptr, &n, end);
+        ptr += n;
+        break;
+
+    case DW_EH_PE_sleb128:
+        value = decodeSLEB128(ptr, &n, end);
+        ptr += n;
+        break;
+
+    default:
+        return false;
+    }
+
+    switch (encoding & 0x70) {
+
+    case 0:
+        break;
+
+    case DW_EH_PE_pcrel:
+        value += field_addr;
+        break;
+
+    default:
+        // textrel/datarel/funcrel are not emitted for x86-64 .eh_frame
+        return false;
+    }
+
+    return true;
+}
+
+bool DWARF_frame::execute(const DWARF_CIE &cie, const unsigned char *ptr, const unsigned char *end, Elf64_Addr loc, Elf64_Addr addr,
+                          const DWARF_frame_row &initial, DWARF_frame_row &row) const {
+
+    std::vector<DWARF_frame_row> stack;
+
+    unsigned n;
+
+    auto uleb = [&]() {
+        uint64_t value = decodeULEB128(ptr, &n, end);
+        ptr += n;
+        return value;
+    };
+
+    auto sleb = [&]() {
+        int64_t value = decodeSLEB128(ptr, &n, end);
+        ptr += n;
+        return value;
+    };
+
+    auto set_rule = [&](uint64_t reg, DWARF_RULE rule, int64_t value) {
+        if (reg < DW_REG_COUNT) {
+            row.regs[reg] = {rule, value};
+        }
+    };
+
+    auto restore_rule = [&](uint64_t reg) {
+        if (reg < DW_REG_COUNT) {
+            row.regs[reg] = initial.regs[reg];
+        }
+    };
+
+    while (ptr < end) {
+
+        uint8_t opcode = *ptr++;
+
+        uint8_t operand = opcode & 0x3f;
+
+        // Primary opcodes
+        switch (opcode & 0xc0) {
+
+        case DW_CFA_advance_loc:
+            loc += operand * cie.code_align;
+            if (loc > addr) {
+                return true;
+            }
+            continue;
+
+        case DW_CFA_offset:
+            set_rule(operand, DWARF_RULE::OFFSET, uleb() * cie.data_align);
+            continue;
+
+        case DW_CFA_restore:
+            restore_rule(operand);
+            continue;
+        }
+
+        uint64_t reg;
+        uint64_t length;
+
+        switch (opcode) {
+
+        case DW_CFA_nop:
+            break;
+
+        case DW_CFA_set_loc: {
+            uint64_t value;
+            if (!read_pointer(ptr, end, cie.fde_encoding, value)) {
+                return false;
+            }
+            loc = value;
+            if (loc > addr) {
+                return true;
+            }
+            break;
+        }
+
+        case DW_CFA_advance_loc1: {
+            uint8_t delta;
+            if (!read_fixed(ptr, end, delta)) {
+                return false;
+            }
+            loc += delta * cie.code_align;
+            if (loc > addr) {
+                return true;
+            }
+            break;
+        }
+
+        case DW_CFA_advance_loc2: {
+            uint16_t delta;
+            if (!read_fixed(ptr, end, delta)) {
+                return false;
+            }
+            loc += delta * cie.code_align;
+            if (loc > addr) {
+                return true;
+            }
+            break;
+        }
+
+        case DW_CFA_advance_loc4: {
+            uint32_t delta;
+            if (!read_fixed(ptr, end, delta)) {
+                return false;
+            }
+            loc += delta * cie.code_align;
+            if (loc > addr) {
+                return true;
+            }
+            break;
+        }
+
+        case DW_CFA_offset_extended:
+            reg = uleb();
+            set_rule(reg, DWARF_RULE::OFFSET, uleb() * cie.data_align);
+            break;
+
+        case DW_CFA_offset_extended_sf:
+            reg = uleb();
+            set_rule(reg, DWARF_RULE::OFFSET, sleb() * cie.data_align);
+            break;
+
+        case DW_CFA_GNU_negative_offset_extended:
+            reg = uleb();
+            set_rule(reg, DWARF_RULE::OFFSET, -(int64_t)uleb() * cie.data_align);
+            break;
+
+        case DW_CFA_val_offset:
+            reg = uleb();
+            set_rule(reg, DWARF_RULE::VAL_OFFSET, uleb() * cie.data_align);
+            break;
+
+        case DW_CFA_val_offset_sf:
+            reg = uleb();
+            set_rule(reg, DWARF_RULE::VAL_OFFSET, sleb() * cie.data_align);
+            break;
+
+        case DW_CFA_restore_extended:
+            restore_rule(uleb());
+            break;
+
+        case DW_CFA_undefined:
+            set_rule(uleb(), DWARF_RULE::UNDEFINED, 0);
+            break;
+
+        case DW_CFA_same_value:
+            set_rule(uleb(), DWARF_RULE::SAME_VALUE, 0);
+            break;
+
+        case DW_CFA_register:
+            reg = uleb();
+            set_rule(reg, DWARF_RULE::REGISTER, uleb());
+            break;
+
+        case DW_CFA_remember_state:
+            stack.push_back(row);
+            break;
+
+        case DW_CFA_restore_state:
+            if (stack.empty()) {
+                return false;
+            }
+            // The CFA is restored too, as GCC expects
+            row = stack.back();
+            stack.pop_back();
+            break;
+
+        case DW_CFA_def_cfa:
+            row.cfa_register = uleb();
+            row.cfa_offset = uleb();
+            row.cfa_expression = false;
+            break;
+
+        case DW_CFA_def_cfa_sf:
+            row.cfa_register = uleb();
+            row.cfa_offset = sleb() * cie.data_align;
+            row.cfa_expression = false;
+            break;
+
+        case DW_CFA_def_cfa_register:
+            row.cfa_register = uleb();
+            row.cfa_expression = false;
+            break;
+
+        case DW_CFA_def_cfa_offset:
+            row.cfa_offset = uleb();
+            break;
+
+        case DW_CFA_def_cfa_offset_sf:
+            row.cfa_offset = sleb() * cie.data_align;
+            break;
+
+        case DW_CFA_def_cfa_expression:
+            length = uleb();
+            ptr += length;
+            row.cfa_expression = true;
+            break;
+
+        case DW_CFA_expression:
+        case DW_CFA_val_expression:
+            reg = uleb();
+            length = uleb();
+            ptr += length;
+            set_rule(reg, DWARF_RULE::EXPRESSION, 0);
+            break;
+
+        case DW_CFA_GNU_args_size:
+            uleb();
+            break;
+
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::optional<DWARF_frame_row> DWARF_frame::lookup(Elf64_Addr addr) const {
+
+    // Last FDE that starts at or before addr
+    auto it = std::upper_bound(fdes.begin(), fdes.end(), addr, [](Elf64_Addr a, const DWARF_FDE &fde) { return a < fde.pc_begin; });
+
+    if (it == fdes.begin()) {
+        return std::nullopt;
+    }
+
+    const DWARF_FDE &fde = *(--it);
+
+    if (addr >= fde.pc_end) {
+        return std::nullopt;
+    }
+
+    const DWARF_CIE &cie = cies[fde.cie];
+
+    DWARF_frame_row initial;
+
+    // Registers without a rule keep their value, except the return address
+    initial.regs[DW_REG_RA] = {DWARF_RULE::UNDEFINED, 0};
+
+    if (!execute(cie, cie.instructions, cie.instructions_end, fde.pc_begin, UINT64_MAX, initial, initial)) {
+        return std::nullopt;
+    }
+
+    DWARF_frame_row row = initial;
+
+    if (!execute(cie, fde.instructions, fde.instructions_end, fde.pc_begin, addr, initial, row)) {
+        return std::nullopt;
+    }
+
+    // The CIE may name another column as the return address
+    if (cie.ra_register != DW_REG_RA && cie.ra_register < DW_REG_COUNT) {
+        row.regs[DW_REG_RA] = row.regs[cie.ra_register];
+    }
+
+    return row;
+}
@@ -0,0 +1,153 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "elf.h"
+
+// Call frame instructions (DWARF 5, Section 6.4.2)
+enum DW_CFA : uint8_t {
+    DW_CFA_nop = 0x00,
+    DW_CFA_set_loc = 0x01,
+    DW_CFA_advance_loc1 = 0x02,
+    DW_CFA_advance_loc2 = 0x03,
+    DW_CFA_advance_loc4 = 0x04,
+    DW_CFA_offset_extended = 0x05,
+    DW_CFA_restore_extended = 0x06,
+    DW_CFA_undefined = 0x07,
+    DW_CFA_same_value = 0x08,
+    DW_CFA_register = 0x09,
+    DW_CFA_remember_state = 0x0a,
+    DW_CFA_restore_state = 0x0b,
+    DW_CFA_def_cfa = 0x0c,
+    DW_CFA_def_cfa_register = 0x0d,
+    DW_CFA_def_cfa_offset = 0x0e,
+    DW_CFA_def_cfa_expression = 0x0f,
+    DW_CFA_expression = 0x10,
+    DW_CFA_offset_extended_sf = 0x11,
+    DW_CFA_def_cfa_sf = 0x12,
+    DW_CFA_def_cfa_offset_sf = 0x13,
+    DW_CFA_val_offset = 0x14,
+    DW_CFA_val_offset_sf = 0x15,
+    DW_CFA_val_expression = 0x16,
+    DW_CFA_GNU_args_size = 0x2e,
+    DW_CFA_GNU_negative_offset_extended = 0x2f,
+
+    // High 2 bits, the operand is in the low 6 bits
+    DW_CFA_advance_loc = 0x40,
+    DW_CFA_offset = 0x80,
+    DW_CFA_restore = 0xc0
+};
+
+// .eh_frame pointer encodings (LSB 5.0, Section 10.5.1)
+enum DW_EH_PE : uint8_t {
+    DW_EH_PE_absptr = 0x00,
+    DW_EH_PE_uleb128 = 0x01,
+    DW_EH_PE_udata2 = 0x02,
+    DW_EH_PE_udata4 = 0x03,
+    DW_EH_PE_udata8 = 0x04,
+    DW_EH_PE_sleb128 = 0x09,
+    DW_EH_PE_sdata2 = 0x0a,
+    DW_EH_PE_sdata4 = 0x0b,
+    DW_EH_PE_sdata8 = 0x0c,
+
+    DW_EH_PE_pcrel = 0x10,
+    DW_EH_PE_datarel = 0x30,
+    DW_EH_PE_indirect = 0x80,
+
+    DW_EH_PE_omit = 0xff
+};
+
+// x86-64 DWARF register numbers (System V AMD64 ABI, Figure 3.36). Only the general purpose registers and the return address are tracked
+enum DW_REG_X86_64 : uint8_t {
+    DW_REG_RAX = 0,
+    DW_REG_RDX = 1,
+    DW_REG_RCX = 2,
+    DW_REG_RBX = 3,
+    DW_REG_RSI = 4,
+    DW_REG_RDI = 5,
+    DW_REG_RBP = 6,
+    DW_REG_RSP = 7,
+    DW_REG_R8 = 8,
+    DW_REG_R15 = 15,
+    DW_REG_RA = 16,
+    DW_REG_COUNT = 17
+};
+
+enum class DWARF_RULE : uint8_t {
+    UNDEFINED,  // Not recoverable (for the return address: outermost frame)
+    SAME_VALUE, // Not modified by this frame
+    OFFSET,     // Saved at CFA + offset
+    VAL_OFFSET, // Value is CFA + offset
+    REGISTER,   // Saved in another register
+    EXPRESSION  // DWARF expression, not evaluated
+};
+
+struct DWARF_reg_rule {
+    DWARF_RULE rule = DWARF_RULE::SAME_VALUE;
+    int64_t value = 0; // Offset or register number
+};
+
+// Row of the call frame table for one address
+struct DWARF_frame_row {
+    uint64_t cfa_register = DW_REG_RSP;
+    int64_t cfa_offset = 0;
+    bool cfa_expression = false;
+
+    std::array<DWARF_reg_rule, DW_REG_COUNT> regs = {};
+};
+
+struct DWARF_CIE {
+    uint64_t code_align = 1;
+    int64_t data_align = 1;
+    uint64_t ra_register = DW_REG_RA;
+    uint8_t fde_encoding = DW_EH_PE_absptr;
+    bool augmentation_data = false; // 'z', FDEs have an augmentation length
+    const unsigned char *instructions = nullptr;
+    const unsigned char *instructions_end = nullptr;
+};
+
+struct DWARF_FDE {
+    Elf64_Addr pc_begin;
+    Elf64_Addr pc_end;
+    uint32_t cie; // Index in DWARF_frame::cies
+    const unsigned char *instructions;
+    const unsigned char *instructions_end;
+};
+
+// .eh_frame reader. The FDEs are indexed once and kept sorted by address, the instructions of the matching one are run on each lookup.
+// The ELF object must outlive it.
+class DWARF_frame {
+
+  public:
+    DWARF_frame() {}
+
+    bool load(const ELF &elf);
+
+    // Unwind rules at the given (link time) address, nullopt if no FDE covers it
+    std::optional<DWARF_frame_row> lookup(Elf64_Addr addr) const;
+
+    inline size_t num_fdes() const { return fdes.size(); }
+
+  private:
+    const unsigned char *eh_frame = nullptr;
+    size_t eh_frame_size = 0;
+    Elf64_Addr eh_frame_addr = 0;
+
+    std::vector<DWARF_CIE> cies;
+
+    std::vector<DWARF_FDE> fdes;
+
+    bool read_cie(const unsigned char *ptr, const unsigned char *end, DWARF_CIE &cie) const;
+
+    bool read_pointer(const unsigned char *&ptr, const unsigned char *end, uint8_t encoding, uint64_t &value) const;
+
+    // Runs the instructions until the location passes addr. initial holds the CIE rules, for DW_CFA_restore
+    bool execute(const DWARF_CIE &cie, const unsigned char *ptr, const unsigned char *end, Elf64_Addr loc, Elf64_Addr addr,
+                 const DWARF_frame_row &initial, DWARF_frame_row &row) const;
+};
@@ -0,0 +1,755 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#include "line.h"
+
+bool DWARF_line::load(const ELF &elf) {
+
+    debug_line = elf.get_section(".debug_line", debug_line_size);
+
+    if (debug_line == nullptr || debug_line_size == 0) {
+        return false;
+    }
+
+    debug_str = elf.get_section(".debug_str", debug_str_size);
+    debug_line_str = elf.get_section(".debug_line_str", debug_line_str_size);
+
+    debug_info = elf.get_section(".debug_info", debug_info_size);
+    debug_abbrev = elf.get_section(".debug_abbrev", debug_abbrev_size);
+
+    load_comp_dirs();
+
+    const unsigned char *ptr = debug_line;
+    const unsigned char *end = debug_line + debug_line_size;
+
+    while (ptr < end) { // For each line number program
+
+        if (!read_unit(ptr, end)) {
+            break;
+        }
+    }
+
+    // Each sequence is a contiguous run of rows terminated by DW_LNE_end_sequence. Sort the sequences by start address so the
+    // whole table can be binary searched.
+    std::vector<std::pair<size_t, size_t>> sequences;
+
+    size_t first = 0;
+
+    for (size_t i = 0; i < rows.size(); i++) {
+
+        if (rows[i].end_sequence) {
+
+            // Sequences starting at 0 belong to functions discarded by the linker
+            if (rows[first].address != 0) {
+                sequences.push_back({first, i + 1});
+            }
+
+            first = i + 1;
+        }
+    }
+
+    std::sort(sequences.begin(), sequences.end(), [this](const std::pair<size_t, size_t> &a, const std::pair<size_t, size_t> &b) {
+        return rows[a.first].address < rows[b.first].address;
+    });
+
+    std::vector<DWARF_line_row> sorted_rows;
+    sorted_rows.reserve(rows.size());
+
+    for (auto &seq : sequences) {
+        sorted_rows.insert(sorted_rows.end(), rows.begin() + seq.first, rows.begin() + seq.second);
+    }
+
+    rows = std::move(sorted_rows);
+
+    return !rows.empty();
+}
+
+std::optional<std::tuple<std::filesystem::path, size_t>> DWARF_line::lookup(Elf64_Addr addr) const {
+
+    // Last row whose address is <= addr
+    auto it = std::upper_bound(rows.begin(), rows.end(), addr, [](Elf64_Addr a, const DWARF_line_row &row) { return a < row.address; });
+
+    if (it == rows.begin()) {
+        return std::nullopt;
+    }
+
+    --it;
+
+    // The address falls in a gap between two sequences
+    if (it->end_sequence) {
+        return std::nullopt;
+    }
+
+    if (it->file >= files.size()) {
+        return std::make_tuple(std::filesystem::path(""), (size_t)it->line);
+    }
+
+    return std::make_tuple(files[it->file], (size_t)it->line);
+}
+
+// Before DWARF 5 the compilation directory is not part of the line number program header, so it is read from the root DIE
+// of every compilation unit (only DW_AT_stmt_list and DW_AT_comp_dir are decoded)
+void DWARF_line::load_comp_dirs() {
+
+    if (debug_info == nullptr || debug_abbrev == nullptr) {
+        return;
+    }
+
+    const unsigned char *ptr = debug_info;
+    const unsigned char *end = debug_info + debug_info_size;
+    const unsigned char *abbrev_end = debug_abbrev + debug_abbrev_size;
+
+    unsigned n;
+
+    while (end - ptr >= 4) { // For each Compilation Unit
+
+        bool is_64bit = false;
+
+        uint64_t unit_length = *(uint32_t *)ptr;
+        ptr += sizeof(uint32_t);
+
+        if (unit_length == 0xffffffff) {
+            unit_length = *(uint64_t *)ptr;
+            ptr += sizeof(uint64_t);
+            is_64bit = true;
+        }
+
+        if (unit_length > (uint64_t)(end - ptr)) {
+            return;
+        }
+
+        const unsigned char *unit_end = ptr + unit_length;
+
+        const unsigned char *p = ptr;
+        ptr = unit_end;
+
+        uint16_t version = *(uint16_t *)p;
+        p += sizeof(uint16_t);
+
+        if (version >= 5) {
+            // Only full and partial units carry a line number program for this object
+            uint8_t unit_type = *p++;
+            if (unit_type != DW_UT_compile && unit_type != DW_UT_partial) {
+                continue;
+            }
+        }
+
+        uint8_t address_size = sizeof(Elf64_Addr);
+
+        if (version >= 5) {
+            address_size = *p++;
+        }
+
+        uint64_t abbrev_offset;
+
+        if (is_64bit) {
+            abbrev_offset = *(uint64_t *)p;
+            p += sizeof(uint64_t);
+        } else {
+            abbrev_offset = *(uint32_t *)p;
+            p += sizeof(uint32_t);
+        }
+
+        if (version < 5) {
+            address_size = *p++;
+        }
+
+        if (abbrev_offset >= debug_abbrev_size) {
+            continue;
+        }
+
+        uint64_t abbrev_code = decodeULEB128(p, &n, unit_end);
+        p += n;
+
+        // Find the abbreviation declaration of the root DIE
+        const unsigned char *decl = debug_abbrev + abbrev_offset;
+        bool found = false;
+
+        while (decl < abbrev_end) {
+
+            uint64_t code = decodeULEB128(decl, &n, abbrev_end);
+            decl += n;
+
+            if (code == 0) {
+                break;
+            }
+
+            decodeULEB128(decl, &n, abbrev_end); // Tag
+            decl += n;
+            decl++; // Children
+
+            if (code == abbrev_code) {
+                found = true;
+                break;
+            }
+
+            // Skip the attribute specifications
+            while (decl < abbrev_end) {
+                uint64_t at = decodeULEB128(decl, &n, abbrev_end);
+                decl += n;
+                uint64_t form = decodeULEB128(decl, &n, abbrev_end);
+                decl += n;
+
+                if (form == DW_FORM_implicit_const) {
+                    decodeSLEB128(decl, &n, abbrev_end);
+                    decl += n;
+                }
+
+                if (at == 0 && form == 0) {
+                    break;
+                }
+            }
+        }
+
+        if (!found) {
+            continue;
+        }
+
+        std::optional<uint64_t> stmt_list;
+        const char *comp_dir = nullptr;
+
+        while (decl < abbrev_end && p < unit_end) {
+
+            DW_AT at = static_cast<DW_AT>(decodeULEB128(decl, &n, abbrev_end));
+            decl += n;
+            DW_FORM form = static_cast<DW_FORM>(decodeULEB128(decl, &n, abbrev_end));
+            decl += n;
+
+            if (form == DW_FORM_implicit_const) {
+                decodeSLEB128(decl, &n, abbrev_end);
+                decl += n;
+            }
+
+            if (at == 0 && form == 0) {
+                break;
+            }
+
+            if (at == DW_AT_stmt_list && (form == DW_FORM_sec_offset || form == DW_FORM_data4)) {
+                stmt_list = *(uint32_t *)p;
+                p += sizeof(uint32_t);
+
+            } else if (at == DW_AT_stmt_list && form == DW_FORM_data8) {
+                stmt_list = *(uint64_t *)p;
+                p += sizeof(uint64_t);
+
+            } else if (at == DW_AT_comp_dir) {
+                comp_dir = read_string(p, unit_end, form, is_64bit);
+
+            } else if (!skip_form(p, unit_end, form, is_64bit, address_size)) {
+                break;
+            }
+        }
+
+        if (stmt_list.has_value() && comp_dir != nullptr) {
+            comp_dirs[stmt_list.value()] = comp_dir;
+        }
+    }
+}
+
+// Page 148-160 Version 5 DWARF
+bool DWARF_line::read_unit(const unsigned char *&ptr, const unsigned char *end) {
+
+    if (end - ptr < 4) {
+        return false;
+    }
+
+    bool is_64bit = false;
+
+    uint64_t unit_length = *(uint32_t *)ptr;
+    ptr += sizeof(uint32_t);
+
+    if (unit_length == 0xffffffff) {
+
+        if (end - ptr < 8) {
+            return false;
+        }
+
+        unit_length = *(uint64_t *)ptr;
+        ptr += sizeof(uint64_t);
+        is_64bit = true;
+    }
+
+    if (unit_length > (uint64_t)(end - ptr)) {
+        return false;
+    }
+
+    uint64_t unit_offset = (ptr - debug_line) - (is_64bit ? 12 : 4);
+
+    const unsigned char *unit_end = ptr + unit_length;
+
+    // From here on, errors only discard the current unit
+    const unsigned char *p = ptr;
+    ptr = unit_end;
+
+    unsigned n;
+
+    uint16_t version = *(uint16_t *)p;
+    p += sizeof(uint16_t);
+
+    if (version < 2 || version > 5) {
+        return true;
+    }
+
+    uint8_t address_size = sizeof(Elf64_Addr);
+
+    if (version >= 5) {
+        address_size = *p++;
+        p++; // segment_selector_size
+    }
+
+    uint64_t header_length;
+
+    if (is_64bit) {
+        header_length = *(uint64_t *)p;
+        p += sizeof(uint64_t);
+    } else {
+        header_length = *(uint32_t *)p;
+        p += sizeof(uint32_t);
+    }
+
+    const unsigned char *program = p + header_length;
+
+    if (program > unit_end) {
+        return true;
+    }
+
+    uint8_t min_inst_length = *p++;
+
+    if (version >= 4) {
+        p++; // maximum_operations_per_instruction (only used by VLIW targets)
+    }
+
+    p++; // default_is_stmt
+
+    int8_t line_base = (int8_t)*p++;
+    uint8_t line_range = *p++;
+    uint8_t opcode_base = *p++;
+
+    if (line_range == 0 || opcode_base == 0) {
+        return true;
+    }
+
+    std::vector<uint8_t> standard_opcode_lengths(p, p + opcode_base - 1);
+    p += opcode_base - 1;
+
+    std::vector<std::filesystem::path> include_dirs;
+
+    // Global index of file register 0 of this unit
+    size_t file_base = files.size();
+
+    auto add_file = [&](const char *name, uint64_t dir_index) {
+        std::filesystem::path file_path = name ? name : "";
+
+        if (file_path.is_relative() && dir_index < include_dirs.size()) {
+            file_path = include_dirs[dir_index] / file_path;
+        }
+
+        files.push_back(file_path.lexically_normal());
+    };
+
+    if (version >= 5) {
+
+        for (int table = 0; table < 2; table++) { // Directories, then file names
+
+            uint8_t format_count = *p++;
+
+            std::vector<std::pair<uint64_t, DW_FORM>> formats;
+
+            for (int i = 0; i < format_count; i++) {
+                uint64_t content_type = decodeULEB128(p, &n, unit_end);
+                p += n;
+                DW_FORM form = static_cast<DW_FORM>(decodeULEB128(p, &n, unit_end));
+                p += n;
+                formats.push_back({content_type, form});
+            }
+
+            uint64_t count = decodeULEB128(p, &n, unit_end);
+            p += n;
+
+            for (uint64_t i = 0; i < count; i++) {
+
+                const char *name = nullptr;
+                uint64_t dir_index = 0;
+
+                for (auto &format : formats) {
+
+                    if (format.first == DW_LNCT_path) {
+                        name = read_string(p, unit_end, format.second, is_64bit);
+
+                    } else if (format.first == DW_LNCT_directory_index && format.second == DW_FORM_udata) {
+                        dir_index = decodeULEB128(p, &n, unit_end);
+                        p += n;
+
+                    } else if (format.first == DW_LNCT_directory_index && format.second == DW_FORM_data1) {
+                        dir_index = *p++;
+
+                    } else if (format.first == DW_LNCT_directory_index && format.second == DW_FORM_data2) {
+                        dir_index = *(uint16_t *)p;
+                        p += sizeof(uint16_t);
+
+                    } else if (!skip_form(p, unit_end, format.second, is_64bit)) {
+                        return true;
+                    }
+
+                    if (p > unit_end) {
+                        return true;
+                    }
+                }
+
+                if (table == 0) {
+
+                    std::filesystem::path dir = name ? name : "";
+
+                    // Directory 0 is the compilation directory, the rest are relative to it
+                    if (!include_dirs.empty() && dir.is_relative()) {
+                        dir = include_dirs[0] / dir;
+                    }
+
+                    include_dirs.push_back(dir);
+
+                } else {
+                    add_file(name, dir_index);
+                }
+            }
+        }
+
+    } else {
+
+        // Directory 0 is the compilation directory, which is only known through DW_AT_comp_dir
+        auto comp_dir = comp_dirs.find(unit_offset);
+
+        if (comp_dir != comp_dirs.end()) {
+            include_dirs.push_back(comp_dir->second);
+        } else {
+            include_dirs.push_back("");
+        }
+
+        while (p < program && *p != 0) {
+            const char *dir = (const char *)p;
+            p += strnlen(dir, program - p) + 1;
+            include_dirs.push_back(include_dirs[0] / dir);
+        }
+        p++;
+
+        // File register 0 is not used before DWARF 5
+        files.push_back("");
+
+        while (p < program && *p != 0) {
+
+            const char *name = (const char *)p;
+            p += strnlen(name, program - p) + 1;
+
+            uint64_t dir_index = decodeULEB128(p, &n, program);
+            p += n;
+            decodeULEB128(p, &n, program); // Modification time
+            p += n;
+            decodeULEB128(p, &n, program); // File length
+            p += n;
+
+            add_file(name, dir_index);
+        }
+    }
+
+    // Line number program state machine
+    p = program;
+
+    Elf64_Addr address = 0;
+    uint64_t file = 1;
+    int64_t line = 1;
+
+    auto emit_row = [&](bool end_sequence) {
+        uint64_t index = file_base + file;
+
+        if (index >= files.size()) {
+            index = UINT32_MAX;
+        }
+
+        rows.push_back({address, (uint32_t)index, (uint32_t)line, end_sequence});
+    };
+
+    while (p < unit_end) {
+
+        uint8_t opcode = *p++;
+
+        if (opcode >= opcode_base) { // Special opcode
+
+            uint8_t adjusted_opcode = opcode - opcode_base;
+
+            address += (adjusted_opcode / line_range) * min_inst_length;
+            line += line_base + (adjusted_opcode % line_range);
+
+            emit_row(false);
+
+        } else if (opcode == 0) { // Extended opcode
+
+            uint64_t length = decodeULEB128(p, &n, unit_end);
+            p += n;
+
+            const unsigned char *next = p + length;
+
+            if (length == 0 || next > unit_end) {
+                break;
+            }
+
+            uint8_t sub_opcode = *p++;
+
+            switch (sub_opcode) {
+
+            case DW_LNE_end_sequence: {
+
+                emit_row(true);
+
+                address = 0;
+                file = 1;
+                line = 1;
+
+                break;
+            }
+
+            case DW_LNE_set_address: {
+
+                if (address_size == sizeof(uint32_t)) {
+                    address = *(uint32_t *)p;
+                } else {
+                    address = *(uint64_t *)p;
+                }
+
+                break;
+            }
+
+            case DW_LNE_define_file: {
+
+                const char *name = (const char *)p;
+                p += strnlen(name, next - p) + 1;
+
+                uint64_t dir_index = decodeULEB128(p, &n, next);
+
+                add_file(name, dir_index);
+
+                break;
+            }
+
+            default:
+                break;
+            }
+
+            p = next;
+
+        } else { // Standard opcode
+
+            switch (opcode) {
+
+            case DW_LNS_copy: {
+                emit_row(false);
+                break;
+            }
+
+            case DW_LNS_advance_pc: {
+                address += decodeULEB128(p, &n, unit_end) * min_inst_length;
+                p += n;
+                break;
+            }
+
+            case DW_LNS_advance_line: {
+                line += decodeSLEB128(p, &n, unit_end);
+                p += n;
+                break;
+            }
+
+            case DW_LNS_set_file: {
+                file = decodeULEB128(p, &n, unit_end);
+                p += n;
+                break;
+            }
+
+            case DW_LNS_const_add_pc: {
+                address += ((255 - opcode_base) / line_range) * min_inst_length;
+                break;
+            }
+
+            case DW_LNS_fixed_advance_pc: {
+                address += *(uint16_t *)p;
+                p += sizeof(uint16_t);
+                break;
+            }
+
+            case DW_LNS_negate_stmt:
+            case DW_LNS_set_basic_block:
+            case DW_LNS_set_prologue_end:
+            case DW_LNS_set_epilogue_begin:
+                break;
+
+            default: {
+
+                // DW_LNS_set_column, DW_LNS_set_isa and unknown opcodes: skip their ULEB128 operands
+                for (int i = 0; i < standard_opcode_lengths[opcode - 1]; i++) {
+                    decodeULEB128(p, &n, unit_end);
+                    p += n;
+                }
+
+                break;
+            }
+            }
+        }
+    }
+
+    return true;
+}
+
+const char *DWARF_line::read_string(const unsigned char *&ptr, const unsigned char *end, DW_FORM form, bool is_64bit) {
+
+    switch (form) {
+
+    case DW_FORM_string: {
+
+        const char *str = (const char *)ptr;
+        ptr += strnlen(str, end - ptr) + 1;
+
+        return str;
+    }
+
+    case DW_FORM_line_strp:
+    case DW_FORM_strp: {
+
+        uint64_t offset;
+
+        if (is_64bit) {
+            offset = *(uint64_t *)ptr;
+            ptr += sizeof(uint64_t);
+        } else {
+            offset = *(uint32_t *)ptr;
+            ptr += sizeof(uint32_t);
+        }
+
+        const unsigned char *section = form == DW_FORM_line_strp ? debug_line_str : debug_str;
+        size_t section_size = form == DW_FORM_line_strp ? debug_line_str_size : debug_str_size;
+
+        if (section == nullptr || offset >= section_size) {
+            return nullptr;
+        }
+
+        return (const char *)(section + offset);
+    }
+
+    default: {
+        skip_form(ptr, end, form, is_64bit);
+        return nullptr;
+    }
+    }
+}
+
+bool DWARF_line::skip_form(const unsigned char *&ptr, const unsigned char *end, DW_FORM form, bool is_64bit, uint8_t address_size) {
+
+    unsigned n;
+
+    switch (form) {
+
+    case DW_FORM_flag_present:
+    case DW_FORM_implicit_const:
+        break;
+
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+        ptr += 1;
+        break;
+
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+        ptr += 2;
+        break;
+
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+        ptr += 3;
+        break;
+
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+        ptr += 4;
+        break;
+
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+        ptr += 8;
+        break;
+
+    case DW_FORM_data16:
+        ptr += 16;
+        break;
+
+    case DW_FORM_addr:
+        ptr += address_size;
+        break;
+
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+    case DW_FORM_strx:
+    case DW_FORM_addrx:
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+        decodeULEB128(ptr, &n, end);
+        ptr += n;
+        break;
+
+    case DW_FORM_sdata:
+        decodeSLEB128(ptr, &n, end);
+        ptr += n;
+        break;
+
+    case DW_FORM_block:
+    case DW_FORM_exprloc: {
+        uint64_t length = decodeULEB128(ptr, &n, end);
+        ptr += n + length;
+        break;
+    }
+
+    case DW_FORM_block1: {
+        uint8_t length = *ptr;
+        ptr += 1 + length;
+        break;
+    }
+
+    case DW_FORM_block2: {
+        uint16_t length = *(uint16_t *)ptr;
+        ptr += 2 + length;
+        break;
+    }
+
+    case DW_FORM_block4: {
+        uint32_t length = *(uint32_t *)ptr;
+        ptr += 4 + length;
+        break;
+    }
+
+    case DW_FORM_string:
+        ptr += strnlen((const char *)ptr, end - ptr) + 1;
+        break;
+
+    case DW_FORM_line_strp:
+    case DW_FORM_strp:
+    case DW_FORM_strp_sup:
+    case DW_FORM_sec_offset:
+    case DW_FORM_ref_addr:
+        ptr += is_64bit ? sizeof(uint64_t) : sizeof(uint32_t);
+        break;
+
+    case DW_FORM_indirect: {
+        DW_FORM actual_form = static_cast<DW_FORM>(decodeULEB128(ptr, &n, end));
+        ptr += n;
+        return skip_form(ptr, end, actual_form, is_64bit, address_size);
+    }
+
+    default:
+        return false;
+    }
+
+    return ptr <= end;
+}
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <stdint.h>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "dwarf.h"
+#include "elf.h"
+
+// Standard opcodes (DWARF 5, Section 6.2.5.2)
+enum DW_LNS : uint8_t {
+    DW_LNS_copy = 0x01,
+    DW_LNS_advance_pc = 0x02,
+    DW_LNS_advance_line = 0x03,
+    DW_LNS_set_file = 0x04,
+    DW_LNS_set_column = 0x05,
+    DW_LNS_negate_stmt = 0x06,
+    DW_LNS_set_basic_block = 0x07,
+    DW_LNS_const_add_pc = 0x08,
+    DW_LNS_fixed_advance_pc = 0x09,
+    DW_LNS_set_prologue_end = 0x0a,
+    DW_LNS_set_epilogue_begin = 0x0b,
+    DW_LNS_set_isa = 0x0c
+};
+
+// Extended opcodes (DWARF 5, Section 6.2.5.3)
+enum DW_LNE : uint8_t {
+    DW_LNE_end_sequence = 0x01,
+    DW_LNE_set_address = 0x02,
+    DW_LNE_define_file = 0x03,
+    DW_LNE_set_discriminator = 0x04,
+    DW_LNE_lo_user = 0x80,
+    DW_LNE_hi_user = 0xff
+};
+
+// Line number header entry formats (DWARF 5, Section 6.2.4.1)
+enum DW_LNCT : uint16_t {
+    DW_LNCT_path = 0x1,
+    DW_LNCT_directory_index = 0x2,
+    DW_LNCT_timestamp = 0x3,
+    DW_LNCT_size = 0x4,
+    DW_LNCT_MD5 = 0x5,
+    DW_LNCT_lo_user = 0x2000,
+    DW_LNCT_hi_user = 0x3fff
+};
+
+struct DWARF_line_row {
+    Elf64_Addr address;
+    uint32_t file; // Index in DWARF_line::files
+    uint32_t line;
+    bool end_sequence;
+};
+
+// .debug_line program interpreter. All the line number programs are run once and the resulting rows are kept sorted by address,
+// so each lookup is a binary search.
+class DWARF_line {
+
+  public:
+    DWARF_line() {}
+
+    bool load(const ELF &elf);
+
+    // <file, line> for the given address
+    std::optional<std::tuple<std::filesystem::path, size_t>> lookup(Elf64_Addr addr) const;
+
+    inline size_t num_rows() const { return rows.size(); }
+
+    // Advances ptr past an attribute value of the given form
+    static bool skip_form(const unsigned char *&ptr, const unsigned char *end, DW_FORM form, bool is_64bit,
+                          uint8_t address_size = sizeof(Elf64_Addr));
+
+  private:
+    const unsigned char *debug_line = nullptr;
+    size_t debug_line_size = 0;
+
+    const unsigned char *debug_str = nullptr;
+    size_t debug_str_size = 0;
+
+    const unsigned char *debug_line_str = nullptr;
+    size_t debug_line_str_size = 0;
+
+    const unsigned char *debug_info = nullptr;
+    size_t debug_info_size = 0;
+
+    const unsigned char *debug_abbrev = nullptr;
+    size_t debug_abbrev_size = 0;
+
+    // .debug_line offset, DW_AT_comp_dir of the owning compilation unit
+    std::unordered_map<uint64_t, std::filesystem::path> comp_dirs;
+
+    std::vector<std::filesystem::path> files;
+
+    std::vector<DWARF_line_row> rows;
+
+    void load_comp_dirs();
+
+    bool read_unit(const unsigned char *&ptr, const unsigned char *end);
+
+    const char *read_string(const unsigned char *&ptr, const unsigned char *end, DW_FORM form, bool is_64bit);
+};
@@ -0,0 +1,744 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#include "scope.h"
+
+bool DWARF_scopes::load(const ELF &elf) {
+
+    debug_info = elf.get_section(".debug_info", debug_info_size);
+    debug_abbrev = elf.get_section(".debug_abbrev", debug_abbrev_size);
+
+    if (debug_info == nullptr || debug_abbrev == nullptr) {
+        return false;
+    }
+
+    debug_str = elf.get_section(".debug_str", debug_str_size);
+    debug_line_str = elf.get_section(".debug_line_str", debug_line_str_size);
+    debug_str_offsets = elf.get_section(".debug_str_offsets", debug_str_offsets_size);
+    debug_addr = elf.get_section(".debug_addr", debug_addr_size);
+    debug_ranges = elf.get_section(".debug_ranges", debug_ranges_size);
+    debug_rnglists = elf.get_section(".debug_rnglists", debug_rnglists_size);
+
+    const unsigned char *ptr = debug_info;
+    const unsigned char *end = debug_info + debug_info_size;
+
+    while (ptr < end) { // For each Compilation Unit
+
+        if (!read_unit(ptr, end)) {
+            break;
+        }
+    }
+
+    // Only needed while decoding
+    abbrev_tables.clear();
+
+    std::sort(scopes.begin(), scopes.end(), [](const DWARF_scope &a, const DWARF_scope &b) {
+        return a.low < b.low || (a.low == b.low && a.depth < b.depth);
+    });
+
+    max_high.resize(scopes.size());
+
+    for (size_t i = 0; i < scopes.size(); i++) {
+        max_high[i] = i == 0 ? scopes[i].high : std::max(max_high[i - 1], scopes[i].high);
+    }
+
+    return !scopes.empty();
+}
+
+std::optional<std::string> DWARF_scopes::lookup(Elf64_Addr addr) const {
+
+    // Walk back from the last scope starting at or before addr, until no earlier scope can reach it
+    size_t i = std::upper_bound(scopes.begin(), scopes.end(), addr, [](Elf64_Addr a, const DWARF_scope &scope) { return a < scope.low; }) -
+               scopes.begin();
+
+    const DWARF_scope *innermost = nullptr;
+
+    while (i > 0 && max_high[i - 1] > addr) {
+
+        i--;
+
+        if (addr < scopes[i].high && (innermost == nullptr || scopes[i].depth > innermost->depth)) {
+            innermost = &scopes[i];
+        }
+    }
+
+    if (innermost == nullptr) {
+        return std::nullopt;
+    }
+
+    // Inlined and out-of-line instances point to their abstract instance, which may point to the declaration
+    const char *name = nullptr;
+    uint64_t die = innermost->die;
+
+    for (int hops = 0; hops < 8; hops++) {
+
+        auto entry = names.find(die);
+
+        if (entry == names.end()) {
+            break;
+        }
+
+        if (entry->second.linkage_name != nullptr) {
+            return std::string(entry->second.linkage_name);
+        }
+
+        if (name == nullptr) {
+            name = entry->second.name;
+        }
+
+        die = entry->second.origin;
+    }
+
+    if (name == nullptr) {
+        return std::nullopt;
+    }
+
+    return std::string(name);
+}
+
+const std::unordered_map<uint64_t, DWARF_scopes::abbrev_decl> *DWARF_scopes::read_abbrev_table(uint64_t offset) {
+
+    auto cached = abbrev_tables.find(offset);
+
+    if (cached != abbrev_tables.end()) {
+        return &cached->second;
+    }
+
+    if (offset >= debug_abbrev_size) {
+        return nullptr;
+    }
+
+    auto &table = abbrev_tables[offset];
+
+    const unsigned char *p = debug_abbrev + offset;
+    const unsigned char *end = debug_abbrev + debug_abbrev_size;
+
+    unsigned n;
+
+    while (p < end) {
+
+        uint64_t code = decodeULEB128(p, &n, end);
+        p += n;
+
+        if (code == 0) { // End of table
+            break;
+        }
+
+        abbrev_decl decl;
+
+        decl.tag = decodeULEB128(p, &n, end);
+        p += n;
+
+        if (p >= end) {
+            break;
+        }
+
+        decl.has_children = *p++ == DW_CHILDREN_yes;
+
+        while (p < end) {
+
+            abbrev_spec spec;
+
+            spec.at = decodeULEB128(p, &n, end);
+            p += n;
+            spec.form = static_cast<DW_FORM>(decodeULEB128(p, &n, end));
+            p += n;
+            spec.implicit_const = 0;
+
+            if (spec.form == DW_FORM_implicit_const) {
+                spec.implicit_const = decodeSLEB128(p, &n, end);
+                p += n;
+            }
+
+            if (spec.at == 0 && spec.form == 0) {
+                break;
+            }
+
+            decl.specs.push_back(spec);
+        }
+
+        table.emplace(code, std::move(decl));
+    }
+
+    return &table;
+}
+
+bool DWARF_scopes::read_unit(const unsigned char *&ptr, const unsigned char *end) {
+
+    if (end - ptr < 4) {
+        return false;
+    }
+
+    DWARF_scope_unit unit;
+
+    unit.offset = ptr - debug_info;
+    unit.is_64bit = false;
+
+    uint64_t unit_length = *(uint32_t *)ptr;
+    ptr += sizeof(uint32_t);
+
+    if (unit_length == 0xffffffff) {
+
+        if (end - ptr < 8) {
+            return false;
+        }
+
+        unit_length = *(uint64_t *)ptr;
+        ptr += sizeof(uint64_t);
+        unit.is_64bit = true;
+    }
+
+    if (unit_length > (uint64_t)(end - ptr)) {
+        return false;
+    }
+
+    const unsigned char *unit_end = ptr + unit_length;
+
+    // From here on, errors only discard the current unit
+    const unsigned char *p = ptr;
+    ptr = unit_end;
+
+    if (unit_end - p < (unit.is_64bit ? 12 : 8)) {
+        return true;
+    }
+
+    unit.version = *(uint16_t *)p;
+    p += sizeof(uint16_t);
+
+    if (unit.version < 2 || unit.version > 5) {
+        return true;
+    }
+
+    uint8_t unit_type = DW_UT_compile;
+
+    if (unit.version >= 5) {
+        unit_type = *p++;
+        unit.address_size = *p++;
+    }
+
+    uint64_t abbrev_offset;
+
+    if (unit.is_64bit) {
+        abbrev_offset = *(uint64_t *)p;
+        p += sizeof(uint64_t);
+    } else {
+        abbrev_offset = *(uint32_t *)p;
+        p += sizeof(uint32_t);
+    }
+
+    if (unit.version < 5) {
+        unit.address_size = *p++;
+    }
+
+    // Type units have no code, skeleton units keep their functions in the .dwo file
+    if (unit_type != DW_UT_compile && unit_type != DW_UT_partial) {
+        return true;
+    }
+
+    if (unit.address_size != sizeof(uint32_t) && unit.address_size != sizeof(uint64_t)) {
+        return true;
+    }
+
+    auto abbrevs = read_abbrev_table(abbrev_offset);
+
+    if (abbrevs == nullptr) {
+        return true;
+    }
+
+    unsigned n;
+
+    uint32_t depth = 0;
+    bool root = true;
+
+    while (p < unit_end) { // For each Debugging Information Entry
+
+        uint64_t die = p - debug_info;
+
+        uint64_t code = decodeULEB128(p, &n, unit_end);
+        p += n;
+
+        if (n == 0) {
+            return true;
+        }
+
+        if (code == 0) { // End of the siblings list
+            if (depth > 0) {
+                depth--;
+            }
+
+            continue;
+        }
+
+        auto decl = abbrevs->find(code);
+
+        if (decl == abbrevs->end()) {
+            return true;
+        }
+
+        bool is_function = decl->second.tag == DW_TAG_subprogram || decl->second.tag == DW_TAG_inlined_subroutine;
+
+        if (!root && !is_function) {
+
+            for (const abbrev_spec &spec : decl->second.specs) {
+
+                if (!DWARF_line::skip_form(p, unit_end, spec.form, unit.is_64bit, unit.address_size)) {
+                    return true;
+                }
+            }
+
+        } else {
+
+            // Forms and values, resolved once the whole entry is read since the unit bases may come after them
+            std::optional<std::pair<DW_FORM, uint64_t>> low_pc, high_pc, ranges, name, linkage_name;
+
+            uint64_t origin = UINT64_MAX;
+
+            for (const abbrev_spec &spec : decl->second.specs) {
+
+                uint64_t value = spec.implicit_const;
+
+                if (spec.form != DW_FORM_implicit_const && !read_value(p, unit_end, spec.form, unit, value)) {
+
+                    if (!DWARF_line::skip_form(p, unit_end, spec.form, unit.is_64bit, unit.address_size)) {
+                        return true;
+                    }
+
+                    continue;
+                }
+
+                switch (spec.at) {
+
+                case DW_AT_low_pc:
+                    low_pc = {spec.form, value};
+                    break;
+
+                case DW_AT_high_pc:
+                    high_pc = {spec.form, value};
+                    break;
+
+                case DW_AT_ranges:
+                    ranges = {spec.form, value};
+                    break;
+
+                case DW_AT_name:
+                    name = {spec.form, value};
+                    break;
+
+                case DW_AT_linkage_name:
+                case 0x2007: // DW_AT_MIPS_linkage_name, emitted by GCC before DWARF 4
+                    linkage_name = {spec.form, value};
+                    break;
+
+                case DW_AT_abstract_origin:
+                case DW_AT_specification: {
+
+                    if (spec.form == DW_FORM_ref_addr) {
+                        origin = value;
+                    } else if (spec.form >= DW_FORM_ref1 && spec.form <= DW_FORM_ref_udata) {
+                        origin = unit.offset + value;
+                    }
+
+                    break;
+                }
+
+                case DW_AT_addr_base:
+                    unit.addr_base = value;
+                    break;
+
+                case DW_AT_str_offsets_base:
+                    unit.str_offsets_base = value;
+                    break;
+
+                case DW_AT_rnglists_base:
+                    unit.rnglists_base = value;
+                    break;
+
+                default:
+                    break;
+                }
+            }
+
+            if (root) {
+
+                // Base address of the unit range lists
+                if (low_pc.has_value()) {
+                    unit.base_address = get_address(low_pc->first, low_pc->second, unit).value_or(0);
+                }
+
+                root = false;
+
+            } else {
+
+                if (name.has_value() || linkage_name.has_value() || origin != UINT64_MAX) {
+
+                    DWARF_scope_name &entry = names[die];
+
+                    entry.name = name.has_value() ? get_string(name->first, name->second, unit) : nullptr;
+                    entry.linkage_name = linkage_name.has_value() ? get_string(linkage_name->first, linkage_name->second, unit) : nullptr;
+                    entry.origin = origin;
+                }
+
+                if (ranges.has_value()) {
+
+                    add_ranges(ranges->first, ranges->second, unit, depth, die);
+
+                } else if (low_pc.has_value() && high_pc.has_value()) {
+
+                    auto low = get_address(low_pc->first, low_pc->second, unit);
+
+                    if (low.has_value()) {
+
+                        // high_pc is an address, or (since DWARF 4) the size of the range
+                        auto high = get_address(high_pc->first, high_pc->second, unit);
+
+                        add_scope(low.value(), high.has_value() ? high.value() : low.value() + high_pc->second, depth, die);
+                    }
+                }
+            }
+        }
+
+        if (decl->second.has_children) {
+            depth++;
+        }
+    }
+
+    return true;
+}
+
+// Decodes the constant, address, reference, string and index forms. Returns false, without consuming anything, for the
+// forms that carry blocks or unknown data
+bool DWARF_scopes::read_value(const unsigned char *&ptr, const unsigned char *end, DW_FORM form, const DWARF_scope_unit &unit,
+                              uint64_t &value) {
+
+    unsigned n;
+
+    auto read_fixed = [&](size_t size) {
+        if ((size_t)(end - ptr) < size) {
+            return false;
+        }
+
+        value = 0;
+        memcpy(&value, ptr, size);
+        ptr += size;
+
+        return true;
+    };
+
+    switch (form) {
+
+    case DW_FORM_flag_present:
+        value = 1;
+        return true;
+
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+        return read_fixed(1);
+
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+        return read_fixed(2);
+
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+        return read_fixed(3);
+
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+        return read_fixed(4);
+
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+        return read_fixed(8);
+
+    case DW_FORM_addr:
+        return read_fixed(unit.address_size);
+
+    case DW_FORM_strp:
+    case DW_FORM_line_strp:
+    case DW_FORM_sec_offset:
+    case DW_FORM_ref_addr:
+        return read_fixed(unit.is_64bit ? sizeof(uint64_t) : sizeof(uint32_t));
+
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+    case DW_FORM_strx:
+    case DW_FORM_addrx:
+    case DW_FORM_rnglistx: {
+
+        value = decodeULEB128(ptr, &n, end);
+
+        if (n == 0) {
+            return false;
+        }
+
+        ptr += n;
+        return true;
+    }
+
+    case DW_FORM_sdata: {
+
+        value = decodeSLEB128(ptr, &n, end);
+
+        if (n == 0) {
+            return false;
+        }
+
+        ptr += n;
+        return true;
+    }
+
+    case DW_FORM_string: {
+
+        // Kept as an offset in .debug_info
+        value = ptr - debug_info;
+        ptr += strnlen((const char *)ptr, end - ptr) + 1;
+
+        return ptr <= end;
+    }
+
+    default:
+        return false;
+    }
+}
+
+const char *DWARF_scopes::get_string(DW_FORM form, uint64_t value, const DWARF_scope_unit &unit) const {
+
+    switch (form) {
+
+    case DW_FORM_string:
+        return value < debug_info_size ? (const char *)(debug_info + value) : nullptr;
+
+    case DW_FORM_strp:
+        return debug_str != nullptr && value < debug_str_size ? (const char *)(debug_str + value) : nullptr;
+
+    case DW_FORM_line_strp:
+        return debug_line_str != nullptr && value < debug_line_str_size ? (const char *)(debug_line_str + value) : nullptr;
+
+    case DW_FORM_strx:
+    case DW_FORM_strx1:
+    case DW_FORM_strx2:
+    case DW_FORM_strx3:
+    case DW_FORM_strx4: {
+
+        size_t offset_size = unit.is_64bit ? sizeof(uint64_t) : sizeof(uint32_t);
+        uint64_t entry = unit.str_offsets_base + value * offset_size;
+
+        if (debug_str_offsets == nullptr || entry + offset_size > debug_str_offsets_size) {
+            return nullptr;
+        }
+
+        uint64_t offset = 0;
+        memcpy(&offset, debug_str_offsets + entry, offset_size);
+
+        return debug_str != nullptr && offset < debug_str_size ? (const char *)(debug_str + offset) : nullptr;
+    }
+
+    default:
+        return nullptr;
+    }
+}
+
+std::optional<Elf64_Addr> DWARF_scopes::get_address(DW_FORM form, uint64_t value, const DWARF_scope_unit &unit) const {
+
+    switch (form) {
+
+    case DW_FORM_addr:
+        return value;
+
+    case DW_FORM_addrx:
+    case DW_FORM_addrx1:
+    case DW_FORM_addrx2:
+    case DW_FORM_addrx3:
+    case DW_FORM_addrx4: {
+
+        uint64_t entry = unit.addr_base + value * unit.address_size;
+
+        if (debug_addr == nullptr || entry + unit.address_size > debug_addr_size) {
+            return std::nullopt;
+        }
+
+        Elf64_Addr address = 0;
+        memcpy(&address, debug_addr + entry, unit.address_size);
+
+        return address;
+    }
+
+    default:
+        return std::nullopt;
+    }
+}
+
+// Page 52-54 Version 5 DWARF (range lists), .debug_ranges before DWARF 5
+void DWARF_scopes::add_ranges(DW_FORM form, uint64_t value, const DWARF_scope_unit &unit, uint32_t depth, uint64_t die) {
+
+    const unsigned char *section = unit.version >= 5 ? debug_rnglists : debug_ranges;
+    size_t section_size = unit.version >= 5 ? debug_rnglists_size : debug_ranges_size;
+
+    if (section == nullptr) {
+        return;
+    }
+
+    uint64_t offset = value;
+
+    if (form == DW_FORM_rnglistx) {
+
+        // Index in the offsets table that follows the range lists header
+        size_t offset_size = unit.is_64bit ? sizeof(uint64_t) : sizeof(uint32_t);
+        uint64_t entry = unit.rnglists_base + value * offset_size;
+
+        if (entry + offset_size > section_size) {
+            return;
+        }
+
+        offset = 0;
+        memcpy(&offset, section + entry, offset_size);
+        offset += unit.rnglists_base;
+    }
+
+    if (offset >= section_size) {
+        return;
+    }
+
+    const unsigned char *p = section + offset;
+    const unsigned char *end = section + section_size;
+
+    Elf64_Addr base = unit.base_address;
+
+    auto read_address = [&](Elf64_Addr &address) {
+        if ((size_t)(end - p) < unit.address_size) {
+            return false;
+        }
+
+        address = 0;
+        memcpy(&address, p, unit.address_size);
+        p += unit.address_size;
+
+        return true;
+    };
+
+    if (unit.version < 5) {
+
+        // Pairs of offsets from the base address, a start of -1 selects a new base address
+        Elf64_Addr base_selection = unit.address_size == sizeof(uint32_t) ? UINT32_MAX : UINT64_MAX;
+
+        Elf64_Addr start, stop;
+
+        while (read_address(start) && read_address(stop)) {
+
+            if (start == 0 && stop == 0) { // End of list
+                break;
+            }
+
+            if (start == base_selection) {
+                base = stop;
+                continue;
+            }
+
+            add_scope(base + start, base + stop, depth, die);
+        }
+
+        return;
+    }
+
+    unsigned n;
+
+    auto read_uleb = [&]() {
+        uint64_t result = decodeULEB128(p, &n, end);
+        p += n;
+        return result;
+    };
+
+    while (p < end) {
+
+        uint8_t kind = *p++;
+
+        switch (kind) {
+
+        case DW_RLE_end_of_list:
+            return;
+
+        case DW_RLE_base_addressx: {
+            base = get_address(DW_FORM_addrx, read_uleb(), unit).value_or(0);
+            break;
+        }
+
+        case DW_RLE_startx_endx: {
+            auto start = get_address(DW_FORM_addrx, read_uleb(), unit);
+            auto stop = get_address(DW_FORM_addrx, read_uleb(), unit);
+
+            if (start.has_value() && stop.has_value()) {
+                add_scope(start.value(), stop.value(), depth, die);
+            }
+
+            break;
+        }
+
+        case DW_RLE_startx_length: {
+            auto start = get_address(DW_FORM_addrx, read_uleb(), unit);
+            uint64_t length = read_uleb();
+
+            if (start.has_value()) {
+                add_scope(start.value(), start.value() + length, depth, die);
+            }
+
+            break;
+        }
+
+        case DW_RLE_offset_pair: {
+            uint64_t start = read_uleb();
+            uint64_t stop = read_uleb();
+
+            add_scope(base + start, base + stop, depth, die);
+            break;
+        }
+
+        case DW_RLE_base_address: {
+            if (!read_address(base)) {
+                return;
+            }
+
+            break;
+        }
+
+        case DW_RLE_start_end: {
+            Elf64_Addr start, stop;
+
+            if (!read_address(start) || !read_address(stop)) {
+                return;
+            }
+
+            add_scope(start, stop, depth, die);
+            break;
+        }
+
+        case DW_RLE_start_length: {
+            Elf64_Addr start;
+
+            if (!read_address(start)) {
+                return;
+            }
+
+            add_scope(start, start + read_uleb(), depth, die);
+            break;
+        }
+
+        default:
+            return;
+        }
+    }
+}
+
+void DWARF_scopes::add_scope(Elf64_Addr low, Elf64_Addr high, uint32_t depth, uint64_t die) {
+
+    // Functions discarded by the linker are left at address 0 (or at a tombstone value by lld)
+    if (low == 0 || high <= low) {
+        return;
+    }
+
+    scopes.push_back({low, high, depth, die});
+}
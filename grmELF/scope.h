@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#pragma once
+
+#include <optional>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dwarf.h"
+#include "elf.h"
+#include "line.h"
+
+// Range list entry kinds (DWARF 5, Section 7.25)
+enum DW_RLE : uint8_t {
+    DW_RLE_end_of_list = 0x00,
+    DW_RLE_base_addressx = 0x01,
+    DW_RLE_startx_endx = 0x02,
+    DW_RLE_startx_length = 0x03,
+    DW_RLE_offset_pair = 0x04,
+    DW_RLE_base_address = 0x05,
+    DW_RLE_start_end = 0x06,
+    DW_RLE_start_length = 0x07
+};
+
+// Address range of a DW_TAG_subprogram or DW_TAG_inlined_subroutine entry
+struct DWARF_scope {
+    Elf64_Addr low;
+    Elf64_Addr high;
+    uint32_t depth; // Nesting level of the entry in its compilation unit
+    uint64_t die;   // .debug_info offset of the entry
+};
+
+struct DWARF_scope_name {
+    const char *name = nullptr;
+    const char *linkage_name = nullptr;
+    uint64_t origin = UINT64_MAX; // DW_AT_abstract_origin or DW_AT_specification
+};
+
+// Per compilation unit state needed to decode the attribute forms
+struct DWARF_scope_unit {
+    uint64_t offset; // .debug_info offset of the unit header
+    uint16_t version;
+    bool is_64bit;
+    uint8_t address_size;
+    Elf64_Addr base_address = 0;
+    uint64_t addr_base = 0;
+    uint64_t str_offsets_base = 0;
+    uint64_t rnglists_base = 0;
+};
+
+// Function names from .debug_info. Every function and inlined call site is kept as an address range; the deepest range
+// containing an address names the inlined function the instruction comes from, as addr2line --functions does.
+class DWARF_scopes {
+
+  public:
+    DWARF_scopes() {}
+
+    bool load(const ELF &elf);
+
+    // Linkage name (or plain name if there is none) of the innermost function containing the address
+    std::optional<std::string> lookup(Elf64_Addr addr) const;
+
+    inline size_t num_scopes() const { return scopes.size(); }
+
+  private:
+    struct abbrev_spec {
+        uint64_t at;
+        DW_FORM form;
+        int64_t implicit_const;
+    };
+
+    struct abbrev_decl {
+        uint64_t tag;
+        bool has_children;
+        std::vector<abbrev_spec> specs;
+    };
+
+    const unsigned char *debug_info = nullptr;
+    size_t debug_info_size = 0;
+
+    const unsigned char *debug_abbrev = nullptr;
+    size_t debug_abbrev_size = 0;
+
+    const unsigned char *debug_str = nullptr;
+    size_t debug_str_size = 0;
+
+    const unsigned char *debug_line_str = nullptr;
+    size_t debug_line_str_size = 0;
+
+    const unsigned char *debug_str_offsets = nullptr;
+    size_t debug_str_offsets_size = 0;
+
+    const unsigned char *debug_addr = nullptr;
+    size_t debug_addr_size = 0;
+
+    const unsigned char *debug_ranges = nullptr;
+    size_t debug_ranges_size = 0;
+
+    const unsigned char *debug_rnglists = nullptr;
+    size_t debug_rnglists_size = 0;
+
+    // Sorted by low address
+    std::vector<DWARF_scope> scopes;
+
+    // Highest end address of scopes[0..i], bounds the backward scan of lookup()
+    std::vector<Elf64_Addr> max_high;
+
+    // .debug_info offset, names of every function entry (including declarations and abstract instances)
+    std::unordered_map<uint64_t, DWARF_scope_name> names;
+
+    // .debug_abbrev offset, <abbrev code, declaration>
+    std::unordered_map<uint64_t, std::unordered_map<uint64_t, abbrev_decl>> abbrev_tables;
+
+    const std::unordered_map<uint64_t, abbrev_decl> *read_abbrev_table(uint64_t offset);
+
+    bool read_unit(const unsigned char *&ptr, const unsigned char *end);
+
+    bool read_value(const unsigned char *&ptr, const unsigned char *end, DW_FORM form, const DWARF_scope_unit &unit, uint64_t &value);
+
+    const char *get_string(DW_FORM form, uint64_t value, const DWARF_scope_unit &unit) const;
+
+    std::optional<Elf64_Addr> get_address(DW_FORM form, uint64_t value, const DWARF_scope_unit &unit) const;
+
+    void add_ranges(DW_FORM form, uint64_t value, const DWARF_scope_unit &unit, uint32_t depth, uint64_t die);
+
+    void add_scope(Elf64_Addr low, Elf64_Addr high, uint32_t depth, uint64_t die);
+};
@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#include "symbolizer.h"
+
+bool Symbolizer::open(std::filesystem::path object_path) {
+
+    if (!elf.open(object_path)) {
+        return false;
+    }
+
+    if (!line_table.load(elf)) {
+        return false;
+    }
+
+    // Without it, function names come from the symbol table
+    scopes.load(elf);
+
+    return true;
+}
+
+std::optional<SYMBOL_INFO> Symbolizer::symbolize(Elf64_Addr addr) const {
+
+    SYMBOL_INFO info;
+
+    // Inlined code is named after the inlined function, like its file and line. The symbol table is only used without DWARF.
+    auto scope = scopes.lookup(addr);
+
+    if (scope.has_value()) {
+
+        info.function = demangle(scope.value());
+
+    } else {
+
+        auto function = elf.find_function(addr);
+
+        if (!function.has_value()) {
+            return std::nullopt;
+        }
+
+        info.function = demangle(std::get<0>(function.value()));
+    }
+
+    auto location = line_table.lookup(addr);
+
+    if (location.has_value()) {
+        info.file = std::get<0>(location.value());
+        info.line = std::get<1>(location.value());
+    }
+
+    return info;
+}
+
+// Same output as addr2line --demangle
+std::string demangle(const std::string &name) {
+
+    // Plain C names can be valid mangled types ("f" is "float")
+    if (!name.starts_with("_Z")) {
+        return name;
+    }
+
+    int status = 0;
+
+    char *demangled = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+
+    if (status != 0 || demangled == nullptr) {
+        return name;
+    }
+
+    std::string result(demangled);
+
+    free(demangled);
+
+    return result;
+}
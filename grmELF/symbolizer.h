@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#pragma once
+
+#include <cxxabi.h>
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "elf.h"
+#include "line.h"
+#include "scope.h"
+
+struct SYMBOL_INFO {
+    std::string function = "";
+    std::filesystem::path file = "";
+    size_t line = 0;
+};
+
+// In-process address -> function/file/line resolution for a single ELF object
+class Symbolizer {
+
+  public:
+    Symbolizer() {}
+
+    // Returns false if the object has no symbol table or no line number information
+    bool open(std::filesystem::path object_path);
+
+    std::optional<SYMBOL_INFO> symbolize(Elf64_Addr addr) const;
+
+  private:
+    ELF elf;
+
+    DWARF_line line_table;
+
+    DWARF_scopes scopes;
+};
+
+std::string demangle(const std::string &name);
@@ -0,0 +1,125 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+// Compare the line table of readelf --debug-dump=decodedline with the in-process symbolizer output
+
+#include <filesystem>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../symbolizer.h"
+
+#include "grmUtils/process.h"
+
+bool test3(std::filesystem::path elf_path) {
+
+    if (!is_executable_file(elf_path)) {
+        std::cout << "Error: " << elf_path << " is not an executable file" << std::endl;
+        exit(1);
+    }
+
+    std::cout << "Testing " << elf_path << std::endl;
+
+    Symbolizer symbolizer;
+
+    if (!symbolizer.open(elf_path)) {
+        std::cout << "Error: no debug info in " << elf_path << std::endl;
+        return false;
+    }
+
+    // Rows look like "stl_tree.h    175    0x250c    x". "-" as the line ends a sequence: its address belongs to the next one, if any
+    std::istringstream output(run("readelf -W --debug-dump=decodedline " + elf_path.string()));
+
+    // Address, file name and line of the last row at that address
+    std::map<uint64_t, std::pair<std::string, std::string>> rows;
+
+    // Rows of the current sequence
+    std::vector<std::tuple<uint64_t, std::string, std::string>> sequence;
+
+    std::string line;
+
+    while (std::getline(output, line)) {
+
+        std::istringstream row(line);
+
+        std::string file;
+        std::string line_str;
+        std::string address_str;
+
+        // Address 0 is printed without its 0x
+        if (!(row >> file >> line_str >> address_str) || (!address_str.starts_with("0x") && address_str != "0")) {
+            continue;
+        }
+
+        if (line_str != "-" && !is_number(line_str)) {
+            continue;
+        }
+
+        uint64_t address = std::stoull(address_str, nullptr, 16);
+
+        if (line_str != "-") {
+            sequence.push_back({address, file, line_str});
+            continue;
+        }
+
+        // The linker moves the sequences of discarded code to 0
+        if (!sequence.empty() && std::get<0>(sequence.front()) == 0) {
+            sequence.clear();
+            continue;
+        }
+
+        // Rows at the end address cover no instruction
+        for (auto &[row_address, row_file, row_line] : sequence) {
+            if (row_address < address) {
+                rows[row_address] = {row_file, row_line};
+            }
+        }
+
+        sequence.clear();
+    }
+
+    size_t total = 0;
+    size_t mismatches = 0;
+    size_t padding = 0;
+
+    for (auto &[address, expected] : rows) {
+
+        auto info = symbolizer.symbolize(address);
+
+        // Alignment between functions, which the line table gives to the previous one. The symbolizer names no function there
+        if (!info.has_value()) {
+            padding++;
+            continue;
+        }
+
+        std::string output = info->file.filename().string() + ":" + std::to_string(info->line);
+
+        if (output != expected.first + ":" + expected.second) {
+            std::cout << std::hex << address << std::dec << ": " << output << " != " << expected.first << ":" << expected.second << std::endl;
+            mismatches++;
+        }
+
+        total++;
+    }
+
+    std::cout << mismatches << " / " << total << " mismatches, " << padding << " rows outside any function" << std::endl;
+
+    return total > 0 && mismatches == 0;
+}
+
+int main(int argc, char *argv[]) {
+
+    std::filesystem::path root_path = "/home/...";
+
+    for (auto d : std::filesystem::directory_iterator(root_path / "tests/elf_samples")) {
+
+        if (d.is_regular_file()) {
+
+            if (test3(d.path()) == false) {
+                std::cout << "Test3 failed for " << d.path() << std::endl;
+                exit(1);
+            }
+        }
+    }
+}
@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+// Compare the CFA column of readelf --debug-dump=frames-interp with the .eh_frame reader
+
+#include <filesystem>
+#include <format>
+#include <sstream>
+#include <string>
+
+#include "../frame.h"
+
+#include "grmUtils/process.h"
+
+static const char *x86_64_registers[] = {"rax", "rdx", "rcx", "rbx", "rsi", "rdi", "rbp", "rsp",
+                                         "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15"};
+
+bool test4(std::filesystem::path elf_path) {
+
+    if (!is_executable_file(elf_path)) {
+        std::cout << "Error: " << elf_path << " is not an executable file" << std::endl;
+        exit(1);
+    }
+
+    std::cout << "Testing " << elf_path << std::endl;
+
+    ELF elf;
+
+    if (!elf.open_sections(elf_path)) {
+        std::cout << "Error: could not open " << elf_path << std::endl;
+        return false;
+    }
+
+    DWARF_frame frame;
+
+    if (!frame.load(elf)) {
+        std::cout << "Error: no .eh_frame in " << elf_path << std::endl;
+        return false;
+    }
+
+    // Rows look like "0000000000001040 rsp+8    u     c-16  c-8"
+    std::istringstream output(run("readelf --debug-dump=frames-interp " + elf_path.string()));
+
+    std::string line;
+
+    // The CIE initial rows have no address
+    bool in_fde = false;
+
+    size_t total = 0;
+    size_t mismatches = 0;
+
+    while (std::getline(output, line)) {
+
+        if (line.find(" CIE ") != std::string::npos || line.find(" FDE ") != std::string::npos) {
+            in_fde = line.find(" FDE ") != std::string::npos;
+            continue;
+        }
+
+        if (!in_fde) {
+            continue;
+        }
+
+        std::istringstream row(line);
+
+        std::string loc_str;
+        std::string expected;
+
+        if (!(row >> loc_str >> expected) || loc_str.size() != 16 || loc_str.find_first_not_of("0123456789abcdef") != std::string::npos) {
+            continue;
+        }
+
+        uint64_t loc = std::stoull(loc_str, nullptr, 16);
+
+        std::string cfa = "";
+
+        auto rules = frame.lookup(loc);
+
+        if (rules.has_value()) {
+
+            if (rules->cfa_expression) {
+                cfa = "exp";
+            } else if (rules->cfa_register < 16) {
+                cfa = std::format("{}{:+}", x86_64_registers[rules->cfa_register], rules->cfa_offset);
+            }
+        }
+
+        if (cfa != expected) {
+            std::cout << std::hex << loc << std::dec << ": " << cfa << " != " << expected << std::endl;
+            mismatches++;
+        }
+
+        total++;
+    }
+
+    std::cout << mismatches << " / " << total << " mismatches" << std::endl;
+
+    return mismatches == 0;
+}
+
+int main(int argc, char *argv[]) {
+
+    std::filesystem::path root_path = "/home/...";
+
+    for (auto d : std::filesystem::directory_iterator(root_path / "tests/elf_samples")) {
+
+        if (d.is_regular_file()) {
+
+            if (test4(d.path()) == false) {
+                std::cout << "Test4 failed for " << d.path() << std::endl;
+                exit(1);
+            }
+        }
+    }
+}
@@ -143,6 +143,8 @@ void print_help(char *argv[], std::string command = "") {
         std::cout << "\n";
         std::cout << "Options:" << std::endl;
         std::cout << "\t -n <num_threads>: number of threads to use. Default: 1" << std::endl;
+        std::cout << "\t -f: replay the inputs through a forkserver. Default: no" << std::endl;
+        std::cout << "\t -i: incremental, keep the counters of the last run and only replay the new queue entries. Default: no" << std::endl;
         std::cout << "\n";
 
     } else if (command == "kill") {
@@ -164,7 +166,16 @@ void print_help(char *argv[], std::string command = "") {
         std::cout << "\t -n <num_threads>: number of threads to use. Default: 1" << std::endl;
         std::cout << "\t -t <ms>: timeout for each execution. Default: Infinite" << std::endl;
         std::cout << "\t -r <num>: repeat the execution <num> times to catch non-deterministic crashes. Default: 5" << std::endl;
-        std::cout << "\t -p <parser>: parser to use. Default: ASAN" << std::endl;
+        std::cout << "\t -p <parser>: parser to use (ASAN, UBSAN, GDB, MALLOC, COV for GDB and MALLOC in a single run, or HANG to profile the "
+                     "hangs/ folders and bucket them by hot loop). Default: ASAN" << std::endl;
+        std::cout << "\t -f: replay the crashes through a forkserver (ASAN, UBSAN and MALLOC parsers). Default: no" << std::endl;
+        std::cout << "\t -x: discard the results of previous runs and triage every crash again. Default: no" << std::endl;
+        std::cout << "\t -s <frames>: sanitizer bugs with the same top <frames> stack frames go to the same bucket (1-" << MAX_STACK_DEPTH
+                  << "). Default: " << MAX_STACK_DEPTH << std::endl;
+        std::cout << "\t -w: keep following the crashes folders while fuzzing: new crashes are triaged at idle priority and the summary is "
+                     "updated, until Ctrl+C. Default: no"
+                  << std::endl;
+        std::cout << "\t -m: minimize the smallest reproducer of each bug, keeping it in the same bucket. Default: no" << std::endl;
         std::cout << "\n";
 
     } else if (command == "copy") {
@@ -810,8 +821,16 @@ int main(int argc, char *argv[]) {
             // bool dumper = false;
             std::string parser = "ASAN";
 
+            bool resume = true;
+
+            size_t top_frames = MAX_STACK_DEPTH;
+
+            bool follow = false;
+
+            bool minimize = false;
+
             int ch;
-            while ((ch = getopt(argc, argv, "t:n:r:p:")) != -1) {
+            while ((ch = getopt(argc, argv, "t:n:r:p:fxs:wm")) != -1) {
 
                 switch (ch) {
 
@@ -835,6 +854,31 @@ int main(int argc, char *argv[]) {
                     break;
                 }
 
+                case 'f': {
+                    ctx.use_forkserver = true;
+                    break;
+                }
+
+                case 'x': {
+                    resume = false;
+                    break;
+                }
+
+                case 's': {
+                    top_frames = std::stoi(optarg);
+                    break;
+                }
+
+                case 'w': {
+                    follow = true;
+                    break;
+                }
+
+                case 'm': {
+                    minimize = true;
+                    break;
+                }
+
                 default:
                     print_help(argv, "triage");
                     exit(EXIT_FAILURE);
@@ -849,9 +893,9 @@ int main(int argc, char *argv[]) {
                 exit(EXIT_FAILURE);
             }
 
-            if (parser != "ASAN" && parser != "UBSAN" && parser != "GDB" && parser != "MALLOC") {
+            if (parser != "ASAN" && parser != "UBSAN" && parser != "GDB" && parser != "MALLOC" && parser != "COV" && parser != "HANG") {
                 std::cerr << "Error: Invalid parser" << std::endl;
-                std::cerr << "Valid options are: ASAN, UBSAN, GDB, MALLOC" << std::endl;
+                std::cerr << "Valid options are: ASAN, UBSAN, GDB, MALLOC, COV, HANG" << std::endl;
                 exit(EXIT_FAILURE);
             }
 
@@ -860,7 +904,12 @@ int main(int argc, char *argv[]) {
                 crashes_folders.push_back(folder);
             }
 
-            triage(parser, crashes_folders, repeat, ctx);
+            if (top_frames < 1 || top_frames > MAX_STACK_DEPTH) {
+                std::cerr << "Error: the number of frames must be between 1 and " << MAX_STACK_DEPTH << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            triage(parser, crashes_folders, repeat, ctx, resume, top_frames, follow, minimize);
 
         } else if (command == "break") {
 
@@ -917,8 +966,10 @@ int main(int argc, char *argv[]) {
 
             // size_t numThreads = 1;
 
+            bool incremental = false;
+
             int ch;
-            while ((ch = getopt(argc, argv, "t:n:")) != -1) {
+            while ((ch = getopt(argc, argv, "t:n:fi")) != -1) {
 
                 switch (ch) {
 
@@ -927,6 +978,16 @@ int main(int argc, char *argv[]) {
                     break;
                 }
 
+                case 'f': {
+                    ctx.use_forkserver = true;
+                    break;
+                }
+
+                case 'i': {
+                    incremental = true;
+                    break;
+                }
+
                 default:
                     print_help(argv, "coverage");
                     exit(EXIT_FAILURE);
@@ -953,7 +1014,7 @@ int main(int argc, char *argv[]) {
                 output_folders.push_back(folder);
             }
 
-            coverage(output_folders, ctx);
+            coverage(output_folders, ctx, true, incremental);
         }
     }
 }
@@ -93,20 +93,11 @@ int plunger(FRglobal &ctx, std::filesystem::path output_folder, std::filesystem:
 
         auto t_start = now_ms();
 
-        // Run coverage
-        coverage(std::vector<std::filesystem::path>{output_folder}, ctx, false);
+        // Run coverage. Only the queue entries added since the last iteration are replayed, and the counters are read straight into
+        // tracefile, no app2.info round trip
+        lcov::Tracefile tracefile((output_folder / "app2.info").string());
 
-        // Parse LCOV
-
-        std::filesystem::path tracefile_path = output_folder / "app2.info";
-        tracefile_path = std::filesystem::canonical(tracefile_path);
-
-        lcov::Tracefile tracefile(tracefile_path);
-
-        if (!tracefile.parse()) {
-            std::cerr << "Error parsing tracefile" << std::endl;
-            return 1;
-        }
+        coverage(std::vector<std::filesystem::path>{output_folder}, ctx, false, true, &tracefile);
 
         auto t_parse_done = now_ms();
         std::cerr << "\n[timing] parse took " << ms(t_start, t_parse_done) << " ms\n";
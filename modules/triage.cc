@@ -1,17 +1,70 @@
 /* SPDX-License-Identifier: AGPL-3.0-only */
 #include "triage.h"
 
-std::string triage_asan_summary(const TRIAGE_RESULT &results, std::vector<std::filesystem::path> crashes_folders, size_t total_crashes) {
+bool SUMMARY_DETAILS::open(std::filesystem::path folder) {
 
-    auto &bugs = results.triage_asan_result->sym_bugs;
-    auto &aborted = results.triage_asan_result->aborted;
-    auto &unknown = results.triage_asan_result->unknown;
+    this->folder = folder;
+
+    std::error_code ec;
+    std::filesystem::remove_all(folder, ec);
+    std::filesystem::create_directories(folder, ec);
+
+    if (ec) {
+        std::cerr << "Error: could not create " << folder << std::endl;
+        return false;
+    }
+
+    chunk_id = 0;
+    entries = 0;
+    chunk = "frfuzz_chunk(0, [";
+
+    return true;
+}
+
+std::string SUMMARY_DETAILS::add(const std::string &description) {
+
+    if (entries > 0) {
+        chunk += ",\n";
+    }
+
+    // Sanitizer output is not always valid UTF-8
+    chunk += JSON(description).dump(-1, ' ', false, JSON::error_handler_t::replace);
+
+    std::string placeholder = "<details data-chunk=\"" + std::to_string(chunk_id) + "\" data-entry=\"" + std::to_string(entries) +
+                              "\"><summary>Report</summary><pre></pre></details>";
+
+    entries++;
+
+    if (entries == SUMMARY_CHUNK_ENTRIES || chunk.size() >= SUMMARY_CHUNK_BYTES) {
+        flush();
+    }
+
+    return placeholder;
+}
+
+void SUMMARY_DETAILS::flush() {
+
+    if (entries == 0) {
+        return;
+    }
+
+    chunk += "]);\n";
+
+    if (!write_file((folder / ("chunk_" + std::to_string(chunk_id) + ".js")).string(), chunk)) {
+        std::cerr << "Error: could not write the details of chunk " << chunk_id << " to " << folder << std::endl;
+    }
+
+    chunk_id++;
+    entries = 0;
+    chunk = "frfuzz_chunk(" + std::to_string(chunk_id) + ", [";
+}
 
-    std::stringstream file;
+static void summary_header(std::ostream &file, const std::vector<std::filesystem::path> &crashes_folders) {
 
     file << "<!DOCTYPE html>\n";
     file << "<html>\n";
     file << "<head>\n";
+    file << "<meta charset=\"utf-8\">\n";
 
     file << "<script src=\"https://cdnjs.cloudflare.com/ajax/libs/jquery/3.6.0/jquery.min.js\"></script>\n";
     file << "<script src=\"https://cdnjs.cloudflare.com/ajax/libs/jquery.tablesorter/2.31.3/js/jquery.tablesorter.min.js\"></script>\n";
@@ -32,6 +85,10 @@ std::string triage_asan_summary(const TRIAGE_RESULT &results, std::vector<std::f
     file << "tr:nth-child(even) {\n";
     file << "  background-color: #dddddd;\n";
     file << "}\n";
+    file << "\n";
+    file << "pre {\n";
+    file << "  white-space: pre-wrap;\n";
+    file << "}\n";
     file << "</style>\n";
     file << "</head>\n";
     file << "<body>\n";
@@ -43,14 +100,189 @@ std::string triage_asan_summary(const TRIAGE_RESULT &results, std::vector<std::f
     file << "<h3>Crashes folders</h3>\n";
     file << "<ul>\n";
     for (auto &crash_folder : crashes_folders) {
-        file << "  <li>" << crash_folder << "</li>\n";
+        file << "  <li>" << crash_folder.string() << "</li>\n";
     }
     file << "</ul>\n";
+}
+
+// Reports are loaded with a <script> per chunk, fetch() is not allowed on file:// pages
+static void summary_footer(std::ostream &file, const std::filesystem::path &details_folder) {
+
+    file << "<script>\n";
+    file << "var DETAILS = " << JSON(details_folder.filename().string()).dump() << ";\n";
+    file << "var ROWS_PER_PAGE = " << SUMMARY_ROWS_PER_PAGE << ";\n";
+    file << "var chunks = {};\n";
+    file << "var waiting = {};\n";
+    file << "\n";
+    file << "function fill(d) {\n";
+    file << "  d.querySelector(\"pre\").textContent = chunks[d.dataset.chunk][d.dataset.entry];\n";
+    file << "}\n";
+    file << "\n";
+    file << "function frfuzz_chunk(id, entries) {\n";
+    file << "  chunks[id] = entries;\n";
+    file << "  (waiting[id] || []).forEach(fill);\n";
+    file << "  delete waiting[id];\n";
+    file << "}\n";
+    file << "\n";
+    file << "document.addEventListener(\"toggle\", function(e) {\n";
+    file << "  var d = e.target;\n";
+    file << "  if (!d.open || d.dataset.chunk === undefined || d.dataset.loaded) return;\n";
+    file << "  d.dataset.loaded = 1;\n";
+    file << "  var id = d.dataset.chunk;\n";
+    file << "  if (id in chunks) { fill(d); return; }\n";
+    file << "  if (!(id in waiting)) {\n";
+    file << "    waiting[id] = [];\n";
+    file << "    var s = document.createElement(\"script\");\n";
+    file << "    s.src = DETAILS + \"/chunk_\" + id + \".js\";\n";
+    file << "    document.head.appendChild(s);\n";
+    file << "  }\n";
+    file << "  waiting[id].push(d);\n";
+    file << "}, true);\n";
+    file << "\n";
+    file << "function paginate(table, page) {\n";
+    file << "  var rows = $(table).find(\"tbody > tr\");\n";
+    file << "  var pages = Math.max(1, Math.ceil(rows.length / ROWS_PER_PAGE));\n";
+    file << "  page = Math.min(Math.max(page, 0), pages - 1);\n";
+    file << "  rows.each(function(i) { $(this).toggle(Math.floor(i / ROWS_PER_PAGE) == page); });\n";
+    file << "  var nav = $(table).next(\".pages\");\n";
+    file << "  nav.find(\".page\").text(\"Page \" + (page + 1) + \" / \" + pages);\n";
+    file << "  nav.data(\"page\", page);\n";
+    file << "}\n";
+    file << "\n";
+    file << "$(document).ready(function() {\n";
+    file << "  $(\".sortable\").tablesorter();\n";
+    file << "  $(\"table.paged\").each(function() {\n";
+    file << "    var table = this;\n";
+    file << "    var nav = $(\"<p class='pages'><button>&lt;</button> <span class='page'></span> <button>&gt;</button></p>\").insertAfter(table);\n";
+    file << "    nav.find(\"button\").first().click(function() { paginate(table, nav.data(\"page\") - 1); });\n";
+    file << "    nav.find(\"button\").last().click(function() { paginate(table, nav.data(\"page\") + 1); });\n";
+    file << "    $(table).on(\"sortEnd\", function() { paginate(table, 0); });\n";
+    file << "    paginate(table, 0);\n";
+    file << "  });\n";
+    file << "});\n";
+    file << "</script>\n";
+
+    file << "</body>\n";
+    file << "</html>\n";
+}
+
+static std::string bug_type_name(BUG_TYPE type) {
+
+    if (type == BUG_TYPE::HEAP_BUFFER_OVERFLOW) {
+        return "Heap Buffer Overflow";
+    } else if (type == BUG_TYPE::HEAP_BUFFER_OVERFLOW_READ) {
+        return "Heap Buffer Overflow (READ)";
+    } else if (type == BUG_TYPE::HEAP_BUFFER_OVERFLOW_WRITE) {
+        return "Heap Buffer Overflow (WRITE)";
+
+    } else if (type == BUG_TYPE::STACK_BUFFER_OVERFLOW) {
+        return "Stack Buffer Overflow";
+    } else if (type == BUG_TYPE::STACK_BUFFER_OVERFLOW_READ) {
+        return "Stack Buffer Overflow (READ)";
+    } else if (type == BUG_TYPE::STACK_BUFFER_OVERFLOW_WRITE) {
+        return "Stack Buffer Overflow (WRITE)";
+
+    } else if (type == BUG_TYPE::SEGV_READ) {
+        return "Segmentation Fault (READ)";
+    } else if (type == BUG_TYPE::SEGV_WRITE) {
+        return "Segmentation Fault (WRITE)";
+    } else if (type == BUG_TYPE::SEGV) {
+        return "Segmentation Fault";
+
+    } else if (type == BUG_TYPE::ALLOCATION_OVERFLOW) {
+        return "Allocation Overflow";
+    } else if (type == BUG_TYPE::FPE) {
+        return "Floating Point Exception";
+    } else if (type == BUG_TYPE::OOM) {
+        return "Out of Memory";
+
+    } else if (type == BUG_TYPE::UAF) {
+        return "Use After Free";
+    } else if (type == BUG_TYPE::UAF_READ) {
+        return "Use After Free (READ)";
+    } else if (type == BUG_TYPE::UAF_WRITE) {
+        return "Use After Free (WRITE)";
+
+    } else if (type == BUG_TYPE::GLOBAL_BUFFER_OVERFLOW) {
+        return "Global Buffer Overflow";
+    } else if (type == BUG_TYPE::STACK_OVERFLOW) {
+        return "Stack Overflow";
+
+    } else if (type == BUG_TYPE::NEGATIVE_SIZE) {
+        return "Negative Size Parameter";
+
+    } else if (type == BUG_TYPE::INVALID_FREE) {
+        return "Invalid Free";
+    } else if (type == BUG_TYPE::DOUBLE_FREE) {
+        return "Double Free";
+    } else if (type == BUG_TYPE::ALLOC_DEALLOC_MISMATCH) {
+        return "Alloc-Dealloc Mismatch";
+
+    } else if (type == BUG_TYPE::USE_AFTER_RETURN) {
+        return "Stack Use After Return";
+    } else if (type == BUG_TYPE::USE_AFTER_SCOPE) {
+        return "Stack Use After Scope";
+    } else if (type == BUG_TYPE::PARAM_OVERLAP) {
+        return "Overlapping Parameters";
+
+    } else if (type == BUG_TYPE::UNINITIALIZED_VALUE) {
+        return "Use of Uninitialized Value";
+    } else if (type == BUG_TYPE::DATA_RACE) {
+        return "Data Race";
+
+    } else if (type == BUG_TYPE::UNKNOWN) {
+        return "Unknown crash";
+    }
+
+    return "Unknown";
+}
+
+static std::string sanitizer_name(SANITIZER sanitizer) {
+
+    if (sanitizer == SANITIZER::ASAN) {
+        return "AddressSanitizer";
+    } else if (sanitizer == SANITIZER::MSAN) {
+        return "MemorySanitizer";
+    } else if (sanitizer == SANITIZER::UBSAN) {
+        return "UndefinedBehaviorSanitizer";
+    } else if (sanitizer == SANITIZER::TSAN) {
+        return "ThreadSanitizer";
+    } else if (sanitizer == SANITIZER::CFISAN) {
+        return "Control Flow Integrity Sanitizer";
+    }
+
+    return "Unknown";
+}
+
+// Link to the input, flagged when it took more than one run to reproduce
+static void summary_crash_link(std::ostream &file, const FR_CRASH &crash) {
+
+    file << "<a href=\"" << crash.crash_path.string() << "\">" << crash.crash_path.filename().string() << "</a>";
+
+    if (crash.attempts > 1) {
+        file << " [flaky: reproduced after " << crash.attempts << " runs]";
+    }
+
+    if (!crash.minimized.empty()) {
+        file << " [minimized: <a href=\"" << crash.minimized.string() << "\">" << crash.minimized.filename().string() << "</a>]";
+    }
+
+    file << " <br> \n";
+}
+
+void triage_asan_summary(std::ostream &file, SUMMARY_DETAILS &details, const TRIAGE_RESULT &results,
+                         const std::vector<std::filesystem::path> &crashes_folders, size_t total_crashes) {
+
+    auto &bugs = results.triage_asan_result->sym_bugs;
+    auto &aborted = results.triage_asan_result->aborted;
+    auto &unknown = results.triage_asan_result->unknown;
+    auto &known = results.triage_asan_result->known;
 
     file << "<p>Total crashes: " << total_crashes << "</p>\n";
     file << "<p>Unique bugs: " << bugs.size() << "</p>\n";
+    file << "<p>Known bugs from earlier campaigns: " << known.size() << "</p>\n";
 
-    file << "<table class=\"sortable\">\n";
+    file << "<table class=\"sortable paged\">\n";
     file << "<thead>\n";
     file << "  <tr>\n";
     file << "    <th>Sanitizer</th>\n";
@@ -67,110 +299,27 @@ std::string triage_asan_summary(const TRIAGE_RESULT &results, std::vector<std::f
     file << "<tbody>\n";
     for (auto &bug : bugs) {
 
-        std::vector<FR_CRASH> crashes = bug.second;
+        const std::vector<FR_CRASH> &crashes = bug.second;
 
         file << "  <tr>\n";
 
-        if (bug.first.sanitizer == SANITIZER::ASAN) {
-            file << "    <td>AddressSanitizer</td>\n";
-        } else if (bug.first.sanitizer == SANITIZER::MSAN) {
-            file << "    <td>MemorySanitizer</td>\n";
-        } else if (bug.first.sanitizer == SANITIZER::UBSAN) {
-            file << "    <td>UndefinedBehaviorSanitizer</td>\n";
-        } else if (bug.first.sanitizer == SANITIZER::TSAN) {
-            file << "    <td>ThreadSanitizer</td>\n";
-        } else if (bug.first.sanitizer == SANITIZER::CFISAN) {
-            file << "    <td>Control Flow Integrity Sanitizer</td>\n";
-        } else {
-            file << "    <td>Unknown</td>\n";
-        }
-
-        if (bug.first.type == BUG_TYPE::HEAP_BUFFER_OVERFLOW) {
-            file << "    <td>Heap Buffer Overflow";
-            file << "</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::HEAP_BUFFER_OVERFLOW_READ) {
-            file << "    <td>Heap Buffer Overflow (READ)";
-
-            // Get the 3 FR_CRASH with the most oob_bytes
-            std::sort(crashes.begin(), crashes.end(), [](FR_CRASH &a, FR_CRASH &b) { return a.oob_bytes > b.oob_bytes; });
-            file << " [up to " << crashes[0].oob_bytes << " bytes]";
-            file << "</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::HEAP_BUFFER_OVERFLOW_WRITE) {
-            file << "    <td>Heap Buffer Overflow (WRITE)";
-
-            std::sort(crashes.begin(), crashes.end(), [](FR_CRASH &a, FR_CRASH &b) { return a.oob_bytes > b.oob_bytes; });
-            file << " [up to " << crashes[0].oob_bytes << " bytes]";
-            file << "</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::STACK_BUFFER_OVERFLOW) {
-            file << "    <td>Stack Buffer Overflow";
-            file << "</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::STACK_BUFFER_OVERFLOW_READ) {
-            file << "    <td>Stack Buffer Overflow (READ)";
+        file << "    <td>" << sanitizer_name(bug.first.sanitizer) << "</td>\n";
 
-            // Get the 3 FR_CRASH with the most oob_bytes
-            std::sort(crashes.begin(), crashes.end(), [](FR_CRASH &a, FR_CRASH &b) { return a.oob_bytes > b.oob_bytes; });
-            file << " [up to " << crashes[0].oob_bytes << " bytes]";
-            file << "</td>\n";
+        file << "    <td>" << bug_type_name(bug.first.type);
 
-        } else if (bug.first.type == BUG_TYPE::STACK_BUFFER_OVERFLOW_WRITE) {
-            file << "    <td>Stack Buffer Overflow (WRITE)";
+        BUG_TYPE type = bug.first.type;
 
-            std::sort(crashes.begin(), crashes.end(), [](FR_CRASH &a, FR_CRASH &b) { return a.oob_bytes > b.oob_bytes; });
-            file << " [up to " << crashes[0].oob_bytes << " bytes]";
-            file << "</td>\n";
+        if (type == BUG_TYPE::HEAP_BUFFER_OVERFLOW_READ || type == BUG_TYPE::HEAP_BUFFER_OVERFLOW_WRITE ||
+            type == BUG_TYPE::STACK_BUFFER_OVERFLOW_READ || type == BUG_TYPE::STACK_BUFFER_OVERFLOW_WRITE || type == BUG_TYPE::UAF_READ ||
+            type == BUG_TYPE::UAF_WRITE) {
 
-        } else if (bug.first.type == BUG_TYPE::SEGV_READ) {
-            file << "    <td>Segmentation Fault (READ)</td>\n";
-        } else if (bug.first.type == BUG_TYPE::SEGV_WRITE) {
-            file << "    <td>Segmentation Fault (WRITE)</td>\n";
-        } else if (bug.first.type == BUG_TYPE::SEGV) {
-            file << "    <td>Segmentation Fault</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::ALLOCATION_OVERFLOW) {
-            file << "    <td>Allocation Overflow</td>\n";
-        } else if (bug.first.type == BUG_TYPE::FPE) {
-            file << "    <td>Floating Point Exception</td>\n";
-        } else if (bug.first.type == BUG_TYPE::OOM) {
-            file << "    <td>Out of Memory</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::UAF) {
-            file << "    <td>Use After Free</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::UAF_READ) {
-            file << "    <td>Use After Free (READ)";
-
-            std::sort(crashes.begin(), crashes.end(), [](FR_CRASH &a, FR_CRASH &b) { return a.oob_bytes > b.oob_bytes; });
-            file << " [up to " << crashes[0].oob_bytes << " bytes]";
-            file << "</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::UAF_WRITE) {
-            file << "    <td>Use After Free (WRITE)";
-
-            std::sort(crashes.begin(), crashes.end(), [](FR_CRASH &a, FR_CRASH &b) { return a.oob_bytes > b.oob_bytes; });
-            file << " [up to " << crashes[0].oob_bytes << " bytes]";
-            file << "</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::GLOBAL_BUFFER_OVERFLOW) {
-            file << "    <td>Global Buffer Overflow</td>\n";
-        } else if (bug.first.type == BUG_TYPE::STACK_OVERFLOW) {
-            file << "    <td>Stack Overflow</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::NEGATIVE_SIZE) {
-            file << "    <td>Negative Size Parameter</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::INVALID_FREE) {
-            file << "    <td>Invalid Free</td>\n";
-
-        } else if (bug.first.type == BUG_TYPE::UNKNOWN) {
-            file << "    <td>Unknown crash</td>\n";
-        } else {
-            file << "    <td>Unknown</td>\n";
+            auto widest =
+                std::max_element(crashes.begin(), crashes.end(), [](const FR_CRASH &a, const FR_CRASH &b) { return a.oob_bytes < b.oob_bytes; });
+            file << " [up to " << widest->oob_bytes << " bytes]";
         }
 
+        file << "</td>\n";
+
         file << "    <td>" << bug.first.function << "</td>\n";
         file << "    <td>" << bug.first.file << "</td>\n";
         file << "    <td>" << bug.first.line << "</td>\n";
@@ -185,7 +334,7 @@ std::string triage_asan_summary(const TRIAGE_RESULT &results, std::vector<std::f
             if (c == 0) {
                 break;
             }
-            file << "<a href=\"" << crash.crash_path.string() << "\">" << crash.crash_path.filename().string() << "</a> <br> \n";
+            summary_crash_link(file, crash);
             c--;
         }
         file << "    </td>\n";
@@ -196,7 +345,7 @@ std::string triage_asan_summary(const TRIAGE_RESULT &results, std::vector<std::f
             if (c == 0) {
                 break;
             }
-            file << "<details>" << crash.description << "</details> <br> \n";
+            file << details.add(results.description(crash)) << " <br> \n";
             c--;
         }
         file << "    </td>\n";
@@ -208,91 +357,162 @@ std::string triage_asan_summary(const TRIAGE_RESULT &results, std::vector<std::f
     file << "</table>\n";
     file << "\n";
 
+    // Triaged already, no details
+    if (!known.empty()) {
+
+        file << "<h3>Known bugs</h3>\n";
+        file << "<table class=\"sortable paged\">\n";
+        file << "<thead>\n";
+        file << "  <tr>\n";
+        file << "    <th>Sanitizer</th>\n";
+        file << "    <th>Bug Type</th>\n";
+        file << "    <th>Call stack</th>\n";
+        file << "    <th>File</th>\n";
+        file << "    <th>Line</th>\n";
+        file << "    <th>First seen in</th>\n";
+        file << "    <th>Number of crashes</th>\n";
+        file << "    <th>Crashes</th>\n";
+        file << "  </tr>\n";
+        file << "</thead>\n";
+
+        file << "<tbody>\n";
+        for (auto &bug : known) {
+
+            file << "  <tr>\n";
+            file << "    <td>" << sanitizer_name(bug.first.sanitizer) << "</td>\n";
+            file << "    <td>" << bug_type_name(bug.first.type) << "</td>\n";
+            file << "    <td>" << bug.first.function << "</td>\n";
+            file << "    <td>" << bug.first.file << "</td>\n";
+            file << "    <td>" << bug.first.line << "</td>\n";
+            file << "    <td>" << results.triage_asan_result->first_seen.at(bug.first) << "</td>\n";
+            file << "    <td>" << bug.second.size() << "</td>\n";
+
+            const size_t max_crashes = 4;
+            size_t c = max_crashes;
+
+            file << "    <td>";
+            for (auto &crash : bug.second) {
+                if (c == 0) {
+                    break;
+                }
+                summary_crash_link(file, crash);
+                c--;
+            }
+            file << "    </td>\n";
+
+            file << "  </tr>\n";
+        }
+        file << "</tbody>\n";
+        file << "</table>\n";
+        file << "\n";
+    }
+
     file << "<h3>Aborted inputs</h3>\n";
-    file << "<ul>\n";
+    file << "<table class=\"paged\">\n";
+    file << "<tbody>\n";
     for (auto &abort : aborted) {
-        file << "  <li>" << abort.crash_path << "</li><details>" << abort.description << "</details>\n";
+        file << "  <tr><td>" << abort.crash_path.string() << "</td><td>" << details.add(results.description(abort)) << "</td></tr>\n";
     }
-    file << "</ul>\n";
+    file << "</tbody>\n";
+    file << "</table>\n";
 
     file << "<h3>Unknown crashes</h3>\n";
-    file << "<ul>\n";
+    file << "<table class=\"paged\">\n";
+    file << "<tbody>\n";
+    for (auto &u : unknown) {
+        file << "  <tr><td>" << u.crash_path.string() << "</td><td>" << details.add(results.description(u)) << "</td></tr>\n";
+    }
+    file << "</tbody>\n";
+    file << "</table>\n";
+}
 
-    const size_t MAX_UNKNOWN = 512;
+void triage_ubsan_summary(std::ostream &file, SUMMARY_DETAILS &details, const TRIAGE_RESULT &results,
+                          const std::vector<std::filesystem::path> &crashes_folders, size_t total_crashes) {
 
-    size_t cnt = MAX_UNKNOWN;
+    auto &bugs = results.triage_ubsan_result->bugs;
+    auto &unknown = results.triage_ubsan_result->unknown;
 
-    for (auto &u : unknown) {
-        file << "  <li>" << u.crash_path << "</li><details>" << u.description << "</details>\n";
-        cnt--;
-        if (cnt == 0) {
-            break;
-        }
-    }
-    file << "</ul>\n";
+    file << "<p>Total crashes: " << total_crashes << "</p>\n";
+    file << "<p>Unique runtime errors: " << bugs.size() << "</p>\n";
 
-    file << "<script>\n";
-    file << "$(document).ready(function() {\n";
-    file << "  $(\".sortable\").tablesorter();\n";
-    file << "});\n";
-    file << "</script>\n";
+    file << "<table class=\"sortable paged\">\n";
+    file << "<thead>\n";
+    file << "  <tr>\n";
+    file << "    <th>Check</th>\n";
+    file << "    <th>File</th>\n";
+    file << "    <th>Line</th>\n";
+    file << "    <th>Column</th>\n";
+    file << "    <th>Number of crashes</th>\n";
+    file << "    <th>Crashes</th>\n";
+    file << "    <th>Details</th>\n";
+    file << "  </tr>\n";
+    file << "</thead>\n";
 
-    file << "</body>\n";
-    file << "</html>\n";
+    file << "<tbody>\n";
+    for (auto &bug : bugs) {
 
-    return file.str();
-}
+        const std::vector<FR_CRASH> &crashes = bug.second;
 
-std::string triage_ubsan_summary(const TRIAGE_RESULT &results, std::vector<std::filesystem::path> crashes_folders, size_t total_crashes) {}
+        file << "  <tr>\n";
 
-std::string triage_gdb_summary(const TRIAGE_RESULT &results, std::vector<std::filesystem::path> crashes_folders, size_t total_crashes) {
+        file << "    <td>" << bug.first.check << "</td>\n";
+        file << "    <td>" << bug.first.file << "</td>\n";
+        file << "    <td>" << bug.first.line << "</td>\n";
+        file << "    <td>" << bug.first.column << "</td>\n";
 
-    auto &bugs = results.triage_gdb_result->bugs;
+        file << "    <td>" << bug.second.size() << "</td>\n";
 
-    std::stringstream file;
+        const size_t max_crashes = 4;
+        size_t c;
 
-    file << "<!DOCTYPE html>\n";
-    file << "<html>\n";
-    file << "<head>\n";
+        file << "    <td>";
+        c = max_crashes;
+        for (auto &crash : crashes) {
+            if (c == 0) {
+                break;
+            }
+            summary_crash_link(file, crash);
+            c--;
+        }
+        file << "    </td>\n";
 
-    file << "<script src=\"https://cdnjs.cloudflare.com/ajax/libs/jquery/3.6.0/jquery.min.js\"></script>\n";
-    file << "<script src=\"https://cdnjs.cloudflare.com/ajax/libs/jquery.tablesorter/2.31.3/js/jquery.tablesorter.min.js\"></script>\n";
+        file << "    <td>";
+        c = max_crashes;
+        for (auto &crash : crashes) {
+            if (c == 0) {
+                break;
+            }
+            file << details.add(results.description(crash)) << " <br> \n";
+            c--;
+        }
+        file << "    </td>\n";
 
-    file << "<style>\n";
-    file << "table {\n";
-    file << "  font-family: arial, sans-serif;\n";
-    file << "  border-collapse: collapse;\n";
-    file << "  width: 100%;\n";
-    file << "}\n";
-    file << "\n";
-    file << "td, th {\n";
-    file << "  border: 1px solid #dddddd;\n";
-    file << "  text-align: left;\n";
-    file << "  padding: 8px;\n";
-    file << "}\n";
-    file << "\n";
-    file << "tr:nth-child(even) {\n";
-    file << "  background-color: #dddddd;\n";
-    file << "}\n";
-    file << "</style>\n";
-    file << "</head>\n";
-    file << "<body>\n";
-    file << "\n";
-    file << "<h2>Summary</h2>\n";
+        file << "  </tr>\n";
+    }
+
+    file << "</tbody>\n";
+    file << "</table>\n";
     file << "\n";
 
-    // List all the crashes folders
-    file << "<h3>Crashes folders</h3>\n";
-    file << "<ul>\n";
-    for (auto &crash_folder : crashes_folders) {
-        file << "  <li>" << crash_folder << "</li>\n";
+    file << "<h3>Inputs without runtime errors</h3>\n";
+    file << "<table class=\"paged\">\n";
+    file << "<tbody>\n";
+    for (auto &u : unknown) {
+        file << "  <tr><td>" << u.crash_path.string() << "</td><td>" << details.add(results.description(u)) << "</td></tr>\n";
     }
-    file << "</ul>\n";
+    file << "</tbody>\n";
+    file << "</table>\n";
+}
+
+void triage_gdb_summary(std::ostream &file, SUMMARY_DETAILS &details, const TRIAGE_RESULT &results,
+                        const std::vector<std::filesystem::path> &crashes_folders, size_t total_crashes) {
+
+    auto &bugs = results.triage_gdb_result->bugs;
 
     file << "<p>Total crashes: " << total_crashes << "</p>\n";
     file << "<p>Unique bugs: " << bugs.size() << "</p>\n";
 
-    file << "<table class=\"sortable\">\n";
+    file << "<table class=\"sortable paged\">\n";
     file << "<thead>\n";
     file << "  <tr>\n";
     file << "    <th>Bug Type</th>\n";
@@ -309,7 +529,7 @@ std::string triage_gdb_summary(const TRIAGE_RESULT &results, std::vector<std::fi
     file << "<tbody>\n";
     for (auto &bug : bugs) {
 
-        std::vector<FR_CRASH> &crashes = bug.second;
+        const std::vector<FR_CRASH> &crashes = bug.second;
 
         file << "  <tr>\n";
         file << "    <td>Segmentation Fault</td>\n";
@@ -330,7 +550,7 @@ std::string triage_gdb_summary(const TRIAGE_RESULT &results, std::vector<std::fi
             if (c == 0) {
                 break;
             }
-            file << "<a href=\"" << crash.crash_path.string() << "\">" << crash.crash_path.filename().string() << "</a> <br> \n";
+            summary_crash_link(file, crash);
             c--;
         }
         file << "    </td>\n";
@@ -341,7 +561,7 @@ std::string triage_gdb_summary(const TRIAGE_RESULT &results, std::vector<std::fi
             if (c == 0) {
                 break;
             }
-            file << "<details>" << crash.description << "</details> <br> \n";
+            file << details.add(results.description(crash)) << " <br> \n";
             c--;
         }
         file << "    </td>\n";
@@ -352,68 +572,18 @@ std::string triage_gdb_summary(const TRIAGE_RESULT &results, std::vector<std::fi
     file << "</tbody>\n";
     file << "</table>\n";
     file << "\n";
-
-    file << "<script>\n";
-    file << "$(document).ready(function() {\n";
-    file << "  $(\".sortable\").tablesorter();\n";
-    file << "});\n";
-    file << "</script>\n";
-
-    file << "</body>\n";
-    file << "</html>\n";
-
-    return file.str();
 }
 
-std::string triage_malloc_summary(const TRIAGE_RESULT &results, std::vector<std::filesystem::path> crashes_folders, size_t total_crashes) {
+void triage_malloc_summary(std::ostream &file, SUMMARY_DETAILS &details, const TRIAGE_RESULT &results,
+                           const std::vector<std::filesystem::path> &crashes_folders, size_t total_crashes) {
 
     auto &detected = results.triage_malloc_result->detected;
 
-    std::stringstream file;
-
-    file << "<!DOCTYPE html>\n";
-    file << "<html>\n";
-    file << "<head>\n";
-
-    file << "<script src=\"https://cdnjs.cloudflare.com/ajax/libs/jquery/3.6.0/jquery.min.js\"></script>\n";
-    file << "<script src=\"https://cdnjs.cloudflare.com/ajax/libs/jquery.tablesorter/2.31.3/js/jquery.tablesorter.min.js\"></script>\n";
-
-    file << "<style>\n";
-    file << "table {\n";
-    file << "  font-family: arial, sans-serif;\n";
-    file << "  border-collapse: collapse;\n";
-    file << "  width: 100%;\n";
-    file << "}\n";
-    file << "\n";
-    file << "td, th {\n";
-    file << "  border: 1px solid #dddddd;\n";
-    file << "  text-align: left;\n";
-    file << "  padding: 8px;\n";
-    file << "}\n";
-    file << "\n";
-    file << "tr:nth-child(even) {\n";
-    file << "  background-color: #dddddd;\n";
-    file << "}\n";
-    file << "</style>\n";
-    file << "</head>\n";
-    file << "<body>\n";
-    file << "\n";
-    file << "<h2>Summary</h2>\n";
-    file << "\n";
-
-    // List all the crashes folders
-    file << "<h3>Crashes folders</h3>\n";
-    file << "<ul>\n";
-    for (auto &crash_folder : crashes_folders) {
-        file << "  <li>" << crash_folder.string() << "</li>\n";
-    }
-    file << "</ul>\n";
-
     file << "<p>Total detections: " << detected.size() << "</p>\n";
 
     file << "<h3>Detected inputs</h3>\n";
 
-    file << "<table class=\"sortable\">\n";
+    file << "<table class=\"sortable paged\">\n";
     file << "<thead>\n";
     file << "  <tr>\n";
     file << "    <th>Crash Path</th>\n";
@@ -429,7 +599,7 @@ std::string triage_malloc_summary(const TRIAGE_RESULT &results, std::vector<std:
         file << "  <tr>\n";
 
         file << "    <td>";
-        file << "<a href=\"" << crash.crash_path.string() << "\">" << crash.crash_path.filename().string() << "</a> <br> \n";
+        summary_crash_link(file, crash);
         file << "    </td>\n";
 
         file << "    <td>";
@@ -437,7 +607,7 @@ std::string triage_malloc_summary(const TRIAGE_RESULT &results, std::vector<std:
         file << "    </td>\n";
 
         file << "    <td>";
-        file << "<details>" << crash.description << "</details> <br> \n";
+        file << details.add(results.description(crash)) << " <br> \n";
         file << "    </td>\n";
 
         file << "  </tr>\n";
@@ -446,80 +616,254 @@ std::string triage_malloc_summary(const TRIAGE_RESULT &results, std::vector<std:
     file << "</tbody>\n";
     file << "</table>\n";
     file << "\n";
+}
 
-    file << "<script>\n";
-    file << "$(document).ready(function() {\n";
-    file << "  $(\".sortable\").tablesorter();\n";
-    file << "});\n";
-    file << "</script>\n";
+void triage_hang_summary(std::ostream &file, SUMMARY_DETAILS &details, const TRIAGE_RESULT &results,
+                         const std::vector<std::filesystem::path> &crashes_folders, size_t total_crashes) {
 
-    file << "</body>\n";
-    file << "</html>\n";
+    auto &bugs = results.triage_hang_result->bugs;
+    auto &unknown = results.triage_hang_result->unknown;
+
+    file << "<p>Total hangs: " << total_crashes << "</p>\n";
+    file << "<p>Unique hot loops: " << bugs.size() << "</p>\n";
+
+    file << "<table class=\"sortable paged\">\n";
+    file << "<thead>\n";
+    file << "  <tr>\n";
+    file << "    <th>Hot loop</th>\n";
+    file << "    <th>File</th>\n";
+    file << "    <th>Line</th>\n";
+    file << "    <th>Module</th>\n";
+    file << "    <th>Number of hangs</th>\n";
+    file << "    <th>Hangs</th>\n";
+    file << "    <th>Profiles</th>\n";
+    file << "  </tr>\n";
+    file << "</thead>\n";
+
+    file << "<tbody>\n";
+    for (auto &bug : bugs) {
+
+        const std::vector<FR_CRASH> &crashes = bug.second;
+
+        file << "  <tr>\n";
+
+        file << "    <td>" << bug.first.function << "</td>\n";
+        file << "    <td>" << bug.first.file << "</td>\n";
+        file << "    <td>" << bug.first.line << "</td>\n";
+        file << "    <td>" << std::filesystem::path(bug.first.module).filename().string() << "</td>\n";
+
+        file << "    <td>" << bug.second.size() << "</td>\n";
+
+        const size_t max_crashes = 4;
+        size_t c;
+
+        file << "    <td>";
+        c = max_crashes;
+        for (auto &crash : crashes) {
+            if (c == 0) {
+                break;
+            }
+            summary_crash_link(file, crash);
+            c--;
+        }
+        file << "    </td>\n";
+
+        file << "    <td>";
+        c = max_crashes;
+        for (auto &crash : crashes) {
+            if (c == 0) {
+                break;
+            }
+            file << details.add(results.description(crash)) << " <br> \n";
+            c--;
+        }
+        file << "    </td>\n";
+
+        file << "  </tr>\n";
+    }
+
+    file << "</tbody>\n";
+    file << "</table>\n";
+    file << "\n";
 
-    return file.str();
+    file << "<h3>Inputs that did not hang</h3>\n";
+    file << "<table class=\"paged\">\n";
+    file << "<tbody>\n";
+    for (auto &u : unknown) {
+        file << "  <tr><td>" << u.crash_path.string() << "</td><td>" << details.add(results.description(u)) << "</td></tr>\n";
+    }
+    file << "</tbody>\n";
+    file << "</table>\n";
 }
 
-std::string triage_summary(TRIAGE_RESULT &results, const std::vector<std::filesystem::path> &crashes_folders, size_t total_crashes,
-                           std::string parser) {
+bool triage_summary(const std::filesystem::path &summary_path, TRIAGE_RESULT &results, const std::vector<std::filesystem::path> &crashes_folders,
+                    size_t total_crashes, std::string parser) {
+
+    // Written aside and renamed, the page may be open while follow mode updates it
+    std::filesystem::path partial_path = summary_path;
+    partial_path += ".partial";
 
-    // const std::unordered_map<FR_BUG, std::vector<FR_CRASH>> bugs, std::vector<std::filesystem::path> crashes_folders, size_t total_crashes,
-    // std::vector<FR_CRASH> aborted, std::vector<FR_CRASH> unknown, std::string parser) {
+    std::ofstream file(partial_path);
+
+    if (!file) {
+        std::cerr << "Error: could not write " << partial_path << std::endl;
+        return false;
+    }
+
+    // summary.html -> summary_details/
+    std::filesystem::path details_folder = summary_path;
+    details_folder.replace_filename(summary_path.stem().string() + "_details");
+
+    SUMMARY_DETAILS details;
+
+    if (!details.open(details_folder)) {
+        return false;
+    }
+
+    summary_header(file, crashes_folders);
 
     if (parser == "ASAN") {
-        return triage_asan_summary(results, crashes_folders, total_crashes);
+        triage_asan_summary(file, details, results, crashes_folders, total_crashes);
 
     } else if (parser == "UBSAN") {
-        return triage_ubsan_summary(results, crashes_folders, total_crashes);
+        triage_ubsan_summary(file, details, results, crashes_folders, total_crashes);
 
     } else if (parser == "GDB") {
-        return triage_gdb_summary(results, crashes_folders, total_crashes);
+        triage_gdb_summary(file, details, results, crashes_folders, total_crashes);
 
     } else if (parser == "MALLOC") {
-        return triage_malloc_summary(results, crashes_folders, total_crashes);
+        triage_malloc_summary(file, details, results, crashes_folders, total_crashes);
+
+    } else if (parser == "COV") {
+        triage_gdb_summary(file, details, results, crashes_folders, total_crashes);
+        triage_malloc_summary(file, details, results, crashes_folders, total_crashes);
+
+    } else if (parser == "HANG") {
+        triage_hang_summary(file, details, results, crashes_folders, total_crashes);
 
     } else {
         std::cerr << "Error: unknown parser: " << parser << std::endl;
         exit(EXIT_FAILURE);
     }
+
+    details.flush();
+
+    summary_footer(file, details_folder);
+
+    file.close();
+
+    if (!file) {
+        std::cerr << "Error: could not write " << partial_path << std::endl;
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(partial_path, summary_path, ec);
+
+    if (ec) {
+        std::cerr << "Error: could not write " << summary_path << std::endl;
+        return false;
+    }
+
+    return true;
 }
 
-//<binary, address>
-std::tuple<std::filesystem::path, uint64_t> parse_stack_trace_line_NOSYM(std::string line) {
+// Stack trace bytes, hashed twice with different seeds
+void FR_NOSYM_BUG::sign() {
 
-    std::filesystem::path file = "";
-    uint64_t address = 0;
+    std::string key;
 
-    size_t pos, pos2;
+    key.push_back((char)sanitizer);
+    key.push_back((char)type);
 
-    if ((pos = line.find(" (")) != std::string::npos) {
+    for (size_t i = 0; i < MAX_STACK_DEPTH; i++) {
 
-        pos += 2;
+        const std::string &file = std::get<0>(stack_trace[i]).native();
+        uint64_t address = std::get<1>(stack_trace[i]);
 
-        if ((pos2 = line.find(") ", pos)) != std::string::npos) {
+        key += file;
+        key.push_back('\0');
+        key.append((const char *)&address, sizeof(address));
+    }
 
-            // Find last '+' character before ')'
-            size_t addr_pos;
-            if ((addr_pos = line.rfind('+', pos2)) != std::string::npos) {
+    signature.low = xxhash64(key.data(), key.size());
+    signature.high = xxhash64(key.data(), key.size(), STACK_SIGNATURE_SEED);
+}
 
-                std::string address_str = line.substr(addr_pos + 1, pos2 - addr_pos - 1);
+void GDB_BUG::sign() {
 
-                // Check if the address is an hex number
-                if (address_str.starts_with("0x") != std::string::npos) {
-                    address = std::stoull(address_str, nullptr, 16);
-                } else {
-                    std::cerr << "Error: address is not an hex number: " << address_str << std::endl;
-                    exit(EXIT_FAILURE);
-                }
+    std::string key;
 
-                std::string file_str = line.substr(pos, addr_pos - pos);
-                file = std::filesystem::path(file_str);
-            }
+    for (const std::string *field : {&gdb_func, &gdb_arg, &gdb_file}) {
+        key += *field;
+        key.push_back('\0');
+    }
+
+    uint64_t line = gdb_line;
+    key.append((const char *)&line, sizeof(line));
+
+    signature.low = xxhash64(key.data(), key.size());
+    signature.high = xxhash64(key.data(), key.size(), STACK_SIGNATURE_SEED);
+}
+
+void UBSAN_BUG::sign() {
+
+    std::string key = check;
+    key.push_back('\0');
+    key += file;
+    key.push_back('\0');
 
-            // line = line.substr(pos, pos2 - pos);
+    uint64_t position[] = {line, column};
+    key.append((const char *)position, sizeof(position));
+
+    signature.low = xxhash64(key.data(), key.size());
+    signature.high = xxhash64(key.data(), key.size(), STACK_SIGNATURE_SEED);
+}
+
+void HANG_BUG::sign() {
+
+    std::string key = std::filesystem::path(module).filename().string();
+    key.push_back('\0');
+    key += function;
+    key.push_back('\0');
+    key += file;
+
+    signature.low = xxhash64(key.data(), key.size());
+    signature.high = xxhash64(key.data(), key.size(), STACK_SIGNATURE_SEED);
+}
+
+//<binary, address>. Frames look like "#3 0x55d0c1a2b3c4 in func file.c:12 (/path/binary+0x1234) (BuildId: ...)", only the module+offset part is kept
+std::tuple<std::filesystem::path, uint64_t> parse_stack_trace_line_NOSYM(std::string_view line) {
+
+    size_t open = 0;
+
+    while ((open = line.find('(', open)) != std::string_view::npos) {
+
+        size_t close = line.find(')', open);
+
+        if (close == std::string_view::npos) {
+            break;
+        }
+
+        std::string_view module = line.substr(open + 1, close - open - 1);
+
+        size_t plus = module.rfind("+0x");
+
+        if (plus != std::string_view::npos) {
+
+            uint64_t address = 0;
+
+            std::string_view hex = module.substr(plus + 3);
+
+            if (std::from_chars(hex.data(), hex.data() + hex.size(), address, 16).ec == std::errc()) {
+                return std::make_tuple(std::filesystem::path(module.substr(0, plus)), address);
+            }
         }
+
+        open = close + 1;
     }
 
-    return std::make_tuple(file, address);
+    return std::make_tuple(std::filesystem::path(), 0);
 }
 
 //<function, file, line_number>
@@ -634,13 +978,305 @@ std::tuple<std::string, std::filesystem::path, size_t> parse_stack_trace_line(st
     return std::make_tuple(function, file, line_number);
 }
 
-std::optional<std::tuple<FR_NOSYM_BUG, FR_CRASH>> parse_sanitizer_output_NOSYM(std::string output, const std::filesystem::path triage_folder,
-                                                                               const std::filesystem::path binary_folder) {
+struct SANITIZER_BUG_PREFIX {
+    std::string_view prefix;
+    BUG_TYPE type;
+    BUG_TYPE type_read;
+    BUG_TYPE type_write;
+};
+
+// Types without READ/WRITE variants repeat the base type
+const SANITIZER_BUG_PREFIX SANITIZER_BUG_PREFIXES[] = {
+    {"heap-buffer-overflow", BUG_TYPE::HEAP_BUFFER_OVERFLOW, BUG_TYPE::HEAP_BUFFER_OVERFLOW_READ, BUG_TYPE::HEAP_BUFFER_OVERFLOW_WRITE},
+    {"stack-buffer-overflow", BUG_TYPE::STACK_BUFFER_OVERFLOW, BUG_TYPE::STACK_BUFFER_OVERFLOW_READ, BUG_TYPE::STACK_BUFFER_OVERFLOW_WRITE},
+    {"dynamic-stack-buffer-overflow", BUG_TYPE::STACK_BUFFER_OVERFLOW, BUG_TYPE::STACK_BUFFER_OVERFLOW_READ, BUG_TYPE::STACK_BUFFER_OVERFLOW_WRITE},
+    {"heap-use-after-free", BUG_TYPE::UAF, BUG_TYPE::UAF_READ, BUG_TYPE::UAF_WRITE},
+    {"SEGV", BUG_TYPE::SEGV, BUG_TYPE::SEGV_READ, BUG_TYPE::SEGV_WRITE},
+    {"attempting free on address which was not malloc", BUG_TYPE::INVALID_FREE, BUG_TYPE::INVALID_FREE, BUG_TYPE::INVALID_FREE},
+    {"attempting double-free", BUG_TYPE::DOUBLE_FREE, BUG_TYPE::DOUBLE_FREE, BUG_TYPE::DOUBLE_FREE},
+    {"alloc-dealloc-mismatch", BUG_TYPE::ALLOC_DEALLOC_MISMATCH, BUG_TYPE::ALLOC_DEALLOC_MISMATCH, BUG_TYPE::ALLOC_DEALLOC_MISMATCH},
+    {"requested allocation size", BUG_TYPE::ALLOCATION_OVERFLOW, BUG_TYPE::ALLOCATION_OVERFLOW, BUG_TYPE::ALLOCATION_OVERFLOW},
+    {"allocation-size-too-big", BUG_TYPE::ALLOCATION_OVERFLOW, BUG_TYPE::ALLOCATION_OVERFLOW, BUG_TYPE::ALLOCATION_OVERFLOW},
+    {"calloc-overflow", BUG_TYPE::ALLOCATION_OVERFLOW, BUG_TYPE::ALLOCATION_OVERFLOW, BUG_TYPE::ALLOCATION_OVERFLOW},
+    {"FPE", BUG_TYPE::FPE, BUG_TYPE::FPE, BUG_TYPE::FPE},
+    {"out of memory", BUG_TYPE::OOM, BUG_TYPE::OOM, BUG_TYPE::OOM},
+    {"allocator is out of memory", BUG_TYPE::OOM, BUG_TYPE::OOM, BUG_TYPE::OOM},
+    {"global-buffer-overflow", BUG_TYPE::GLOBAL_BUFFER_OVERFLOW, BUG_TYPE::GLOBAL_BUFFER_OVERFLOW, BUG_TYPE::GLOBAL_BUFFER_OVERFLOW},
+    {"stack-overflow", BUG_TYPE::STACK_OVERFLOW, BUG_TYPE::STACK_OVERFLOW, BUG_TYPE::STACK_OVERFLOW},
+    {"negative-size-param", BUG_TYPE::NEGATIVE_SIZE, BUG_TYPE::NEGATIVE_SIZE, BUG_TYPE::NEGATIVE_SIZE},
+    {"stack-use-after-return", BUG_TYPE::USE_AFTER_RETURN, BUG_TYPE::USE_AFTER_RETURN, BUG_TYPE::USE_AFTER_RETURN},
+    {"stack-use-after-scope", BUG_TYPE::USE_AFTER_SCOPE, BUG_TYPE::USE_AFTER_SCOPE, BUG_TYPE::USE_AFTER_SCOPE},
+    {"memcpy-param-overlap", BUG_TYPE::PARAM_OVERLAP, BUG_TYPE::PARAM_OVERLAP, BUG_TYPE::PARAM_OVERLAP},
+    {"strcpy-param-overlap", BUG_TYPE::PARAM_OVERLAP, BUG_TYPE::PARAM_OVERLAP, BUG_TYPE::PARAM_OVERLAP},
+    {"use-of-uninitialized-value", BUG_TYPE::UNINITIALIZED_VALUE, BUG_TYPE::UNINITIALIZED_VALUE, BUG_TYPE::UNINITIALIZED_VALUE},
+    {"data race", BUG_TYPE::DATA_RACE, BUG_TYPE::DATA_RACE, BUG_TYPE::DATA_RACE},
+    {"unknown-crash", BUG_TYPE::UNKNOWN, BUG_TYPE::UNKNOWN, BUG_TYPE::UNKNOWN},
+};
+
+// Offset of the text after "ERROR: <sanitizer>: " or "WARNING: <sanitizer>: " for the first report in output
+static std::optional<size_t> find_sanitizer_header(std::string_view output, SANITIZER &sanitizer) {
+
+    // Pattern 2 * i is the ERROR header of SANITIZER_HEADERS[i], 2 * i + 1 the WARNING one
+    static const pattern_matcher matcher = [] {
+
+        pattern_matcher m;
+
+        for (const SANITIZER_HEADER &header : SANITIZER_HEADERS) {
+            m.add(std::string("ERROR: ") + std::string(header.name));
+            m.add(std::string("WARNING: ") + std::string(header.name));
+        }
+
+        m.compile();
+
+        return m;
+    }();
+
+    std::optional<PATTERN_MATCH> match = matcher.find_first(output);
+
+    if (!match) {
+        return std::nullopt;
+    }
+
+    sanitizer = SANITIZER_HEADERS[match->id / 2].sanitizer;
+
+    return match->offset + matcher.pattern(match->id).size();
+}
+
+std::optional<std::tuple<FR_NOSYM_BUG, FR_CRASH>> parse_sanitizer_output_NOSYM(std::string_view output, const std::filesystem::path triage_folder,
+                                                                               const std::filesystem::path binary_folder, size_t top_frames) {
+
+    top_frames = std::clamp<size_t>(top_frames, 1, MAX_STACK_DEPTH);
 
     FR_NOSYM_BUG bug;
 
     FR_CRASH crash;
 
+    std::optional<size_t> header = find_sanitizer_header(output, bug.sanitizer);
+
+    if (!header) {
+        return std::nullopt;
+    }
+
+    // Everything from the bug type to the end of the output
+    output = output.substr(*header);
+
+    const SANITIZER_BUG_PREFIX *prefix = nullptr;
+
+    for (const SANITIZER_BUG_PREFIX &p : SANITIZER_BUG_PREFIXES) {
+        if (output.starts_with(p.prefix)) {
+            prefix = &p;
+            break;
+        }
+    }
+
+    // Reports that are not in the table are kept as unknown, the description still tells what they are
+    enum { ACCESS_NONE, ACCESS_READ, ACCESS_WRITE } access = ACCESS_NONE;
+
+    size_t depth = 0;
+    bool in_stack = false;
+
+    // The access line and the SEGV cause come before the first stack, which is the only one that matters. Allocation and free stacks follow it
+    size_t pos = 0;
+
+    while (pos < output.size()) {
+
+        size_t end = output.find('\n', pos);
+
+        if (end == std::string_view::npos) {
+            end = output.size();
+        }
+
+        std::string_view line = output.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t first = line.find_first_not_of(' ');
+
+        if (first == std::string_view::npos) {
+            if (in_stack) {
+                break;
+            }
+            continue;
+        }
+
+        line = line.substr(first);
+
+        if (line.size() > 1 && line[0] == '#' && line[1] >= '0' && line[1] <= '9') {
+
+            in_stack = true;
+
+            std::tuple<std::filesystem::path, uint64_t> frame = parse_stack_trace_line_NOSYM(line);
+
+            // The forkserver shim frame sits between main and libc, it is not part of the bug
+            if (!std::get<0>(frame).filename().string().starts_with(FORKSRV_SHIM_NAME)) {
+                bug.stack_trace[depth] = std::move(frame);
+                depth += 1;
+            }
+
+            if (depth == top_frames) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (in_stack) {
+            break;
+        }
+
+        if (access != ACCESS_NONE) {
+            continue;
+        }
+
+        std::string_view size;
+
+        if (line.starts_with("READ of size ")) {
+            access = ACCESS_READ;
+            size = line.substr(13);
+        } else if (line.starts_with("WRITE of size ")) {
+            access = ACCESS_WRITE;
+            size = line.substr(14);
+        } else if (line.find("caused by a READ") != std::string_view::npos) {
+            access = ACCESS_READ;
+        } else if (line.find("caused by a WRITE") != std::string_view::npos) {
+            access = ACCESS_WRITE;
+        }
+
+        if (!size.empty()) {
+            std::from_chars(size.data(), size.data() + size.size(), crash.oob_bytes);
+        }
+    }
+
+    if (prefix != nullptr) {
+        if (access == ACCESS_READ) {
+            bug.type = prefix->type_read;
+        } else if (access == ACCESS_WRITE) {
+            bug.type = prefix->type_write;
+        } else {
+            bug.type = prefix->type;
+        }
+    }
+
+    crash.description = output;
+
+    bug.sign();
+
+    return std::make_tuple(std::move(bug), std::move(crash));
+}
+
+// "file:line:column", or the whole location in file if it's not one
+static void parse_ubsan_location(std::string_view location, const std::filesystem::path binary_folder, UBSAN_BUG &bug) {
+
+    size_t column_pos = location.rfind(':');
+    size_t line_pos = column_pos == std::string_view::npos || column_pos == 0 ? std::string_view::npos : location.rfind(':', column_pos - 1);
+
+    size_t line = 0;
+    size_t column = 0;
+
+    if (line_pos == std::string_view::npos ||
+        std::from_chars(location.data() + line_pos + 1, location.data() + column_pos, line).ec != std::errc() ||
+        std::from_chars(location.data() + column_pos + 1, location.data() + location.size(), column).ec != std::errc()) {
+        bug.file = location;
+        return;
+    }
+
+    bug.file = location.substr(0, line_pos);
+    bug.line = line;
+    bug.column = column;
+
+    if (bug.file.starts_with("../")) {
+        bug.file = std::filesystem::weakly_canonical(binary_folder / bug.file).string();
+    }
+}
+
+std::vector<std::tuple<UBSAN_BUG, FR_CRASH>> parse_ubsan_output(std::string_view output, const std::filesystem::path binary_folder) {
+
+    std::vector<std::tuple<UBSAN_BUG, FR_CRASH>> reports;
+
+    // Lines of the report being read, from its "runtime error" or "ERROR:" line
+    std::optional<size_t> report_start;
+    std::string_view location;
+
+    // A report without a SUMMARY line (print_summary=0, truncated output) is bucketed on its own location
+    auto flush = [&](size_t report_end, std::string_view check, std::string_view summary_location) {
+        if (!report_start) {
+            return;
+        }
+
+        UBSAN_BUG bug;
+        bug.check = check;
+
+        parse_ubsan_location(summary_location.empty() ? location : summary_location, binary_folder, bug);
+
+        bug.sign();
+
+        FR_CRASH crash;
+        crash.description = output.substr(*report_start, report_end - *report_start);
+
+        reports.push_back({std::move(bug), std::move(crash)});
+
+        report_start.reset();
+        location = "";
+    };
+
+    size_t pos = 0;
+
+    while (pos < output.size()) {
+
+        size_t end = output.find('\n', pos);
+
+        if (end == std::string_view::npos) {
+            end = output.size();
+        }
+
+        std::string_view line = output.substr(pos, end - pos);
+        size_t line_start = pos;
+        pos = end + 1;
+
+        size_t runtime_error = line.find(": runtime error: ");
+
+        if (runtime_error != std::string_view::npos) {
+            flush(line_start, "undefined-behavior", "");
+            report_start = line_start;
+            location = line.substr(0, runtime_error);
+            continue;
+        }
+
+        // Deadly signals: "==1==ERROR: UndefinedBehaviorSanitizer: SEGV on unknown address ..."
+        if (line.find("ERROR: UndefinedBehaviorSanitizer: ") != std::string_view::npos) {
+            flush(line_start, "undefined-behavior", "");
+            report_start = line_start;
+            continue;
+        }
+
+        // "SUMMARY: UndefinedBehaviorSanitizer: <check> <location> in <function>"
+        const std::string_view summary = "SUMMARY: UndefinedBehaviorSanitizer: ";
+
+        if (line.starts_with(summary) && report_start) {
+
+            std::string_view rest = line.substr(summary.size());
+
+            size_t check_end = std::min(rest.find(' '), rest.size());
+            std::string_view check = rest.substr(0, check_end);
+
+            rest = rest.substr(std::min(check_end + 1, rest.size()));
+            std::string_view summary_location = rest.substr(0, std::min(rest.find(' '), rest.size()));
+
+            flush(std::min(pos, output.size()), check, summary_location);
+        }
+    }
+
+    flush(output.size(), "undefined-behavior", "");
+
+    return reports;
+}
+
+std::optional<std::tuple<FR_BUG, FR_CRASH>> parse_sanitizer_output(std::string output, const std::filesystem::path triage_folder,
+                                                                   const std::filesystem::path binary_folder) {
+
+    FR_BUG bug;
+
+    FR_CRASH crash;
+
     size_t pos = 0;
 
     // Search the output for the sanitizer used
@@ -804,6 +1440,8 @@ std::optional<std::tuple<FR_NOSYM_BUG, FR_CRASH>> parse_sanitizer_output_NOSYM(s
     // stack_trace_num = "    #1";
     //}
 
+    const size_t MAX_STACK_DEPTH = 5;
+
     size_t func_num = 0;
 
     std::string stack_trace_num = "    #" + std::to_string(func_num);
@@ -833,21 +1471,39 @@ std::optional<std::tuple<FR_NOSYM_BUG, FR_CRASH>> parse_sanitizer_output_NOSYM(s
             // break;
             //}
 
-            q = parse_stack_trace_line_NOSYM(curr_line);
+            p = parse_stack_trace_line(curr_line);
 
-            bug.stack_trace[func_num] = q;
+            if (std::get<1>(p).string().starts_with("../")) {
+                // Modify p [1]
+                std::get<1>(p) = binary_folder / std::get<1>(p);
+                // std::cout << "Modified path: " << std::get<1>(p) << std::endl;
 
-            func_num += 1;
-            stack_trace_num = "    #" + std::to_string(func_num);
+                // Normalize path
+                std::get<1>(p) = std::filesystem::weakly_canonical(std::get<1>(p));
+                // std::cout << "Normalized path: " << std::get<1>(p) << std::endl;
+            }
 
-        } while ((pos = output.find(stack_trace_num, pos)) != std::string::npos && func_num < MAX_STACK_DEPTH);
+            if (func_num == 0) {
+                saved_file = std::get<1>(p);
+                saved_line = std::get<2>(p);
+
+            } else {
+                bug.function = " > " + bug.function;
+            }
+
+            bug.function = std::get<0>(p) + bug.function;
+
+            func_num += 1;
+            stack_trace_num = "    #" + std::to_string(func_num);
+
+        } while ((pos = output.find(stack_trace_num, pos)) != std::string::npos && func_num < MAX_STACK_DEPTH);
 
         // bug.function = std::get<0>(p);
 
-        // bug.file = saved_file;
-        // bug.file = std::filesystem::relative(bug.file, triage_folder); // Remove the parent path from the file
+        bug.file = saved_file;
+        bug.file = std::filesystem::relative(bug.file, triage_folder); // Remove the parent path from the file
 
-        // bug.address = saved_address;
+        bug.line = saved_line;
 
     } else {
 
@@ -862,870 +1518,2630 @@ std::optional<std::tuple<FR_NOSYM_BUG, FR_CRASH>> parse_sanitizer_output_NOSYM(s
     return std::make_tuple(bug, crash);
 }
 
-std::optional<std::tuple<FR_BUG, FR_CRASH>> parse_sanitizer_output(std::string output, const std::filesystem::path triage_folder,
-                                                                   const std::filesystem::path binary_folder) {
+// Exit if addr2line is needed but not installed
+void check_addr2line() {
 
-    FR_BUG bug;
+    static const bool installed = run("addr2line --version").find("addr2line") != std::string::npos;
 
-    FR_CRASH crash;
+    if (!installed) {
+        std::cerr << "Error: addr2line is not installed" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
 
-    size_t pos = 0;
+FR_FRAME addr2line(const std::filesystem::path &filepath, uint64_t address) {
 
-    // Search the output for the sanitizer used
+    check_addr2line();
 
-    if ((pos = output.find("ERROR: AddressSanitizer: ")) != std::string::npos) {
-        bug.sanitizer = SANITIZER::ASAN;
-        pos += 25;
-    } else if ((pos = output.find("ERROR: MemorySanitizer: ")) != std::string::npos) {
-        bug.sanitizer = SANITIZER::MSAN;
-        pos += 24;
-    } else if ((pos = output.find("ERROR: UndefinedBehaviorSanitizer: ")) != std::string::npos) {
-        bug.sanitizer = SANITIZER::UBSAN;
-        pos += 35;
-    } else if ((pos = output.find("ERROR: ThreadSanitizer: ")) != std::string::npos) {
-        bug.sanitizer = SANITIZER::TSAN;
-        pos += 24;
-    } else if ((pos = output.find("ERROR: Control Flow Integrity Sanitizer: ")) != std::string::npos) {
-        bug.sanitizer = SANITIZER::CFISAN;
-        pos += 40;
-    } else {
-        return std::nullopt;
+    // Convert address to hex
+    std::string address_str = "0x" + std::format("{:x}", address);
+
+    std::string cmd = "addr2line --exe=" + filepath.string() + " --demangle --functions " + address_str;
+
+    std::string output = run(cmd);
+
+    std::istringstream iss(output);
+
+    std::string l;
+
+    do {
+        std::getline(iss, l);
+    } while (l.find("Dwarf Error") != std::string::npos || l.find("DWARF error") != std::string::npos);
+
+    std::string function = l;
+
+    size_t aux = function.find('(');
+    if (aux != std::string::npos) {
+        function = function.substr(0, aux);
     }
 
-    // String from pos to the end of the file
-    output = output.substr(pos);
-    crash.description = output;
-    pos = 0;
+    std::string file = "";
+    std::string line = "0";
 
-    // Look if the following text from pos is a bug type
+    if (function == "??") {
+        function = filepath.filename().string() + "+" + address_str;
 
-    //(pos = output.find(stack_trace_num, pos)) != std::string::npos
+    } else {
+
+        do {
+            std::getline(iss, l);
+        } while (l.find("Dwarf Error") != std::string::npos || l.find("DWARF error") != std::string::npos);
+
+        // Look for ':' in the file line
+        size_t pos;
+        if ((pos = l.find(':')) != std::string::npos) {
+
+            file = l.substr(0, pos);
+
+            if (file == "??") {
+                file = "";
+                line = "0";
 
-    if (output.starts_with("heap-buffer-overflow")) {
-        if ((pos = output.find("READ of size ")) != std::string::npos) {
-            bug.type = BUG_TYPE::HEAP_BUFFER_OVERFLOW_READ;
-            pos += 13;
-            std::string bytes = output.substr(pos, output.find(" ", pos) - pos);
-            if (is_number(bytes)) {
-                crash.oob_bytes = std::stoll(bytes);
-            } else {
-                std::cout << output << std::endl;
-                return std::nullopt;
-            }
-        } else if ((pos = output.find("WRITE of size ")) != std::string::npos) {
-            bug.type = BUG_TYPE::HEAP_BUFFER_OVERFLOW_WRITE;
-            pos += 14;
-            std::string bytes = output.substr(pos, output.find(" ", pos) - pos);
-            if (is_number(bytes)) {
-                crash.oob_bytes = std::stoll(bytes);
             } else {
-                std::cout << output << std::endl;
-                return std::nullopt;
+
+                size_t pos2;
+                if ((pos2 = l.find(':', pos + 1)) != std::string::npos) {
+                    line = l.substr(pos + 1, pos2 - pos - 1);
+                } else {
+                    line = l.substr(pos + 1);
+                }
+
+                if (line == "?") {
+                    line = "0";
+
+                } else if (!is_number(line)) {
+                    std::cerr << "Error: line is not a number: " << line << std::endl;
+                    exit(EXIT_FAILURE);
+                }
             }
+
         } else {
-            bug.type = BUG_TYPE::HEAP_BUFFER_OVERFLOW;
+            file = l;
         }
-        // pos += 20;
+    }
 
-    } else if (output.starts_with("stack-buffer-overflow")) {
-        if ((pos = output.find("READ of size ")) != std::string::npos) {
-            bug.type = BUG_TYPE::STACK_BUFFER_OVERFLOW_READ;
-            pos += 13;
-            std::string bytes = output.substr(pos, output.find(" ", pos) - pos);
-            if (is_number(bytes)) {
-                crash.oob_bytes = std::stoll(bytes);
-            } else {
-                std::cout << output << std::endl;
-                return std::nullopt;
-            }
+    return {function, file, std::stoul(line)};
+}
 
-        } else if ((pos = output.find("WRITE of size ")) != std::string::npos) {
-            bug.type = BUG_TYPE::STACK_BUFFER_OVERFLOW_WRITE;
-            pos += 14;
-            std::string bytes = output.substr(pos, output.find(" ", pos) - pos);
-            if (is_number(bytes)) {
-                crash.oob_bytes = std::stoll(bytes);
-            } else {
-                std::cout << output << std::endl;
-                return std::nullopt;
-            }
-        } else {
-            bug.type = BUG_TYPE::STACK_BUFFER_OVERFLOW;
+// symbolizer = nullptr if the object has no debug info
+FR_FRAME symbolize_frame(const std::filesystem::path &filepath, uint64_t address, const Symbolizer *symbolizer) {
+
+    if (symbolizer == nullptr) {
+        return addr2line(filepath, address);
+    }
+
+    std::optional<SYMBOL_INFO> info = symbolizer->symbolize(address);
+
+    if (!info.has_value()) {
+        return {filepath.filename().string() + "+0x" + std::format("{:x}", address), "", 0};
+    }
+
+    std::string function = info->function;
+
+    size_t aux = function.find('(');
+    if (aux != std::string::npos) {
+        function = function.substr(0, aux);
+    }
+
+    return {function, info->file.string(), info->line};
+}
+
+// Objects are identified by their build-id, or by path, size and modification time when they don't have one
+std::string symbols_cache_key(const std::filesystem::path &object) {
+
+    std::string build_id = read_build_id(object);
+
+    if (build_id != "") {
+        return build_id;
+    }
+
+    std::error_code ec;
+
+    std::string key = object.string() + ":" + std::to_string(std::filesystem::file_size(object, ec)) + ":" +
+                      std::to_string(std::filesystem::last_write_time(object, ec).time_since_epoch().count());
+
+    return "nobuildid_" + std::to_string(std::hash<std::string>{}(key));
+}
+
+// One line per address: <address>\t<function>\t<file>\t<line>\t<resolver>. The resolver is "dwarf" or "addr2line" (objects without debug
+// info). An unresolved addr2line frame is final, one from an object with debug info isn't cached
+void load_symbols_cache(const std::filesystem::path &cache_file, std::unordered_map<uint64_t, FR_FRAME> &frames) {
+
+    std::ifstream file(cache_file);
+
+    std::string line;
+
+    while (std::getline(file, line)) {
+
+        std::vector<std::string> fields = split(line, '\t');
+
+        if (fields.size() != 5 || fields[0].empty() || fields[0].find_first_not_of("0123456789abcdef") != std::string::npos ||
+            !is_number(fields[3])) {
+            continue;
         }
 
-    } else if (output.starts_with("SEGV")) {
-        if (output.find("caused by a READ") != std::string::npos) {
-            bug.type = BUG_TYPE::SEGV_READ;
-        } else if (output.find("caused by a WRITE") != std::string::npos) {
-            bug.type = BUG_TYPE::SEGV_WRITE;
-        } else {
-            bug.type = BUG_TYPE::SEGV;
+        if ((fields[2].empty() || std::stoul(fields[3]) == 0) && fields[4] != "addr2line") {
+            continue;
         }
-        pos += 4;
 
-    } else if (output.starts_with("attempting free on address which was not malloc")) {
+        frames[std::stoull(fields[0], nullptr, 16)] = {fields[1], fields[2], std::stoul(fields[3])};
+    }
+}
 
-        bug.type = BUG_TYPE::INVALID_FREE;
-        pos += 47;
+void append_symbols_cache(const std::filesystem::path &cache_file, const std::vector<std::pair<uint64_t, FR_FRAME>> &frames, bool addr2line) {
 
-    } else if (output.starts_with("requested allocation size")) {
-        bug.type = BUG_TYPE::ALLOCATION_OVERFLOW;
-        pos += 25;
-    } else if (output.starts_with("FPE")) {
-        bug.type = BUG_TYPE::FPE;
-        pos += 3;
-    } else if (output.starts_with("out of memory")) {
-        bug.type = BUG_TYPE::OOM;
-        pos += 13;
+    std::ofstream file(cache_file, std::ios::app);
+
+    for (auto &[address, frame] : frames) {
+        file << std::hex << address << std::dec << "\t" << frame.function << "\t" << frame.file << "\t" << frame.line << "\t"
+             << (addr2line ? "addr2line" : "dwarf") << "\n";
+    }
+}
+
+FR_BUG symbolize(const FR_NOSYM_BUG &bug, const SYMBOL_TABLE &symbols) {
+
+    FR_BUG sym_bug;
+
+    sym_bug.sanitizer = bug.sanitizer;
+    sym_bug.type = bug.type;
+
+    for (int i = MAX_STACK_DEPTH - 1; i >= 0; i--) {
+
+        const std::filesystem::path &filepath = std::get<0>(bug.stack_trace[i]);
+        uint64_t address = std::get<1>(bug.stack_trace[i]);
+
+        if (filepath.empty() || address == 0) {
+            continue;
+        }
+
+        const FR_FRAME &frame = symbols.at(filepath).at(address);
+
+        sym_bug.function += frame.function;
+
+        if (i == 0) {
+            sym_bug.file = frame.file;
+            sym_bug.line = frame.line;
 
-    } else if (output.starts_with("heap-use-after-free")) {
-        if ((pos = output.find("READ of size ")) != std::string::npos) {
-            bug.type = BUG_TYPE::UAF_READ;
-            pos += 13;
-            std::string bytes = output.substr(pos, output.find(" ", pos) - pos);
-            if (is_number(bytes)) {
-                crash.oob_bytes = std::stoll(bytes);
-            } else {
-                std::cout << output << std::endl;
-                return std::nullopt;
-            }
-        } else if ((pos = output.find("WRITE of size ")) != std::string::npos) {
-            bug.type = BUG_TYPE::UAF_WRITE;
-            pos += 14;
-            std::string bytes = output.substr(pos, output.find(" ", pos) - pos);
-            if (is_number(bytes)) {
-                crash.oob_bytes = std::stoll(bytes);
-            } else {
-                std::cout << output << std::endl;
-                return std::nullopt;
-            }
         } else {
-            bug.type = BUG_TYPE::UAF;
+            sym_bug.function += " > ";
         }
-        // pos += 19;
+    }
 
-    } else if (output.starts_with("global-buffer-overflow")) {
-        bug.type = BUG_TYPE::GLOBAL_BUFFER_OVERFLOW;
-        pos += 22;
+    return sym_bug;
+}
 
-    } else if (output.starts_with("stack-overflow")) {
-        bug.type = BUG_TYPE::STACK_OVERFLOW;
-        pos += 14;
+static data::TypedTable known_bugs_table() {
 
-    } else if (output.starts_with("negative-size-param")) {
-        bug.type = BUG_TYPE::NEGATIVE_SIZE;
-        pos += 19;
+    return data::TypedTable({{"signature", data::RECORD_TYPE::TEXT},
+                             {"sanitizer", data::RECORD_TYPE::TEXT},
+                             {"type", data::RECORD_TYPE::TEXT},
+                             {"function", data::RECORD_TYPE::TEXT},
+                             {"file", data::RECORD_TYPE::TEXT},
+                             {"line", data::RECORD_TYPE::INTEGER},
+                             {"campaign", data::RECORD_TYPE::TEXT},
+                             {"first_seen", data::RECORD_TYPE::TEXT}});
+}
 
-    } else if (output.starts_with("unknown-crash")) {
-        bug.type = BUG_TYPE::UNKNOWN;
-        pos += 13;
+static data::TypedTable known_stacks_table() {
 
-    } else {
-        std::cerr << output << std::endl;
-        std::cerr << "Unknown bug type" << std::endl;
-        exit(1);
+    return data::TypedTable({{"stack", data::RECORD_TYPE::TEXT}, {"signature", data::RECORD_TYPE::TEXT}, {"line", data::RECORD_TYPE::INTEGER}});
+}
+
+bool TRIAGE_KNOWN_BUGS::open(grDB *db, std::string campaign) {
+
+    if (db == nullptr) {
+        return false;
+    }
+
+    this->db = db;
+    this->campaign = campaign;
+
+    time_t now = time(nullptr);
+    char date[11];
+    strftime(date, sizeof(date), "%Y-%m-%d", localtime(&now));
+    this->date = date;
+
+    new_bugs = known_bugs_table();
+    new_stacks = known_stacks_table();
+
+    if (db->table_exists("known_bugs")) {
+
+        data::TypedTable table = db->dump_table("known_bugs", {"signature", "function", "file", "campaign"});
+
+        for (auto &row : table.data()) {
+            bugs[std::get<std::string>(row[0])] = {std::get<std::string>(row[1]), std::get<std::string>(row[2]), std::get<std::string>(row[3])};
+        }
+    }
+
+    if (db->table_exists("known_bug_stacks")) {
+
+        data::TypedTable table = db->dump_table("known_bug_stacks", {"stack", "signature", "line"});
+
+        for (auto &row : table.data()) {
+            stacks[std::get<std::string>(row[0])] = {std::get<std::string>(row[1]), (size_t)std::get<int>(row[2])};
+        }
+    }
+
+    return true;
+}
+
+std::string TRIAGE_KNOWN_BUGS::signature(const FR_BUG &bug) {
+
+    std::string key;
+
+    for (const std::string &field : {sanitizer_name(bug.sanitizer), bug_type_name(bug.type), bug.function, bug.file.string()}) {
+        key += field;
+        key.push_back('\0');
     }
 
-    // Get function
-    // if (bug.type == BUG_TYPE::ALLOCATION_OVERFLOW || bug.type == BUG_TYPE::OOM || bug.type == BUG_TYPE::UNKNOWN) {
+    return std::format("{:016x}{:016x}", xxhash64(key.data(), key.size()), xxhash64(key.data(), key.size(), STACK_SIGNATURE_SEED));
+}
+
+std::string TRIAGE_KNOWN_BUGS::stack_key(const FR_NOSYM_BUG &bug) {
+
+    std::string key;
+
+    key.push_back((char)bug.sanitizer);
+    key.push_back((char)bug.type);
+
+    for (size_t i = 0; i < MAX_STACK_DEPTH; i++) {
+
+        const std::filesystem::path &object = std::get<0>(bug.stack_trace[i]);
+        uint64_t address = std::get<1>(bug.stack_trace[i]);
+
+        if (!object.empty() && !object_keys.contains(object)) {
+            object_keys[object] = symbols_cache_key(object);
+        }
+
+        key += object.empty() ? "" : object_keys[object];
+        key.push_back('\0');
+        key.append((const char *)&address, sizeof(address));
+    }
+
+    return std::format("{:016x}{:016x}", xxhash64(key.data(), key.size()), xxhash64(key.data(), key.size(), STACK_SIGNATURE_SEED));
+}
+
+std::optional<FR_BUG> TRIAGE_KNOWN_BUGS::lookup(const FR_NOSYM_BUG &bug) {
+
+    auto stack = stacks.find(stack_key(bug));
+
+    if (stack == stacks.end() || !bugs.contains(stack->second.signature)) {
+        return std::nullopt;
+    }
+
+    const KNOWN_BUG &known = bugs[stack->second.signature];
+
+    return FR_BUG{bug.sanitizer, bug.type, known.function, known.file, stack->second.line};
+}
+
+std::string TRIAGE_KNOWN_BUGS::learn(const FR_NOSYM_BUG &bug, const FR_BUG &sym_bug) {
+
+    std::string sign = signature(sym_bug);
+    std::string key = stack_key(bug);
+
+    if (!stacks.contains(key)) {
+        stacks[key] = {sign, sym_bug.line};
+        new_stacks.insert({key, sign, (int)sym_bug.line});
+    }
+
+    if (!bugs.contains(sign)) {
+
+        bugs[sign] = {sym_bug.function, sym_bug.file, campaign};
+        new_bugs.insert({sign, sanitizer_name(sym_bug.sanitizer), bug_type_name(sym_bug.type), sym_bug.function, sym_bug.file.string(),
+                         (int)sym_bug.line, campaign, date});
+        return "";
+    }
+
+    return bugs[sign].campaign == campaign ? "" : bugs[sign].campaign;
+}
+
+void TRIAGE_KNOWN_BUGS::save() {
+
+    if (db == nullptr) {
+        return;
+    }
+
+    // Another campaign may have recorded the same bug meanwhile, the first one stays
+    if (!new_bugs.empty()) {
+        db->insert("known_bugs", new_bugs, "signature", true);
+    }
+
+    if (!new_stacks.empty()) {
+        db->insert("known_bug_stacks", new_stacks, "stack", true);
+    }
+
+    new_bugs = known_bugs_table();
+    new_stacks = known_stacks_table();
+}
+
+void symbolize_results(TRIAGE_RESULT &results, std::filesystem::path triage_folder, std::filesystem::path cache_folder, size_t num_threads,
+                       TRIAGE_KNOWN_BUGS *known) {
+
+    auto &bugs = results.triage_asan_result->bugs;
+    auto &sym_bugs = results.triage_asan_result->sym_bugs;
+
+    // Symbolize the crashes
+    std::cout << std::endl;
+    std::cout << "Symbolizing the results..." << std::endl;
+
+    // Stacks symbolized by an earlier triage of the same build
+    std::unordered_map<FR_NOSYM_BUG, FR_BUG> known_stacks;
+
+    // Different bugs mostly share the same frames: collect the unique (object, address) pairs first
+    SYMBOL_TABLE symbols;
+
+    for (auto &bug : bugs) {
+
+        if (known != nullptr) {
+
+            std::optional<FR_BUG> sym_bug = known->lookup(bug.first);
+
+            if (sym_bug.has_value()) {
+                known_stacks[bug.first] = *sym_bug;
+                continue;
+            }
+        }
+
+        for (size_t i = 0; i < MAX_STACK_DEPTH; i++) {
+
+            const std::filesystem::path &filepath = std::get<0>(bug.first.stack_trace[i]);
+            uint64_t address = std::get<1>(bug.first.stack_trace[i]);
+
+            if (!filepath.empty() && address != 0) {
+                symbols[filepath][address];
+            }
+        }
+    }
+
+    std::vector<std::filesystem::path> objects;
+    std::vector<std::filesystem::path> cache_files;
+
+    // Frames not found in the cache: object index, address, frame to fill in
+    std::vector<std::tuple<size_t, uint64_t, FR_FRAME *>> pending;
+
+    size_t total_frames = 0;
+
+    if (!std::filesystem::exists(cache_folder)) {
+        std::filesystem::create_directories(cache_folder);
+    }
+
+    for (auto &[object, frames] : symbols) {
+
+        objects.push_back(object);
+        cache_files.push_back(cache_folder / (symbols_cache_key(object) + ".sym"));
+
+        std::unordered_map<uint64_t, FR_FRAME> cached;
+        load_symbols_cache(cache_files.back(), cached);
+
+        for (auto &[address, frame] : frames) {
+
+            if (cached.contains(address)) {
+                frame = cached[address];
+            } else {
+                pending.push_back({objects.size() - 1, address, &frame});
+            }
+
+            total_frames++;
+        }
+    }
+
+    if (known != nullptr) {
+        std::cout << "- Known stacks: " << known_stacks.size() << " / " << bugs.size() << ", not symbolized" << std::endl;
+    }
+
+    std::cout << "- Unique frames: " << total_frames << " (" << total_frames - pending.size() << " cached)" << std::endl;
+
+    if (num_threads == 0) {
+        num_threads = 1;
+    }
+
+    auto run_workers = [num_threads](const std::function<void()> &worker) {
+        std::vector<std::thread> threads;
+
+        for (size_t i = 0; i < num_threads; i++) {
+            threads.push_back(std::thread(worker));
+        }
+
+        for (auto &th : threads) {
+            th.join();
+        }
+    };
+
+    if (!pending.empty()) {
+
+        // Only the objects with pending frames are loaded
+        std::vector<Symbolizer *> symbolizers(objects.size(), nullptr);
+        std::vector<size_t> to_open;
+
+        for (auto &p : pending) {
+            if (to_open.empty() || to_open.back() != std::get<0>(p)) {
+                to_open.push_back(std::get<0>(p));
+            }
+        }
+
+        std::atomic<size_t> next = 0;
+
+        run_workers([&]() {
+            for (size_t i = next++; i < to_open.size(); i = next++) {
+
+                Symbolizer *symbolizer = new Symbolizer();
+
+                if (!symbolizer->open(objects[to_open[i]])) {
+                    // No debug info: this object is resolved with addr2line
+                    delete symbolizer;
+                    symbolizer = nullptr;
+                }
+
+                symbolizers[to_open[i]] = symbolizer;
+            }
+        });
+
+        next = 0;
+
+        run_workers([&]() {
+            for (size_t i = next++; i < pending.size(); i = next++) {
+
+                auto &[object, address, frame] = pending[i];
+
+                *frame = symbolize_frame(objects[object], address, symbolizers[object]);
+            }
+        });
+
+        // Persist the new frames, grouped by object. All of those of objects without debug info, so that addr2line isn't forked again for
+        // them. Only the resolved ones otherwise: an "obj+0x..." fallback is tried again by the next triage
+        std::vector<std::vector<std::pair<uint64_t, FR_FRAME>>> new_frames(objects.size());
+
+        for (auto &[object, address, frame] : pending) {
+            if (symbolizers[object] == nullptr || (!frame->file.empty() && frame->line != 0)) {
+                new_frames[object].push_back({address, *frame});
+            }
+        }
+
+        for (size_t i = 0; i < objects.size(); i++) {
+
+            if (!new_frames[i].empty()) {
+                append_symbols_cache(cache_files[i], new_frames[i], symbolizers[i] == nullptr);
+            }
+
+            delete symbolizers[i];
+        }
+    }
+
+    auto &known_bugs = results.triage_asan_result->known;
+
+    for (auto &bug : bugs) {
+
+        FR_BUG sym_bug;
+
+        if (known_stacks.contains(bug.first)) {
+            sym_bug = known_stacks[bug.first];
+
+        } else {
+            sym_bug = symbolize(bug.first, symbols);
+            sym_bug.file = std::filesystem::relative(sym_bug.file, triage_folder); // Remove the parent path from the file
+        }
+
+        std::string first_seen = known != nullptr ? known->learn(bug.first, sym_bug) : "";
+
+        if (!first_seen.empty()) {
+            known_bugs[sym_bug].insert(known_bugs[sym_bug].end(), bug.second.begin(), bug.second.end());
+            results.triage_asan_result->first_seen[sym_bug] = first_seen;
+
+        } else if (sym_bugs.count(sym_bug) > 0) {
+            sym_bugs[sym_bug].insert(sym_bugs[sym_bug].end(), bug.second.begin(), bug.second.end());
+
+        } else {
+            sym_bugs.insert({sym_bug, {bug.second}});
+        }
+    }
+
+    if (known != nullptr) {
+        known->save();
+    }
+}
+
+// Through the worker's forkserver when it is running, in a new process otherwise
+std::string replay(const std::string &cmd, const std::filesystem::path &crash_path, forkserver *fsrv, size_t timeout_ms, bool *timed_out = nullptr) {
+
+    if (fsrv != nullptr && fsrv->is_running()) {
+
+        std::string output = fsrv->run(crash_path, timeout_ms, timed_out);
+
+        if (fsrv->is_running()) {
+            return output;
+        }
+    }
+
+    return run(cmd, timeout_ms, timed_out);
+}
+
+// One attempt. Returns false when the crash did not reproduce and attempts remain, nothing is recorded then. A run killed before
+// TRIAGE_MAX_TIMEOUT_MS sets timed_out and returns false even on the last attempt: it may just need more time
+bool triage_asan(std::string cmd, std::filesystem::path crash_path, std::filesystem::path triage_folder, const std::filesystem::path binary_folder,
+                 TRIAGE_RESULT &triage_results, size_t attempt, size_t repeat, size_t timeout_ms, forkserver *fsrv, size_t top_frames,
+                 bool &timed_out) {
+
+    if (triage_results.triage_asan_result == nullptr) {
+        triage_results.triage_asan_result = new TRIAGE_ASAN_RESULT();
+    }
+
+    TRIAGE_ASAN_RESULT *results = triage_results.triage_asan_result;
+
+    std::string output = replay(cmd, crash_path, fsrv, timeout_ms, &timed_out);
+
+    std::optional<std::tuple<FR_NOSYM_BUG, FR_CRASH>> result = parse_sanitizer_output_NOSYM(output, triage_folder, binary_folder, top_frames);
+
+    if (result.has_value()) {
+
+        // Bug found
+
+        FR_NOSYM_BUG bug = std::get<0>(result.value());
+        FR_CRASH fr_crash = std::get<1>(result.value());
+        fr_crash.crash_path = crash_path;
+        fr_crash.attempts = attempt + 1;
+        fr_crash.flakiness = (double)attempt / (attempt + 1);
+
+        results->bugs[bug].push_back(fr_crash);
+
+        return true;
+    }
+
+    // No bug found by parse_sanitizer_output, check if output is an aborted
+    if (output.find("Aborted") != std::string::npos) {
+
+        FR_CRASH abort;
+
+        abort.crash_path = crash_path;
+        abort.description = output;
+        abort.attempts = attempt + 1;
+        abort.flakiness = (double)attempt / (attempt + 1);
+
+        results->aborted.push_back(abort);
+
+        return true;
+    }
+
+    if (timed_out && timeout_ms < TRIAGE_MAX_TIMEOUT_MS) {
+        return false;
+    }
+
+    timed_out = false;
+
+    if (attempt + 1 < repeat) {
+        return false;
+    }
+
+    FR_CRASH u;
+    u.crash_path = crash_path;
+    u.description = output;
+    u.attempts = attempt + 1;
+    u.flakiness = 1.0;
+
+    results->unknown.push_back(u);
+
+    return true;
+}
+
+// One attempt. Returns false when no runtime error was reported and attempts remain, nothing is recorded then. Timeouts as in triage_asan
+bool triage_ubsan(std::string cmd, std::filesystem::path crash_path, std::filesystem::path triage_folder, const std::filesystem::path binary_folder,
+                  TRIAGE_RESULT &triage_results, size_t attempt, size_t repeat, size_t timeout_ms, forkserver *fsrv, bool &timed_out) {
+
+    if (triage_results.triage_ubsan_result == nullptr) {
+        triage_results.triage_ubsan_result = new TRIAGE_UBSAN_RESULT();
+    }
+
+    TRIAGE_UBSAN_RESULT *results = triage_results.triage_ubsan_result;
+
+    std::string output = replay(cmd, crash_path, fsrv, timeout_ms, &timed_out);
+
+    std::vector<std::tuple<UBSAN_BUG, FR_CRASH>> reports = parse_ubsan_output(output, binary_folder);
+
+    if (!reports.empty()) {
+
+        for (auto &[bug, crash] : reports) {
+
+            std::vector<FR_CRASH> &bucket = results->bugs[bug];
+
+            // The runtime reports each location once, but a check can fire at the same place from different call sites
+            if (!bucket.empty() && bucket.back().crash_path == crash_path) {
+                continue;
+            }
+
+            crash.crash_path = crash_path;
+            crash.attempts = attempt + 1;
+            crash.flakiness = (double)attempt / (attempt + 1);
+
+            bucket.push_back(std::move(crash));
+        }
+
+        return true;
+    }
+
+    if (timed_out && timeout_ms < TRIAGE_MAX_TIMEOUT_MS) {
+        return false;
+    }
+
+    timed_out = false;
+
+    if (attempt + 1 < repeat) {
+        return false;
+    }
+
+    FR_CRASH u;
+    u.crash_path = crash_path;
+    u.description = output;
+    u.attempts = attempt + 1;
+    u.flakiness = 1.0;
+
+    results->unknown.push_back(u);
+
+    return true;
+}
+
+std::tuple<std::string, std::string, std::string, size_t> parse_gdb_line(std::string line) {
+
+    std::string function = "";
+    std::string argument = "";
+    std::string filename = "";
+    size_t linenumber = 0;
+
+    size_t pos;
+
+    if ((pos = line.find(" ")) != std::string::npos) {
+
+        function = line.substr(0, pos);
+
+        line = line.substr(pos + 1);
+
+        pos = 0;
+
+        if (function.starts_with("0x") && line.starts_with("in ")) {
+
+            pos += 3;
+
+            // Find next whitespace
+            if ((pos = line.find(" ", pos)) != std::string::npos) {
+
+                function = line.substr(3, pos - 3);
+
+                line = line.substr(pos + 1);
+            }
+
+            // std::cout << line << std::endl;
+        }
+
+        // std::cout << "Function: " << function << std::endl;
+
+        if ((pos = line.find(" at ")) != std::string::npos || (pos = line.find(" from ")) != std::string::npos) {
+
+            if (pos > 0) {
+                argument = line.substr(0, pos);
+                // std::cout << "Argument: " << argument << std::endl;
+            }
+
+            filename = line.substr(pos + 4);
+
+            // Get now the line number
+
+            if ((pos = filename.find(":")) != std::string::npos) {
+
+                std::string line_number = filename.substr(pos + 1);
+
+                filename = filename.substr(0, pos);
+
+                linenumber = std::stoi(line_number);
+
+                // std::cout << "File: " << filename << std::endl;
+
+                // std::cout << "Line: " << linenumber << std::endl;
+            }
+        }
+    }
+
+    return std::make_tuple(function, argument, filename, linenumber);
+}
+
+// Buckets the crash if output has a SIGSEGV or SIGABRT report from gdb. Returns true if it did
+bool parse_gdb_output(std::string output, const std::filesystem::path &crash_path, const std::filesystem::path binary_folder,
+                      TRIAGE_GDB_RESULT *results) {
+
+    static const pattern_matcher matcher(std::vector<std::string_view>(std::begin(GDB_SIGNALS), std::end(GDB_SIGNALS)));
+
+    std::vector<PATTERN_MATCH> signals = matcher.find_all(output);
+
+    if (!signals.empty()) {
+
+        output = output.substr(signals.front().offset);
+
+        std::stringstream ss(output);
+
+        // Get the first line
+        std::string line;
+
+        if (std::getline(ss, line)) {
+
+            // std::cout << line << std::endl;
+
+            if (std::getline(ss, line)) {
+
+                // std::cout << line << std::endl;
+
+                while (line.starts_with("[Switching to Thread")) {
+
+                    // std::cout << "Skipping line..." << std::endl;
+
+                    if (!std::getline(ss, line)) {
+                        break;
+                    }
+                }
+
+                // std::cout << line << std::endl;
+
+                // Parse the line to get function name, file and line
+
+                auto tuple = parse_gdb_line(line);
+
+                GDB_BUG bug;
+                bug.gdb_func = std::get<0>(tuple);
+                bug.gdb_arg = std::get<1>(tuple);
+                bug.gdb_file = std::get<2>(tuple);
+
+                if (bug.gdb_file.starts_with("../")) {
+
+                    bug.gdb_file = binary_folder / bug.gdb_file;
+                    bug.gdb_file = std::filesystem::weakly_canonical(bug.gdb_file);
+                }
+
+                bug.gdb_line = std::get<3>(tuple);
+
+                bug.sign();
+
+                if (bug.gdb_func == "" || bug.gdb_file == "") {
+                    std::cerr << "Error: Failed to parse gdb output" << std::endl;
+                    std::cout << output << std::endl;
+                    // exit(EXIT_FAILURE);
+                }
+
+                FR_CRASH crash;
+                crash.crash_path = crash_path;
+                crash.description = output;
+
+                // Check if the bug is already in the list
+                if (results->bugs.count(bug) > 0) {
+
+                    results->bugs[bug].push_back(crash);
+
+                } else {
+
+                    results->bugs.insert({bug, {crash}});
+                }
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+std::string gdb_command(const std::string &cmd) {
+
+    std::string command = "gdb";
+
+    command += " --batch"; // Batch mode
+
+    command += " -ex 'run'";
+
+    command += " -ex 'quit'"; // Continue the execution
+
+    command += " --args " + cmd; // Load the binary"
+
+    return command;
+}
+
+// Buckets a crash caught by crash_catcher on the first frame with line information, the crashing code of the target rather than the
+// abort()/raise() frames in libc where gdb stops. Targets without debug information are bucketed on module+offset
+bool bucket_gdb_crash(const CRASH_INFO &info, const std::filesystem::path &crash_path, const std::filesystem::path binary_folder,
+                      TRIAGE_GDB_RESULT *results) {
+
+    if (!info.crashed || info.frames.empty()) {
+        return false;
+    }
+
+    const CRASH_FRAME *top = &info.frames.front();
+
+    for (const CRASH_FRAME &frame : info.frames) {
+
+        if (!frame.file.empty()) {
+            top = &frame;
+            break;
+        }
+    }
+
+    GDB_BUG bug;
+    bug.gdb_func = top->function;
+    bug.gdb_arg = "";
+    bug.gdb_file = top->file.string();
+    bug.gdb_line = top->line;
+
+    if (top->file.empty()) {
+        bug.gdb_func = top->module.filename().string() + "+0x" + std::format("{:x}", top->offset);
+        bug.gdb_file = top->module.string();
+    }
+
+    if (bug.gdb_file.starts_with("../")) {
+
+        bug.gdb_file = binary_folder / bug.gdb_file;
+        bug.gdb_file = std::filesystem::weakly_canonical(bug.gdb_file);
+    }
+
+    bug.sign();
+
+    FR_CRASH crash;
+    crash.crash_path = crash_path;
+    crash.description = info.output + crash_report(info);
+
+    results->bugs[bug].push_back(crash);
+
+    return true;
+}
+
+// One run of cmd under the crash catcher, or under gdb if the target can't be traced (seccomp, yama). Returns the output of the target,
+// bucketed is true if it crashed, timed_out if it was killed after timeout_ms
+static std::string catch_crash(const std::string &cmd, const std::filesystem::path &crash_path, const std::filesystem::path binary_folder,
+                               TRIAGE_GDB_RESULT *results, crash_catcher &catcher, size_t timeout_ms, bool &bucketed, bool &timed_out) {
+
+    std::optional<std::vector<std::string>> argv = split_command(cmd);
+
+    // Forks are traced too, the shell's child is caught the same way
+    if (!argv.has_value()) {
+        argv = {"/bin/sh", "-c", cmd};
+    }
+
+    CRASH_INFO info = catcher.run(argv.value(), timeout_ms);
+
+    if (info.started) {
+        bucketed = bucket_gdb_crash(info, crash_path, binary_folder, results);
+        timed_out = info.timed_out;
+        return info.output;
+    }
+
+    std::string output = run(gdb_command(cmd), timeout_ms, &timed_out);
+
+    bucketed = parse_gdb_output(output, crash_path, binary_folder, results);
+
+    return output;
+}
+
+// Attempts and flakiness of the crashes just bucketed, the only ones of a single crash's result
+static void set_attempts(std::vector<FR_CRASH> &crashes, size_t attempt) {
+
+    for (FR_CRASH &crash : crashes) {
+        crash.attempts = attempt + 1;
+        crash.flakiness = (double)attempt / (attempt + 1);
+    }
+}
+
+// One attempt. Returns false when the crash did not reproduce and attempts remain. Timeouts as in triage_asan
+bool triage_gdb(std::string cmd, std::filesystem::path crash_path, const std::filesystem::path triage_folder,
+                const std::filesystem::path binary_folder, TRIAGE_RESULT &triage_results, size_t attempt, size_t repeat, size_t timeout_ms,
+                crash_catcher *catcher, bool &timed_out) {
+
+    if (triage_results.triage_gdb_result == nullptr) {
+        triage_results.triage_gdb_result = new TRIAGE_GDB_RESULT();
+    }
+
+    bool bucketed = false;
+
+    catch_crash(cmd, crash_path, binary_folder, triage_results.triage_gdb_result, *catcher, timeout_ms, bucketed, timed_out);
+
+    if (bucketed) {
+
+        for (auto &[bug, crashes] : triage_results.triage_gdb_result->bugs) {
+            set_attempts(crashes, attempt);
+        }
+
+        return true;
+    }
+
+    if (timed_out && timeout_ms < TRIAGE_MAX_TIMEOUT_MS) {
+        return false;
+    }
+
+    timed_out = false;
+
+    return attempt + 1 >= repeat;
+}
+
+// Buckets the crash if output has a glibc heap consistency error. Returns true if it did
+bool parse_malloc_output(const std::string &output, const std::filesystem::path &crash_path, TRIAGE_MALLOC_RESULT *results) {
+
+    static const pattern_matcher matcher(std::vector<std::string_view>(std::begin(MALLOC_MESSAGES), std::end(MALLOC_MESSAGES)));
+
+    std::vector<PATTERN_MATCH> matches = matcher.find_all(output);
+
+    if (matches.empty()) {
+        return false;
+    }
+
+    FR_CRASH crash;
+
+    crash.crash_path = crash_path;
+    crash.description = output;
+    crash.malloc_msg = MALLOC_MESSAGES[matches.front().id];
+
+    results->detected.push_back(crash);
+
+    return true;
+}
+
+// One attempt. Returns false when no heap error was reported and attempts remain. Timeouts as in triage_asan
+bool triage_malloc(std::string cmd, std::filesystem::path crash_path, const std::filesystem::path triage_folder,
+                   const std::filesystem::path binary_folder, TRIAGE_RESULT &triage_results, size_t attempt, size_t repeat, size_t timeout_ms,
+                   forkserver *fsrv, bool &timed_out) {
+
+    if (triage_results.triage_malloc_result == nullptr) {
+        triage_results.triage_malloc_result = new TRIAGE_MALLOC_RESULT();
+    }
+
+    std::string output = replay(cmd, crash_path, fsrv, timeout_ms, &timed_out);
+
+    if (parse_malloc_output(output, crash_path, triage_results.triage_malloc_result)) {
+        set_attempts(triage_results.triage_malloc_result->detected, attempt);
+        return true;
+    }
+
+    if (timed_out && timeout_ms < TRIAGE_MAX_TIMEOUT_MS) {
+        return false;
+    }
+
+    timed_out = false;
+
+    return attempt + 1 >= repeat;
+}
+
+// GDB and MALLOC from the same run: glibc's heap errors are part of the output the crash catcher captures. One attempt, done as soon as
+// either of them reproduces. Timeouts as in triage_asan
+bool triage_cov(std::string cmd, std::filesystem::path crash_path, const std::filesystem::path triage_folder,
+                const std::filesystem::path binary_folder, TRIAGE_RESULT &triage_results, size_t attempt, size_t repeat, size_t timeout_ms,
+                crash_catcher *catcher, bool &timed_out) {
+
+    if (triage_results.triage_gdb_result == nullptr) {
+        triage_results.triage_gdb_result = new TRIAGE_GDB_RESULT();
+    }
+
+    if (triage_results.triage_malloc_result == nullptr) {
+        triage_results.triage_malloc_result = new TRIAGE_MALLOC_RESULT();
+    }
+
+    bool bucketed = false;
+
+    std::string output = catch_crash(cmd, crash_path, binary_folder, triage_results.triage_gdb_result, *catcher, timeout_ms, bucketed, timed_out);
+
+    bool malloc_found = parse_malloc_output(output, crash_path, triage_results.triage_malloc_result);
+
+    if (bucketed || malloc_found) {
+
+        for (auto &[bug, crashes] : triage_results.triage_gdb_result->bugs) {
+            set_attempts(crashes, attempt);
+        }
+
+        set_attempts(triage_results.triage_malloc_result->detected, attempt);
+
+        return true;
+    }
+
+    if (timed_out && timeout_ms < TRIAGE_MAX_TIMEOUT_MS) {
+        return false;
+    }
+
+    timed_out = false;
+
+    return attempt + 1 >= repeat;
+}
+
+// "#3  0x000055d0c1a2b3c4 in func () at file.c:12", or "from module (+0x1234)" without line information
+static std::string hang_frame_line(size_t index, const CRASH_FRAME &frame) {
+
+    std::string line = std::format("#{:<3}0x{:016x} in {} ()", index, frame.pc, frame.function.empty() ? "??" : frame.function);
+
+    if (!frame.file.empty()) {
+        line += " at " + frame.file.string() + ":" + std::to_string(frame.line);
+    } else if (!frame.module.empty()) {
+        line += " from " + frame.module.string() + std::format(" (+0x{:x})", frame.offset);
+    }
+
+    return line + "\n";
+}
+
+// Buckets a hang profiled by crash_catcher on its hot loop: the innermost function of the target's own code (the objects in binary_folder)
+// that is in HANG_LOOP_SHARE of the samples, else the one in most of them. Only the frames of the samples are symbolized, once each
+std::optional<std::tuple<HANG_BUG, FR_CRASH>> bucket_hang(const CRASH_INFO &info, const std::filesystem::path binary_folder, crash_catcher &catcher) {
+
+    size_t num_samples = info.samples.size();
+
+    if (!info.timed_out || num_samples < HANG_MIN_SAMPLES) {
+        return std::nullopt;
+    }
+
+    // <module, offset, innermost> -> symbolized frame
+    std::map<std::tuple<std::filesystem::path, uint64_t, bool>, CRASH_FRAME> symbols;
+
+    // Function of each frame of each sample: module and name, or address without symbols
+    std::vector<std::vector<std::pair<const CRASH_FRAME *, std::string>>> functions(num_samples);
+
+    std::string root = binary_folder.string() + "/";
+
+    for (size_t s = 0; s < num_samples; s++) {
+
+        const std::vector<CRASH_FRAME> &sample = info.samples[s];
+
+        for (size_t i = 0; i < sample.size(); i++) {
+
+            auto [it, inserted] = symbols.try_emplace({sample[i].module, sample[i].offset, i == 0}, sample[i]);
+
+            if (inserted) {
+                catcher.symbolize(it->second, i == 0);
+            }
+
+            const CRASH_FRAME &frame = it->second;
+
+            functions[s].push_back(
+                {&frame, frame.module.string() + '\0' + (frame.function.empty() ? std::format("{:x}", frame.offset) : frame.function)});
+        }
+    }
+
+    std::string loop = "";
+    size_t loop_samples = 0;
+
+    // The target's own code first, a loop inside a library is a loop of its caller. Libraries only if the target has no frame at all
+    for (bool own_only : {true, false}) {
+
+        auto counted = [&](const CRASH_FRAME *frame) { return !own_only || frame->module.string().starts_with(root); };
+
+        // Samples each function is in, once per sample
+        std::map<std::string, size_t> inclusive;
+
+        for (auto &sample : functions) {
+
+            std::set<std::string_view> seen;
+
+            for (auto &[frame, function] : sample) {
+                if (counted(frame) && seen.insert(function).second) {
+                    inclusive[function]++;
+                }
+            }
+        }
+
+        if (inclusive.empty()) {
+            continue;
+        }
+
+        // The innermost function of each sample that is in enough of them. The most common one holds the loop
+        std::map<std::string, size_t> innermost;
+
+        for (auto &sample : functions) {
+
+            for (auto &[frame, function] : sample) {
+
+                if (counted(frame) && inclusive[function] >= HANG_LOOP_SHARE * num_samples) {
+                    innermost[function]++;
+                    break;
+                }
+            }
+        }
+
+        auto &candidates = innermost.empty() ? inclusive : innermost;
+
+        loop = std::max_element(candidates.begin(), candidates.end(), [](auto &a, auto &b) { return a.second < b.second; })->first;
+        loop_samples = inclusive[loop];
+        break;
+    }
+
+    if (loop_samples == 0) {
+        return std::nullopt;
+    }
+
+    // Where in the loop function the samples are: file and line, or address without line information
+    std::map<std::pair<std::filesystem::path, uint64_t>, std::pair<size_t, const CRASH_FRAME *>> lines;
+
+    // Flat profile, innermost frames only
+    std::map<std::pair<std::filesystem::path, uint64_t>, std::pair<size_t, size_t>> addresses; // -> samples, first sample
+
+    for (size_t s = 0; s < num_samples; s++) {
+
+        if (functions[s].empty()) {
+            continue;
+        }
+
+        const CRASH_FRAME *top = functions[s].front().first;
+
+        auto [address, inserted] = addresses.try_emplace({top->module, top->offset}, 0, s);
+        address->second.first++;
+
+        for (auto &[frame, function] : functions[s]) {
+
+            if (function == loop) {
+                auto &line = lines[frame->file.empty() ? std::make_pair(frame->module, frame->offset) : std::make_pair(frame->file, frame->line)];
+                line.first++;
+                line.second = frame;
+                break;
+            }
+        }
+    }
+
+    const CRASH_FRAME *hottest = std::max_element(lines.begin(), lines.end(), [](auto &a, auto &b) { return a.second.first < b.second.first; })
+                                     ->second.second;
+
+    HANG_BUG bug;
+    bug.module = hottest->module.string();
+    bug.function = hottest->function;
+    bug.file = hottest->file.string();
+    bug.line = hottest->line;
+
+    if (bug.function.empty()) {
+        bug.function = hottest->module.filename().string() + "+0x" + std::format("{:x}", hottest->offset);
+    }
+
+    if (bug.file.starts_with("../")) {
+
+        bug.file = binary_folder / bug.file;
+        bug.file = std::filesystem::weakly_canonical(bug.file);
+    }
+
+    bug.sign();
+
+    std::string report = std::format("Hang: hot loop in {}", bug.function);
+
+    if (!bug.file.empty()) {
+        report += " at " + bug.file + ":" + std::to_string(bug.line);
+    }
+
+    report += std::format(" ({:.1f}% of {} samples)\n\nHottest addresses:\n", 100.0 * loop_samples / num_samples, num_samples);
+
+    std::vector<std::pair<size_t, size_t>> flat; // samples, first sample
+
+    for (auto &[address, count] : addresses) {
+        flat.push_back(count);
+    }
+
+    std::sort(flat.begin(), flat.end(), [](auto &a, auto &b) { return a.first > b.first; });
+
+    for (size_t i = 0; i < std::min(flat.size(), HANG_TOP_ADDRESSES); i++) {
+        report += std::format("{:5.1f}%  ", 100.0 * flat[i].first / num_samples) + hang_frame_line(i, *functions[flat[i].second].front().first);
+    }
+
+    report += "\nStack of a sample at the hottest address:\n";
+
+    if (!flat.empty()) {
+
+        auto &sample = functions[flat.front().second];
+
+        for (size_t i = 0; i < sample.size(); i++) {
+            report += hang_frame_line(i, *sample[i].first);
+        }
+    }
+
+    FR_CRASH crash;
+    crash.description = info.output + report;
+
+    return std::make_tuple(bug, crash);
+}
+
+// One run of cmd under the crash catcher for timeout_ms, profiled. An input that finishes first did not hang: it's retried, with a longer
+// timeout, until it has run repeat times
+bool triage_hang(std::string cmd, std::filesystem::path crash_path, const std::filesystem::path binary_folder, TRIAGE_RESULT &triage_results,
+                 size_t attempt, size_t repeat, size_t timeout_ms, crash_catcher *catcher) {
+
+    if (triage_results.triage_hang_result == nullptr) {
+        triage_results.triage_hang_result = new TRIAGE_HANG_RESULT();
+    }
+
+    std::optional<std::vector<std::string>> argv = split_command(cmd);
+
+    if (!argv.has_value()) {
+        argv = {"/bin/sh", "-c", cmd};
+    }
+
+    size_t interval_us = std::max(HANG_SAMPLE_INTERVAL_US, timeout_ms * 1000 / HANG_MAX_SAMPLES);
+
+    // A spinning target may print as fast as it loops
+    CRASH_INFO info = catcher->run(argv.value(), timeout_ms, 1024 * 1024, interval_us);
+
+    auto hang = bucket_hang(info, binary_folder, *catcher);
+
+    if (hang.has_value()) {
+
+        auto &[bug, crash] = hang.value();
+
+        crash.crash_path = crash_path;
+        crash.attempts = attempt + 1;
+        crash.flakiness = (double)attempt / (attempt + 1);
+
+        triage_results.triage_hang_result->bugs[bug].push_back(std::move(crash));
+
+        return true;
+    }
+
+    if (attempt + 1 < repeat) {
+        return false;
+    }
+
+    FR_CRASH u;
+    u.crash_path = crash_path;
+    u.description = info.output;
+    u.attempts = attempt + 1;
+    u.flakiness = 1.0;
+
+    if (!info.started) {
+        u.description += "Could not trace the target\n";
+    }
+
+    triage_results.triage_hang_result->unknown.push_back(u);
+
+    return true;
+}
+
+// Retries first, so flaky crashes don't pile up. Blocks while other workers may still queue a retry
+static bool next_triage_task(TRIAGE_QUEUE &queue, TRIAGE_TASK &task) {
+
+    std::unique_lock<std::mutex> lock(queue.mutex);
+
+    while (true) {
+
+        if (!queue.retries.empty()) {
+            task = queue.retries.front();
+            queue.retries.pop_front();
+            return true;
+        }
+
+        if (queue.next < queue.crashes.size()) {
+            task = {queue.next++, 0, queue.timeout_ms};
+            queue.pending++;
+            return true;
+        }
+
+        if (queue.pending == 0) {
+            return false;
+        }
+
+        queue.cv.wait(lock);
+    }
+}
+
+// A crash that did not reproduce is queued again, with twice the timeout in case it was too slow. A run that timed out is queued as the
+// same attempt: being slow doesn't make a crash flaky
+static void finish_triage_task(TRIAGE_QUEUE &queue, const TRIAGE_TASK &task, bool done, bool timed_out) {
+
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (done) {
+
+        queue.pending--;
+
+        if (queue.pending == 0) {
+            queue.cv.notify_all();
+        }
+
+    } else {
+        queue.retries.push_back({task.index, timed_out ? task.attempt : task.attempt + 1, std::min(task.timeout_ms * 2, TRIAGE_MAX_TIMEOUT_MS)});
+        queue.cv.notify_one();
+    }
+}
+
+void triage_thread(TRIAGE_QUEUE &queue, std::string cmd_split1, std::string cmd_split2, const std::filesystem::path triage_folder,
+                   const std::filesystem::path binary_folder, TRIAGE_SHARED_RESULT &results, size_t repeat, std::string parser_str,
+                   TRIAGE_WORKER_STATS &stats, std::filesystem::path forkserver_shim, TRIAGE_JOURNAL &journal, size_t top_frames) {
+
+    enum PARSER { ASAN, UBSAN, GDB, MALLOC, COV, HANG } parser;
+
+    if (parser_str == "ASAN") {
+        parser = PARSER::ASAN;
+    } else if (parser_str == "UBSAN") {
+        parser = PARSER::UBSAN;
+    } else if (parser_str == "GDB") {
+        parser = PARSER::GDB;
+    } else if (parser_str == "MALLOC") {
+        parser = PARSER::MALLOC;
+    } else if (parser_str == "COV") {
+        parser = PARSER::COV;
+    } else if (parser_str == "HANG") {
+        parser = PARSER::HANG;
+    } else {
+        std::cerr << "Error: Unknown parser" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    forkserver fsrv;
+
+    if (!forkserver_shim.empty() && !fsrv.start(cmd_split1 + " @@" + cmd_split2, forkserver_shim)) {
+        std::cerr << "Warning: could not start the forkserver, running a new process per crash" << std::endl;
+    }
+
+    // GDB, COV and HANG. Keeps the parsed modules of the target between crashes
+    crash_catcher catcher;
+
+    TRIAGE_TASK task;
+
+    while (next_triage_task(queue, task)) {
+
+        size_t i = task.index;
+
+        if (task.attempt == 0 && i % 10 == 0) {
+            std::cout << "Current run: " << i + 1 << " / " << queue.crashes.size() << std::endl;
+        }
+
+        const std::filesystem::path &crash = queue.crashes[i];
+
+        std::string cmd = cmd_split1 + " " + bash_escape(crash.string()) + cmd_split2;
+
+        auto begin = std::chrono::steady_clock::now();
+
+        // Triaged on its own, so it can be recorded in the journal
+        TRIAGE_RESULT result;
+
+        bool done = true;
+        bool timed_out = false;
+
+        switch (parser) {
+
+        case PARSER::ASAN:
+            done = triage_asan(cmd, crash, triage_folder, binary_folder, result, task.attempt, repeat, task.timeout_ms, &fsrv, top_frames,
+                               timed_out);
+            break;
+
+        case PARSER::UBSAN:
+            done = triage_ubsan(cmd, crash, triage_folder, binary_folder, result, task.attempt, repeat, task.timeout_ms, &fsrv, timed_out);
+            break;
+
+        case PARSER::GDB:
+            done = triage_gdb(cmd, crash, triage_folder, binary_folder, result, task.attempt, repeat, task.timeout_ms, &catcher, timed_out);
+            break;
+
+        case PARSER::MALLOC:
+            done = triage_malloc(cmd, crash, triage_folder, binary_folder, result, task.attempt, repeat, task.timeout_ms, &fsrv, timed_out);
+            break;
+
+        case PARSER::COV:
+            done = triage_cov(cmd, crash, triage_folder, binary_folder, result, task.attempt, repeat, task.timeout_ms, &catcher, timed_out);
+            break;
+
+        case PARSER::HANG:
+            done = triage_hang(cmd, crash, binary_folder, result, task.attempt, repeat, task.timeout_ms, &catcher);
+            break;
+        }
+
+        if (done) {
+
+            // Only crashes that reproduced into a bucket. Aborted, unknown or timed out ones may reproduce with another timeout or repeat, so
+            // they stay out of the journal and the next triage runs them again
+            bool bucketed = (result.triage_asan_result != nullptr && !result.triage_asan_result->bugs.empty()) ||
+                            (result.triage_ubsan_result != nullptr && !result.triage_ubsan_result->bugs.empty()) ||
+                            (result.triage_hang_result != nullptr && !result.triage_hang_result->bugs.empty()) ||
+                            (result.triage_gdb_result != nullptr && !result.triage_gdb_result->bugs.empty()) ||
+                            (result.triage_malloc_result != nullptr && !result.triage_malloc_result->detected.empty());
+
+            if (bucketed && queue.keys[i].has_value()) {
+                journal.append(*queue.keys[i], result);
+            }
+
+            results.insert(result);
+
+            stats.crashes++;
+        }
+
+        delete result.triage_asan_result;
+        delete result.triage_gdb_result;
+        delete result.triage_malloc_result;
+        delete result.triage_ubsan_result;
+        delete result.triage_hang_result;
+
+        stats.busy_ms += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+
+        finish_triage_task(queue, task, done, timed_out);
+    }
+}
+
+std::string TRIAGE_RESULT::description(const FR_CRASH &crash) const {
+
+    if (journal == nullptr || crash.report.raw_size == 0) {
+        return crash.description;
+    }
+
+    return journal->read_report(crash.report);
+}
+
+void TRIAGE_SHARED_RESULT::insert(TRIAGE_RESULT &result) {
+
+    if (result.triage_asan_result != nullptr) {
+
+        for (auto &[bug, crashes] : result.triage_asan_result->bugs) {
+            asan_bugs.insert(bug, std::move(crashes));
+        }
+    }
+
+    if (result.triage_gdb_result != nullptr) {
+
+        for (auto &[bug, crashes] : result.triage_gdb_result->bugs) {
+            gdb_bugs.insert(bug, std::move(crashes));
+        }
+    }
+
+    if (result.triage_ubsan_result != nullptr) {
+
+        for (auto &[bug, crashes] : result.triage_ubsan_result->bugs) {
+            ubsan_bugs.insert(bug, std::move(crashes));
+        }
+    }
+
+    if (result.triage_hang_result != nullptr) {
+
+        for (auto &[bug, crashes] : result.triage_hang_result->bugs) {
+            hang_bugs.insert(bug, std::move(crashes));
+        }
+    }
+
+    auto append = [](std::vector<FR_CRASH> &to, std::vector<FR_CRASH> &from) {
+        to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+    };
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (result.triage_asan_result != nullptr) {
+        append(asan_aborted, result.triage_asan_result->aborted);
+        append(asan_unknown, result.triage_asan_result->unknown);
+    }
+
+    if (result.triage_malloc_result != nullptr) {
+        append(malloc_detected, result.triage_malloc_result->detected);
+    }
+
+    if (result.triage_ubsan_result != nullptr) {
+        append(ubsan_unknown, result.triage_ubsan_result->unknown);
+    }
+
+    if (result.triage_hang_result != nullptr) {
+        append(hang_unknown, result.triage_hang_result->unknown);
+    }
+}
+
+void TRIAGE_SHARED_RESULT::drain(TRIAGE_RESULT &results, std::string parser) {
+
+    auto append = [](std::vector<FR_CRASH> &to, std::vector<FR_CRASH> &from) {
+        to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+        from.clear();
+    };
+
+    if (parser == "ASAN") {
+
+        if (results.triage_asan_result == nullptr) {
+            results.triage_asan_result = new TRIAGE_ASAN_RESULT();
+        }
+
+        asan_bugs.drain(results.triage_asan_result->bugs);
+
+        append(results.triage_asan_result->aborted, asan_aborted);
+        append(results.triage_asan_result->unknown, asan_unknown);
+    }
+
+    // COV fills both the GDB and the MALLOC results
+    if (parser == "GDB" || parser == "COV") {
+
+        if (results.triage_gdb_result == nullptr) {
+            results.triage_gdb_result = new TRIAGE_GDB_RESULT();
+        }
+
+        gdb_bugs.drain(results.triage_gdb_result->bugs);
+    }
+
+    if (parser == "MALLOC" || parser == "COV") {
+
+        if (results.triage_malloc_result == nullptr) {
+            results.triage_malloc_result = new TRIAGE_MALLOC_RESULT();
+        }
+
+        append(results.triage_malloc_result->detected, malloc_detected);
+    }
+
+    if (parser == "UBSAN") {
+
+        if (results.triage_ubsan_result == nullptr) {
+            results.triage_ubsan_result = new TRIAGE_UBSAN_RESULT();
+        }
+
+        ubsan_bugs.drain(results.triage_ubsan_result->bugs);
+
+        append(results.triage_ubsan_result->unknown, ubsan_unknown);
+    }
+
+    if (parser == "HANG") {
+
+        if (results.triage_hang_result == nullptr) {
+            results.triage_hang_result = new TRIAGE_HANG_RESULT();
+        }
+
+        hang_bugs.drain(results.triage_hang_result->bugs);
+
+        append(results.triage_hang_result->unknown, hang_unknown);
+    }
+}
+
+std::vector<std::filesystem::path> dedupe_crashes(const std::vector<std::filesystem::path> &crashes, size_t num_threads, CRASH_DUPLICATES &duplicates,
+                                                  std::vector<std::optional<CRASH_KEY>> &keys) {
+
+    std::vector<uint64_t> hashes(crashes.size());
+    std::vector<uintmax_t> sizes(crashes.size());
+    std::vector<char> readable(crashes.size()); // Not std::vector<bool>, it's written concurrently
+
+    std::atomic<size_t> next = 0;
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < crashes.size(); i = next++) {
+
+            std::error_code ec;
+            sizes[i] = std::filesystem::file_size(crashes[i], ec);
+
+            readable[i] = !ec && hash_file(crashes[i], hashes[i]);
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < std::max<size_t>(num_threads, 1); i++) {
+        threads.push_back(std::thread(worker));
+    }
+
+    for (auto &th : threads) {
+        th.join();
+    }
+
+    // <size, hash>, index of the representative
+    std::map<std::pair<uintmax_t, uint64_t>, size_t> seen;
+
+    std::vector<std::filesystem::path> unique;
+
+    for (size_t i = 0; i < crashes.size(); i++) {
+
+        // Unreadable files are kept apart, they are not duplicates of each other
+        if (!readable[i]) {
+            unique.push_back(crashes[i]);
+            keys.push_back(std::nullopt);
+            continue;
+        }
+
+        auto [it, inserted] = seen.insert({{sizes[i], hashes[i]}, i});
+
+        if (inserted) {
+            unique.push_back(crashes[i]);
+            keys.push_back(CRASH_KEY{sizes[i], hashes[i]});
+        } else {
+            duplicates[crashes[it->second]].push_back(crashes[i]);
+        }
+    }
+
+    return unique;
+}
+
+void attach_duplicates(TRIAGE_RESULT &results, const CRASH_DUPLICATES &duplicates) {
+
+    auto attach = [&duplicates](std::vector<FR_CRASH> &crashes) {
+        size_t num_crashes = crashes.size();
+
+        for (size_t i = 0; i < num_crashes; i++) {
+
+            auto it = duplicates.find(crashes[i].crash_path);
+            if (it == duplicates.end()) {
+                continue;
+            }
+
+            for (auto &path : it->second) {
+                FR_CRASH copy = crashes[i];
+                copy.crash_path = path;
+                crashes.push_back(copy);
+            }
+        }
+    };
+
+    if (results.triage_asan_result != nullptr) {
+
+        for (auto &bug : results.triage_asan_result->bugs) {
+            attach(bug.second);
+        }
+
+        attach(results.triage_asan_result->aborted);
+        attach(results.triage_asan_result->unknown);
+    }
+
+    if (results.triage_gdb_result != nullptr) {
+
+        for (auto &bug : results.triage_gdb_result->bugs) {
+            attach(bug.second);
+        }
+    }
+
+    if (results.triage_malloc_result != nullptr) {
+        attach(results.triage_malloc_result->detected);
+    }
+
+    if (results.triage_ubsan_result != nullptr) {
+
+        for (auto &bug : results.triage_ubsan_result->bugs) {
+            attach(bug.second);
+        }
+
+        attach(results.triage_ubsan_result->unknown);
+    }
+
+    if (results.triage_hang_result != nullptr) {
+
+        for (auto &bug : results.triage_hang_result->bugs) {
+            attach(bug.second);
+        }
+
+        attach(results.triage_hang_result->unknown);
+    }
+}
+
+// Bug types are stored by value, bump the version when BUG_TYPE or the record layout changes
+const uint32_t JOURNAL_VERSION = 5;
+
+static void journal_put(std::string &buffer, uint64_t value) { buffer.append((const char *)&value, sizeof(value)); }
+
+static void journal_put(std::string &buffer, const std::string &value) {
+    journal_put(buffer, (uint64_t)value.size());
+    buffer += value;
+}
+
+static bool journal_get(const char *&ptr, const char *end, uint64_t &value) {
+
+    if (end - ptr < (ptrdiff_t)sizeof(value)) {
+        return false;
+    }
+
+    memcpy(&value, ptr, sizeof(value));
+    ptr += sizeof(value);
+
+    return true;
+}
+
+static bool journal_get(const char *&ptr, const char *end, std::string &value) {
+
+    uint64_t size;
+    if (!journal_get(ptr, end, size) || (uint64_t)(end - ptr) < size) {
+        return false;
+    }
+
+    value.assign(ptr, size);
+    ptr += size;
+
+    return true;
+}
+
+bool TRIAGE_JOURNAL::open(std::filesystem::path folder, std::string parser, std::string binary_key) {
+
+    this->parser = parser;
+
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
+
+    std::filesystem::path journal_path = folder / (parser + ".journal");
+    std::filesystem::path reports_path = folder / (parser + ".reports");
+
+    journal_fd = ::open(journal_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    reports_fd = ::open(reports_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (journal_fd == -1 || reports_fd == -1) {
+        std::cerr << "Error: could not open the triage journal in " << folder << std::endl;
+        close();
+        return false;
+    }
+
+    std::string journal = read_fd(journal_fd);
+
+    struct stat st;
+    fstat(reports_fd, &st);
+    reports_size = st.st_size;
+
+    std::string header = "FRTJ";
+    header.append((const char *)&JOURNAL_VERSION, sizeof(JOURNAL_VERSION));
+    journal_put(header, binary_key);
+
+    const char *ptr = journal.data();
+    const char *end = journal.data() + journal.size();
+
+    if (!journal.starts_with(header)) {
+
+        if (!journal.empty()) {
+            std::cout << "- The binary or the journal format changed since the last triage, starting a new " << parser << " journal" << std::endl;
+        }
+
+        ftruncate(journal_fd, 0);
+        ftruncate(reports_fd, 0);
+        reports_size = 0;
+
+        pwrite(journal_fd, header.data(), header.size(), 0);
+
+        ptr = end;
+
+    } else {
+        ptr += header.size();
+    }
+
+    // Records are written with a single write(): an interrupted run can only leave a truncated last record
+    while (ptr < end) {
+
+        const char *record_start = ptr;
+
+        uint64_t record_size;
+        std::string record;
+        CRASH_KEY key;
+        uint64_t num_buckets, report_offset, report_size;
+
+        const char *record_ptr;
+
+        if (!journal_get(ptr, end, record_size) || (uint64_t)(end - ptr) < record_size) {
+            ptr = record_start;
+            break;
+        }
+
+        record.assign(ptr, record_size);
+        ptr += record_size;
+
+        record_ptr = record.data();
+        const char *record_end = record.data() + record.size();
+
+        if (!journal_get(record_ptr, record_end, key.size) || !journal_get(record_ptr, record_end, key.hash) ||
+            !journal_get(record_ptr, record_end, num_buckets) || !journal_get(record_ptr, record_end, report_offset) ||
+            !journal_get(record_ptr, record_end, report_size) || report_offset + report_size > reports_size) {
+            ptr = record_start;
+            break;
+        }
+
+        records[key] = record;
+    }
+
+    if (ptr < end) {
+        ftruncate(journal_fd, ptr - journal.data());
+    }
+
+    lseek(journal_fd, 0, SEEK_END);
+
+    return true;
+}
+
+void TRIAGE_JOURNAL::close() {
+
+    if (journal_fd != -1) {
+        ::close(journal_fd);
+        journal_fd = -1;
+    }
+
+    if (reports_fd != -1) {
+        ::close(reports_fd);
+        reports_fd = -1;
+    }
+}
+
+std::string TRIAGE_JOURNAL::read_report(const REPORT_REF &ref) const {
+
+    std::string compressed(ref.size, '\0');
+
+    if (pread(reports_fd, compressed.data(), ref.size, ref.offset) != (ssize_t)ref.size) {
+        return "";
+    }
+
+    std::string report(ref.raw_size, '\0');
+
+    uLongf report_size = report.size();
+
+    if (uncompress((Bytef *)report.data(), &report_size, (const Bytef *)compressed.data(), compressed.size()) != Z_OK ||
+        report_size != report.size()) {
+        return "";
+    }
+
+    return report;
+}
+
+void TRIAGE_JOURNAL::restore(const CRASH_KEY &key, const std::filesystem::path &crash_path, TRIAGE_RESULT &results) const {
 
-    // stack_trace_num = "    #1";
-    //}
+    auto it = records.find(key);
+    if (it == records.end()) {
+        return;
+    }
 
-    const size_t MAX_STACK_DEPTH = 5;
+    const char *ptr = it->second.data();
+    const char *end = it->second.data() + it->second.size();
 
-    size_t func_num = 0;
+    CRASH_KEY stored_key;
+    uint64_t num_buckets, report_offset, reports_size;
 
-    std::string stack_trace_num = "    #" + std::to_string(func_num);
+    journal_get(ptr, end, stored_key.size);
+    journal_get(ptr, end, stored_key.hash);
+    journal_get(ptr, end, num_buckets);
+    journal_get(ptr, end, report_offset);
+    journal_get(ptr, end, reports_size);
 
-    if ((pos = output.find(stack_trace_num, pos)) != std::string::npos) {
+    FR_CRASH crash;
+    crash.crash_path = crash_path;
+    journal_get(ptr, end, crash.oob_bytes);
 
-        // pos += 6;
+    uint64_t flakiness = 0;
+    journal_get(ptr, end, crash.attempts);
+    journal_get(ptr, end, flakiness);
+    crash.flakiness = std::bit_cast<double>(flakiness);
 
-        std::tuple<std::string, std::filesystem::path, size_t> p;
+    for (uint64_t b = 0; b < num_buckets; b++) {
 
-        std::tuple<std::filesystem::path, uint64_t> q;
+        uint64_t bucket;
 
-        std::filesystem::path saved_file = "";
-        size_t saved_line = 0;
-        uint64_t saved_address = 0;
+        journal_get(ptr, end, bucket);
+        journal_get(ptr, end, crash.report.size);
+        journal_get(ptr, end, crash.report.raw_size);
 
-        do {
+        crash.report.offset = report_offset;
+        report_offset += crash.report.size;
 
-            // pos = output.find('\n', pos) + 1;
+        switch ((JOURNAL_BUCKET)bucket) {
 
-            // String from pos to the end of the line
-            std::string curr_line = output.substr(pos, output.find('\n', pos) - pos);
+        case JOURNAL_BUCKET::NONE:
+            break;
 
-            pos += curr_line.size() + 1;
+        case JOURNAL_BUCKET::ASAN_BUG: {
 
-            // if (!rem_line.starts_with("    #")) {
-            // break;
-            //}
+            FR_NOSYM_BUG bug;
+            uint64_t sanitizer, type;
 
-            p = parse_stack_trace_line(curr_line);
+            journal_get(ptr, end, sanitizer);
+            journal_get(ptr, end, type);
 
-            if (std::get<1>(p).string().starts_with("../")) {
-                // Modify p [1]
-                std::get<1>(p) = binary_folder / std::get<1>(p);
-                // std::cout << "Modified path: " << std::get<1>(p) << std::endl;
+            bug.sanitizer = (SANITIZER)sanitizer;
+            bug.type = (BUG_TYPE)type;
 
-                // Normalize path
-                std::get<1>(p) = std::filesystem::weakly_canonical(std::get<1>(p));
-                // std::cout << "Normalized path: " << std::get<1>(p) << std::endl;
-            }
+            for (size_t i = 0; i < MAX_STACK_DEPTH; i++) {
 
-            if (func_num == 0) {
-                saved_file = std::get<1>(p);
-                saved_line = std::get<2>(p);
+                std::string file;
+                uint64_t address;
 
-            } else {
-                bug.function = " > " + bug.function;
+                journal_get(ptr, end, file);
+                journal_get(ptr, end, address);
+
+                bug.stack_trace[i] = {file, address};
             }
 
-            bug.function = std::get<0>(p) + bug.function;
+            bug.sign();
 
-            func_num += 1;
-            stack_trace_num = "    #" + std::to_string(func_num);
+            results.triage_asan_result->bugs[bug].push_back(crash);
+            break;
+        }
 
-        } while ((pos = output.find(stack_trace_num, pos)) != std::string::npos && func_num < MAX_STACK_DEPTH);
+        case JOURNAL_BUCKET::ASAN_ABORTED:
+            results.triage_asan_result->aborted.push_back(crash);
+            break;
 
-        // bug.function = std::get<0>(p);
+        case JOURNAL_BUCKET::ASAN_UNKNOWN:
+            results.triage_asan_result->unknown.push_back(crash);
+            break;
 
-        bug.file = saved_file;
-        bug.file = std::filesystem::relative(bug.file, triage_folder); // Remove the parent path from the file
+        case JOURNAL_BUCKET::GDB_BUG: {
 
-        bug.line = saved_line;
+            GDB_BUG bug;
+            uint64_t line;
 
-    } else {
+            journal_get(ptr, end, bug.gdb_func);
+            journal_get(ptr, end, bug.gdb_arg);
+            journal_get(ptr, end, bug.gdb_file);
+            journal_get(ptr, end, line);
 
-        // No stack trace found
+            bug.gdb_line = line;
 
-        // std::cout << output << std::endl;
-        // exit(1);
-        // return std::nullopt;
-    }
+            bug.sign();
 
-    // Return the optional with the bug
-    return std::make_tuple(bug, crash);
-}
+            results.triage_gdb_result->bugs[bug].push_back(crash);
+            break;
+        }
+
+        case JOURNAL_BUCKET::MALLOC_DETECTED:
+            journal_get(ptr, end, crash.malloc_msg);
+            results.triage_malloc_result->detected.push_back(crash);
+            break;
 
-FR_BUG symbolize(FR_NOSYM_BUG bug) {
+        case JOURNAL_BUCKET::UBSAN_BUG: {
 
-    FR_BUG sym_bug;
+            UBSAN_BUG bug;
+            uint64_t line, column;
 
-    sym_bug.sanitizer = bug.sanitizer;
-    sym_bug.type = bug.type;
+            journal_get(ptr, end, bug.check);
+            journal_get(ptr, end, bug.file);
+            journal_get(ptr, end, line);
+            journal_get(ptr, end, column);
 
-    for (int i = MAX_STACK_DEPTH - 1; i >= 0; i--) {
+            bug.line = line;
+            bug.column = column;
 
-        std::string filepath = std::get<0>(bug.stack_trace[i]);
-        uint64_t address = std::get<1>(bug.stack_trace[i]);
+            bug.sign();
 
-        if (filepath == "" || address == 0) {
-            continue;
+            results.triage_ubsan_result->bugs[bug].push_back(crash);
+            break;
         }
 
-        // Convert address to hex
-        std::string address_str = "0x" + std::format("{:x}", address);
+        case JOURNAL_BUCKET::UBSAN_UNKNOWN:
+            results.triage_ubsan_result->unknown.push_back(crash);
+            break;
 
-        std::string cmd = "addr2line --exe=" + filepath + " --demangle --functions " + address_str;
+        case JOURNAL_BUCKET::HANG_BUG: {
 
-        std::string output = run(cmd);
+            HANG_BUG bug;
+            uint64_t line;
 
-        std::istringstream iss(output);
+            journal_get(ptr, end, bug.module);
+            journal_get(ptr, end, bug.function);
+            journal_get(ptr, end, bug.file);
+            journal_get(ptr, end, line);
 
-        std::string l;
+            bug.line = line;
 
-        do {
-            std::getline(iss, l);
-        } while (l.find("Dwarf Error") != std::string::npos || l.find("DWARF error") != std::string::npos);
+            bug.sign();
 
-        std::string function = l;
+            results.triage_hang_result->bugs[bug].push_back(crash);
+            break;
+        }
 
-        size_t aux = function.find('(');
-        if (aux != std::string::npos) {
-            function = function.substr(0, aux);
+        case JOURNAL_BUCKET::HANG_UNKNOWN:
+            results.triage_hang_result->unknown.push_back(crash);
+            break;
         }
+    }
+}
 
-        std::string file = "";
-        std::string line = "";
+void TRIAGE_JOURNAL::append(const CRASH_KEY &key, TRIAGE_RESULT &result) {
 
-        if (function == "??") {
-            std::filesystem::path obj_file = filepath;
-            function = obj_file.filename().string() + "+" + address_str;
+    struct ENTRY {
+        JOURNAL_BUCKET bucket;
+        FR_CRASH *crash;
+        std::string fields; // Bucket-specific
+        uint64_t report_size = 0;
+    };
 
-        } else {
+    // COV results have a GDB and a MALLOC entry
+    std::vector<ENTRY> entries;
 
-            do {
-                std::getline(iss, l);
-            } while (l.find("Dwarf Error") != std::string::npos || l.find("DWARF error") != std::string::npos);
+    if (result.triage_asan_result != nullptr) {
 
-            // Look for ':' in the file line
-            size_t pos;
-            if ((pos = l.find(':')) != std::string::npos) {
+        if (!result.triage_asan_result->bugs.empty()) {
 
-                file = l.substr(0, pos);
+            auto &[bug, crashes] = *result.triage_asan_result->bugs.begin();
 
-                if (file == "??") {
-                    file = "";
-                    line = "0";
+            std::string fields;
 
-                } else {
+            journal_put(fields, (uint64_t)bug.sanitizer);
+            journal_put(fields, (uint64_t)bug.type);
 
-                    size_t pos2;
-                    if ((pos2 = l.find(':', pos + 1)) != std::string::npos) {
-                        line = l.substr(pos + 1, pos2 - pos - 1);
-                    } else {
-                        line = l.substr(pos + 1);
-                    }
+            for (size_t i = 0; i < MAX_STACK_DEPTH; i++) {
+                journal_put(fields, std::get<0>(bug.stack_trace[i]).string());
+                journal_put(fields, std::get<1>(bug.stack_trace[i]));
+            }
 
-                    if (line == "?") {
-                        line = "0";
+            entries.push_back({JOURNAL_BUCKET::ASAN_BUG, &crashes[0], fields});
 
-                    } else if (!is_number(line)) {
-                        std::cerr << "Error: line is not a number: " << line << std::endl;
-                        exit(EXIT_FAILURE);
-                    }
-                }
+        } else if (!result.triage_asan_result->aborted.empty()) {
+            entries.push_back({JOURNAL_BUCKET::ASAN_ABORTED, &result.triage_asan_result->aborted[0], ""});
 
-            } else {
-                file = l;
-            }
+        } else if (!result.triage_asan_result->unknown.empty()) {
+            entries.push_back({JOURNAL_BUCKET::ASAN_UNKNOWN, &result.triage_asan_result->unknown[0], ""});
         }
+    }
 
-        sym_bug.function += function;
+    if (result.triage_gdb_result != nullptr && !result.triage_gdb_result->bugs.empty()) {
 
-        if (i == 0) {
-            sym_bug.file = file;
-            sym_bug.line = std::stoi(line);
+        auto &[bug, crashes] = *result.triage_gdb_result->bugs.begin();
 
-        } else {
-            sym_bug.function += " > ";
-        }
-    }
+        std::string fields;
 
-    return sym_bug;
-}
+        journal_put(fields, bug.gdb_func);
+        journal_put(fields, bug.gdb_arg);
+        journal_put(fields, bug.gdb_file);
+        journal_put(fields, (uint64_t)bug.gdb_line);
 
-void symbolize_results(TRIAGE_RESULT &results, std::filesystem::path triage_folder) {
+        entries.push_back({JOURNAL_BUCKET::GDB_BUG, &crashes[0], fields});
+    }
 
-    auto &bugs = results.triage_asan_result->bugs;
-    auto &sym_bugs = results.triage_asan_result->sym_bugs;
+    if (result.triage_malloc_result != nullptr && !result.triage_malloc_result->detected.empty()) {
 
-    // Check if "addr2line" is installed
-    std::string checkcmd = "addr2line --version";
+        FR_CRASH *crash = &result.triage_malloc_result->detected[0];
 
-    std::string output = run(checkcmd);
+        std::string fields;
+        journal_put(fields, crash->malloc_msg);
 
-    if (output.find("addr2line") == std::string::npos) {
-        std::cerr << "Error: addr2line is not installed" << std::endl;
-        exit(EXIT_FAILURE);
+        entries.push_back({JOURNAL_BUCKET::MALLOC_DETECTED, crash, fields});
     }
 
-    // Symbolize the crashes
-    std::cout << std::endl;
-    std::cout << "Symbolizing the results..." << std::endl;
+    // One entry per runtime error of the run
+    if (result.triage_ubsan_result != nullptr) {
 
-    for (auto &bug : bugs) {
+        for (auto &[bug, crashes] : result.triage_ubsan_result->bugs) {
 
-        FR_BUG sym_bug = symbolize(bug.first);
+            std::string fields;
 
-        sym_bug.file = std::filesystem::relative(sym_bug.file, triage_folder); // Remove the parent path from the file
+            journal_put(fields, bug.check);
+            journal_put(fields, bug.file);
+            journal_put(fields, (uint64_t)bug.line);
+            journal_put(fields, (uint64_t)bug.column);
 
-        if (sym_bugs.count(sym_bug) > 0) {
-            sym_bugs[sym_bug].insert(sym_bugs[sym_bug].end(), bug.second.begin(), bug.second.end());
+            entries.push_back({JOURNAL_BUCKET::UBSAN_BUG, &crashes[0], fields});
+        }
 
-        } else {
-            sym_bugs.insert({sym_bug, {bug.second}});
+        if (!result.triage_ubsan_result->unknown.empty()) {
+            entries.push_back({JOURNAL_BUCKET::UBSAN_UNKNOWN, &result.triage_ubsan_result->unknown[0], ""});
         }
     }
-}
 
-void triage_asan(std::string cmd, std::filesystem::path crash_path, std::filesystem::path triage_folder, const std::filesystem::path binary_folder,
-                 TRIAGE_RESULT &triage_results, size_t repeat) {
-
-    if (triage_results.triage_asan_result == nullptr) {
-        triage_results.triage_asan_result = new TRIAGE_ASAN_RESULT();
-    }
+    if (result.triage_hang_result != nullptr) {
 
-    TRIAGE_ASAN_RESULT *results = triage_results.triage_asan_result;
+        if (!result.triage_hang_result->bugs.empty()) {
 
-    std::string output;
+            auto &[bug, crashes] = *result.triage_hang_result->bugs.begin();
 
-    bool found = false;
+            std::string fields;
 
-    for (int r = 0; r < repeat && !found; r++) {
+            journal_put(fields, bug.module);
+            journal_put(fields, bug.function);
+            journal_put(fields, bug.file);
+            journal_put(fields, (uint64_t)bug.line);
 
-        // if (r > 0) {
-        //  std::cout << "\t Repeating..." << std::endl;
-        //}
+            entries.push_back({JOURNAL_BUCKET::HANG_BUG, &crashes[0], fields});
 
-        // output = run(cmd + crashes[i].string());
+        } else if (!result.triage_hang_result->unknown.empty()) {
+            entries.push_back({JOURNAL_BUCKET::HANG_UNKNOWN, &result.triage_hang_result->unknown[0], ""});
+        }
+    }
 
-        output = run(cmd, 60000); // 60 seconds timeout
+    // The reports of a record are stored one after the other. Compressed before taking the lock
+    std::string reports;
 
-        // std::cout << output << std::endl;
+    for (auto &entry : entries) {
 
-        std::optional<std::tuple<FR_NOSYM_BUG, FR_CRASH>> result = parse_sanitizer_output_NOSYM(output, triage_folder, binary_folder);
+        const std::string &description = entry.crash->description;
 
-        if (result.has_value()) {
+        if (description.empty()) {
+            continue;
+        }
 
-            // Bug found
+        std::string compressed(compressBound(description.size()), '\0');
 
-            FR_NOSYM_BUG bug = std::get<0>(result.value());
-            FR_CRASH fr_crash = std::get<1>(result.value());
-            fr_crash.crash_path = crash_path;
+        uLongf compressed_size = compressed.size();
 
-            // Check if the bug is already in the list
-            if (results->bugs.count(bug) > 0) {
+        if (compress2((Bytef *)compressed.data(), &compressed_size, (const Bytef *)description.data(), description.size(), JOURNAL_REPORT_LEVEL) !=
+            Z_OK) {
+            return;
+        }
 
-                results->bugs[bug].push_back(fr_crash);
+        reports.append(compressed.data(), compressed_size);
+        entry.report_size = compressed_size;
+    }
 
-            } else {
+    std::lock_guard<std::mutex> lock(mutex);
 
-                results->bugs.insert({bug, {fr_crash}});
-            }
+    if (journal_fd == -1) {
+        return;
+    }
 
-            found = true;
+    uint64_t report_offset = reports_size;
 
-        } else {
+    if (!reports.empty()) {
 
-            // No bug found by parse_sanitizer_output
+        if (pwrite(reports_fd, reports.data(), reports.size(), report_offset) != (ssize_t)reports.size()) {
+            return;
+        }
 
-            // Check if output is an aborted
-            if (output.find("Aborted") != std::string::npos) {
+        reports_size += reports.size();
+    }
 
-                FR_CRASH abort;
+    // Only the refs stay in memory
+    uint64_t offset = report_offset;
 
-                abort.crash_path = crash_path;
-                abort.description = output;
+    for (auto &entry : entries) {
 
-                results->aborted.push_back(abort);
+        if (entry.report_size == 0) {
+            continue;
+        }
 
-                found = true;
+        entry.crash->report = {offset, entry.report_size, entry.crash->description.size()};
+        offset += entry.report_size;
+    }
 
-            } else {
-                // std::cout << "\t No bug found at repeat " << r << std::endl;
-            }
-        }
+    const FR_CRASH *crash = entries.empty() ? nullptr : entries[0].crash;
+
+    std::string record;
+    journal_put(record, key.size);
+    journal_put(record, key.hash);
+    journal_put(record, (uint64_t)entries.size());
+    journal_put(record, report_offset);
+    journal_put(record, (uint64_t)reports.size());
+    journal_put(record, crash != nullptr ? crash->oob_bytes : 0);
+    journal_put(record, crash != nullptr ? crash->attempts : 1);
+    journal_put(record, crash != nullptr ? std::bit_cast<uint64_t>(crash->flakiness) : 0);
+
+    for (auto &entry : entries) {
+        journal_put(record, (uint64_t)entry.bucket);
+        journal_put(record, entry.report_size);
+        journal_put(record, entry.crash->report.raw_size);
+        record += entry.fields;
+
+        std::string().swap(entry.crash->description);
     }
 
-    if (!found) {
+    std::string entry;
+    journal_put(entry, (uint64_t)record.size());
+    entry += record;
 
-        FR_CRASH u;
-        u.crash_path = crash_path;
-        u.description = output;
+    if (write(journal_fd, entry.data(), entry.size()) == (ssize_t)entry.size()) {
+        records[key] = record;
+    }
+}
 
-        results->unknown.push_back(u);
+// Whether a run of the worker's input lands in the bucket of target
+static bool reproduces(const MINIMIZE_TARGET &target, MINIMIZE_WORKER &worker, const std::string &cmd, bool use_catcher,
+                       const std::filesystem::path triage_folder, const std::filesystem::path binary_folder, size_t timeout_ms, size_t top_frames) {
 
-        // std::cerr << "Failed to triage crash: " << crashes[i] << std::endl;
-        // std::cout << output << std::endl;
-        //  exit(EXIT_FAILURE);
-    }
+    std::string output;
 
-    // std::cout << std::endl;
-}
+    if (use_catcher) {
 
-std::tuple<std::string, std::string, std::string, size_t> parse_gdb_line(std::string line) {
+        std::optional<std::vector<std::string>> argv = split_command(cmd);
 
-    std::string function = "";
-    std::string argument = "";
-    std::string filename = "";
-    size_t linenumber = 0;
+        if (!argv.has_value()) {
+            argv = {"/bin/sh", "-c", cmd};
+        }
 
-    size_t pos;
+        CRASH_INFO info = worker.catcher.run(argv.value(), timeout_ms);
 
-    if ((pos = line.find(" ")) != std::string::npos) {
+        if (target.bucket == JOURNAL_BUCKET::GDB_BUG) {
 
-        function = line.substr(0, pos);
+            TRIAGE_GDB_RESULT result;
 
-        line = line.substr(pos + 1);
+            return bucket_gdb_crash(info, worker.input, binary_folder, &result) && result.bugs.begin()->first.signature == target.signature;
+        }
 
-        pos = 0;
+        output = std::move(info.output);
 
-        if (function.starts_with("0x") && line.starts_with("in ")) {
+    } else {
+        output = replay(cmd, worker.input, &worker.fsrv, timeout_ms);
+    }
 
-            pos += 3;
+    if (target.bucket == JOURNAL_BUCKET::ASAN_BUG) {
 
-            // Find next whitespace
-            if ((pos = line.find(" ", pos)) != std::string::npos) {
+        auto result = parse_sanitizer_output_NOSYM(output, triage_folder, binary_folder, top_frames);
 
-                function = line.substr(3, pos - 3);
+        return result.has_value() && std::get<0>(result.value()).signature == target.signature;
+    }
 
-                line = line.substr(pos + 1);
-            }
+    // Any of the runtime errors of the run
+    if (target.bucket == JOURNAL_BUCKET::UBSAN_BUG) {
 
-            // std::cout << line << std::endl;
+        for (auto &[bug, crash] : parse_ubsan_output(output, binary_folder)) {
+            if (bug.signature == target.signature) {
+                return true;
+            }
         }
 
-        // std::cout << "Function: " << function << std::endl;
+        return false;
+    }
 
-        if ((pos = line.find(" at ")) != std::string::npos || (pos = line.find(" from ")) != std::string::npos) {
+    TRIAGE_MALLOC_RESULT result;
 
-            if (pos > 0) {
-                argument = line.substr(0, pos);
-                // std::cout << "Argument: " << argument << std::endl;
+    return parse_malloc_output(output, worker.input, &result) && result.detected.front().malloc_msg == target.malloc_msg;
+}
+
+void minimize_results(TRIAGE_RESULT &results, std::string parser, std::string cmd_split1, std::string cmd_split2,
+                      const std::filesystem::path triage_folder, const std::filesystem::path binary_folder, std::filesystem::path forkserver_shim,
+                      size_t repeat, size_t timeout_ms, size_t top_frames, size_t num_threads, const std::filesystem::path folder) {
+
+    // Smallest input of the bucket, nullptr if the bucket already has a minimized one
+    auto smallest = [](std::vector<FR_CRASH *> crashes) -> FR_CRASH * {
+        FR_CRASH *best = nullptr;
+        uintmax_t best_size = UINTMAX_MAX;
+
+        for (FR_CRASH *crash : crashes) {
+
+            if (!crash->minimized.empty()) {
+                return nullptr;
             }
 
-            filename = line.substr(pos + 4);
+            std::error_code ec;
+            uintmax_t size = std::filesystem::file_size(crash->crash_path, ec);
 
-            // Get now the line number
+            if (!ec && size < best_size) {
+                best = crash;
+                best_size = size;
+            }
+        }
 
-            if ((pos = filename.find(":")) != std::string::npos) {
+        return best;
+    };
 
-                std::string line_number = filename.substr(pos + 1);
+    auto pointers = [](std::vector<FR_CRASH> &crashes) {
+        std::vector<FR_CRASH *> ptrs;
 
-                filename = filename.substr(0, pos);
+        for (FR_CRASH &crash : crashes) {
+            ptrs.push_back(&crash);
+        }
 
-                linenumber = std::stoi(line_number);
+        return ptrs;
+    };
 
-                // std::cout << "File: " << filename << std::endl;
+    std::vector<MINIMIZE_TARGET> targets;
 
-                // std::cout << "Line: " << linenumber << std::endl;
+    if (parser == "ASAN" && results.triage_asan_result != nullptr) {
+
+        for (auto &[bug, crashes] : results.triage_asan_result->bugs) {
+
+            if (FR_CRASH *crash = smallest(pointers(crashes))) {
+                targets.push_back({JOURNAL_BUCKET::ASAN_BUG, bug.signature, "", crash});
             }
         }
     }
 
-    return std::make_tuple(function, argument, filename, linenumber);
-}
+    if (parser == "UBSAN" && results.triage_ubsan_result != nullptr) {
 
-void triage_gdb(std::string cmd, std::filesystem::path crash_path, const std::filesystem::path triage_folder,
-                const std::filesystem::path binary_folder, TRIAGE_RESULT &triage_results, size_t repeat) {
+        for (auto &[bug, crashes] : results.triage_ubsan_result->bugs) {
 
-    if (triage_results.triage_gdb_result == nullptr) {
-        triage_results.triage_gdb_result = new TRIAGE_GDB_RESULT();
+            if (FR_CRASH *crash = smallest(pointers(crashes))) {
+                targets.push_back({JOURNAL_BUCKET::UBSAN_BUG, bug.signature, "", crash});
+            }
+        }
     }
 
-    TRIAGE_GDB_RESULT *results = triage_results.triage_gdb_result;
+    if ((parser == "GDB" || parser == "COV") && results.triage_gdb_result != nullptr) {
 
-    std::string output;
+        for (auto &[bug, crashes] : results.triage_gdb_result->bugs) {
 
-    bool found = false;
+            if (FR_CRASH *crash = smallest(pointers(crashes))) {
+                targets.push_back({JOURNAL_BUCKET::GDB_BUG, bug.signature, "", crash});
+            }
+        }
+    }
 
-    std::string command = "gdb";
+    // MALLOC detections are not bucketed, the glibc message stands for the bucket
+    if ((parser == "MALLOC" || parser == "COV") && results.triage_malloc_result != nullptr) {
 
-    command += " --batch"; // Batch mode
+        std::map<std::string, std::vector<FR_CRASH *>> messages;
 
-    command += " -ex 'run'";
+        for (FR_CRASH &crash : results.triage_malloc_result->detected) {
+            messages[crash.malloc_msg].push_back(&crash);
+        }
 
-    command += " -ex 'quit'"; // Continue the execution
+        for (auto &[msg, crashes] : messages) {
 
-    command += " --args " + cmd; // Load the binary"
+            if (FR_CRASH *crash = smallest(crashes)) {
+                uint64_t hash = xxhash64(msg.data(), msg.size(), STACK_SIGNATURE_SEED);
+                targets.push_back({JOURNAL_BUCKET::MALLOC_DETECTED, {hash, hash}, msg, crash});
+            }
+        }
+    }
 
-    for (int r = 0; r < repeat && !found; r++) {
+    if (targets.empty()) {
+        return;
+    }
 
-        output = run(command, 15000); // 15 seconds timeout
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
 
-        // std::cout << output << std::endl;
+    if (ec) {
+        std::cerr << "Error: could not create " << folder << std::endl;
+        return;
+    }
 
-        size_t pos;
+    std::cout << std::endl;
+    std::cout << "Minimizing " << targets.size() << " reproducers..." << std::endl;
 
-        if ((pos = output.find("SIGSEGV")) != std::string::npos || (pos = output.find("SIGABRT")) != std::string::npos) {
+    num_threads = std::max<size_t>(num_threads, 1);
 
-            found = true;
+    std::vector<MINIMIZE_WORKER> workers(num_threads);
 
-            output = output.substr(pos);
+    std::vector<std::string> cmds;
 
-            std::stringstream ss(output);
+    for (size_t i = 0; i < num_threads; i++) {
 
-            // Get the first line
-            std::string line;
+        workers[i].input = folder / (".candidate_" + std::to_string(i));
+        cmds.push_back(cmd_split1 + " " + bash_escape(workers[i].input.string()) + cmd_split2);
 
-            if (std::getline(ss, line)) {
+        if (!forkserver_shim.empty() && (parser == "ASAN" || parser == "UBSAN" || parser == "MALLOC")) {
+            workers[i].fsrv.start(cmd_split1 + " @@" + cmd_split2, forkserver_shim);
+        }
+    }
 
-                // std::cout << line << std::endl;
+    // COV finds MALLOC bugs in the output of the crash catcher, like triage_cov()
+    bool use_catcher = parser == "GDB" || parser == "COV";
 
-                if (std::getline(ss, line)) {
+    for (MINIMIZE_TARGET &target : targets) {
 
-                    // std::cout << line << std::endl;
+        std::string input = read_file(target.crash->crash_path);
 
-                    while (line.starts_with("[Switching to Thread")) {
+        size_t tries = std::clamp<size_t>(target.crash->attempts, 1, std::max<size_t>(repeat, 1));
 
-                        // std::cout << "Skipping line..." << std::endl;
+        auto oracle = [&](size_t worker, const std::string &candidate) {
+            if (!write_file(workers[worker].input.string(), candidate)) {
+                return false;
+            }
 
-                        if (!std::getline(ss, line)) {
-                            break;
-                        }
-                    }
+            for (size_t t = 0; t < tries; t++) {
 
-                    // std::cout << line << std::endl;
+                if (reproduces(target, workers[worker], cmds[worker], use_catcher, triage_folder, binary_folder, timeout_ms, top_frames)) {
+                    return true;
+                }
+            }
 
-                    // Parse the line to get function name, file and line
+            return false;
+        };
 
-                    auto tuple = parse_gdb_line(line);
+        std::string prefix = target.bucket == JOURNAL_BUCKET::ASAN_BUG    ? "asan_"
+                             : target.bucket == JOURNAL_BUCKET::GDB_BUG   ? "gdb_"
+                             : target.bucket == JOURNAL_BUCKET::UBSAN_BUG ? "ubsan_"
+                                                                          : "malloc_";
 
-                    GDB_BUG bug;
-                    bug.gdb_func = std::get<0>(tuple);
-                    bug.gdb_arg = std::get<1>(tuple);
-                    bug.gdb_file = std::get<2>(tuple);
+        std::filesystem::path output = folder / std::format("{}{:016x}{:016x}", prefix, target.signature.high, target.signature.low);
 
-                    if (bug.gdb_file.starts_with("../")) {
+        // From a previous run, if it still lands in the same bucket
+        if (std::filesystem::exists(output) && std::filesystem::file_size(output, ec) <= input.size() && oracle(0, read_file(output))) {
+            target.crash->minimized = output;
+            continue;
+        }
 
-                        bug.gdb_file = binary_folder / bug.gdb_file;
-                        bug.gdb_file = std::filesystem::weakly_canonical(bug.gdb_file);
-                    }
+        minimizer ddmin(num_threads, oracle);
 
-                    bug.gdb_line = std::get<3>(tuple);
+        std::string minimized = ddmin.minimize(input);
 
-                    if (bug.gdb_func == "" || bug.gdb_file == "") {
-                        std::cerr << "Error: Failed to parse gdb output" << std::endl;
-                        std::cout << output << std::endl;
-                        // exit(EXIT_FAILURE);
-                    }
+        if (!write_file(output.string(), minimized)) {
+            std::cerr << "Error: could not write " << output << std::endl;
+            continue;
+        }
 
-                    FR_CRASH crash;
-                    crash.crash_path = crash_path;
-                    crash.description = output;
+        target.crash->minimized = output;
 
-                    // Check if the bug is already in the list
-                    if (results->bugs.count(bug) > 0) {
+        std::cout << "- " << output.filename().string() << ": " << input.size() << " -> " << minimized.size() << " bytes, " << ddmin.executions()
+                  << " executions" << std::endl;
+    }
 
-                        results->bugs[bug].push_back(crash);
+    for (MINIMIZE_WORKER &worker : workers) {
+        std::filesystem::remove(worker.input, ec);
+    }
 
-                    } else {
+    // The minimized crash goes first, the summary only lists the first crashes of a bucket
+    auto to_front = [](std::vector<FR_CRASH> &crashes) {
+        auto it = std::find_if(crashes.begin(), crashes.end(), [](const FR_CRASH &crash) { return !crash.minimized.empty(); });
 
-                        results->bugs.insert({bug, {crash}});
-                    }
-                }
-            }
+        if (it != crashes.end()) {
+            std::rotate(crashes.begin(), it, it + 1);
         }
-    }
-}
+    };
 
-void triage_malloc(std::string cmd, std::filesystem::path crash_path, const std::filesystem::path triage_folder,
-                   const std::filesystem::path binary_folder, TRIAGE_RESULT &triage_results, size_t repeat) {
+    if (parser == "ASAN" && results.triage_asan_result != nullptr) {
 
-    if (triage_results.triage_malloc_result == nullptr) {
-        triage_results.triage_malloc_result = new TRIAGE_MALLOC_RESULT();
+        for (auto &bug : results.triage_asan_result->bugs) {
+            to_front(bug.second);
+        }
     }
 
-    TRIAGE_MALLOC_RESULT *results = triage_results.triage_malloc_result;
-
-    std::string output;
-
-    bool found = false;
+    if ((parser == "GDB" || parser == "COV") && results.triage_gdb_result != nullptr) {
 
-    // for (int r = 0; r < repeat && !found; r++) {
+        for (auto &bug : results.triage_gdb_result->bugs) {
+            to_front(bug.second);
+        }
+    }
 
-    output = run(cmd, 15000); // 15 seconds timeout
+    if (parser == "UBSAN" && results.triage_ubsan_result != nullptr) {
 
-    // std::cout << output << std::endl;
+        for (auto &bug : results.triage_ubsan_result->bugs) {
+            to_front(bug.second);
+        }
+    }
+}
 
-    std::string substr[] = {
+// Folders AFL++ fills with files, not followed unless they hold the findings being triaged
+static const std::set<std::string> TRIAGE_UNWATCHED = {"queue", "crashes", "hangs", ".synced", ".state"};
 
-        "break adjusted to free malloc space",
+TRIAGE_WATCHER::~TRIAGE_WATCHER() {
 
-        "corrupted double-linked list",
-        "corrupted size vs. prev_size",
+    if (fd >= 0) {
+        close(fd);
+    }
+}
 
-        "double free or corruption",
+bool TRIAGE_WATCHER::open(const std::vector<std::filesystem::path> &folders, std::string findings) {
 
-        "free(): corrupted unsorted chunks",
-        "free(): double free detected in tcache",
-        "free(): invalid next size (fast)",
-        "free(): invalid next size (normal)",
-        "free(): invalid pointer",
-        "free(): invalid size",
-        "free(): too many chunks detected in tcache",
+    this->findings = findings;
 
-        "_int_memalign(): unaligned chunk detected",
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
 
-        "invalid chunk size",
-        "invalid fastbin entry",
+    if (fd < 0) {
+        std::cerr << "Error: could not initialize inotify: " << strerror(errno) << std::endl;
+        return false;
+    }
 
-        "malloc(): corrupted unsorted chunks",
-        "malloc(): corrupted top size",
-        "malloc(): invalid next->prev_inuse",
-        "malloc(): invalid next size",
-        "malloc(): invalid size",
-        "malloc(): largebin double linked list corrupted",
-        "malloc(): memory corruption",
-        "malloc(): mismatching next->prev_size",
-        "malloc(): smallbin double linked list corrupted",
-        "malloc: top chunk is corrupt",
-        "malloc(): unaligned fastbin chunk detected",
-        "malloc(): unaligned tcache chunk detected",
-        "malloc(): unsorted double linked list corrupted",
+    for (auto &folder : folders) {
+        watch(folder, 0, false);
+    }
 
-        "malloc_check_get_size: memory corruption",
+    return true;
+}
 
-        "malloc_consolidate(): invalid chunk size",
+void TRIAGE_WATCHER::watch(const std::filesystem::path &folder, size_t depth, bool existing) {
 
-        "munmap_chunk(): invalid pointer",
-        "mremap_chunk(): invalid pointer",
+    bool crashes = folder.filename().string() == findings;
 
-        "realloc(): invalid old size",
-        "realloc(): invalid next size",
-        "realloc(): invalid pointer",
+    // AFL++ writes the crashes in place, but other tools may move them in
+    uint32_t mask = crashes ? (IN_CLOSE_WRITE | IN_MOVED_TO) : (IN_CREATE | IN_MOVED_TO | IN_ONLYDIR);
 
-        "unaligned fastbin chunk detected",
-        "unaligned tcache chunk detected",
+    int wd = inotify_add_watch(fd, folder.c_str(), mask);
 
-        "Fatal glibc error: malloc.c",
+    if (wd < 0) {
+        std::cerr << "Warning: could not watch " << folder << ": " << strerror(errno) << std::endl;
+        return;
+    }
 
-        "glibc error"
+    watches[wd] = {folder, depth};
 
-    };
+    if (crashes) {
 
-    for (auto &sstr : substr) {
+        if (existing) {
+            list_crashes(folder);
+        }
 
-        if (output.find(sstr) != std::string::npos) {
+        return;
+    }
 
-            // std::cout << std::endl;
-            // std::cout << output << std::endl;
-            // std::cout << std::endl;
+    if (depth == TRIAGE_WATCH_DEPTH) {
+        return;
+    }
 
-            FR_CRASH crash;
+    std::error_code ec;
 
-            crash.crash_path = crash_path;
-            crash.description = output;
-            crash.malloc_msg = sstr;
+    for (auto &entry : std::filesystem::directory_iterator(folder, ec)) {
 
-            results->detected.push_back(crash);
+        std::string name = entry.path().filename().string();
 
-            break;
+        if (entry.is_directory(ec) && (name == findings || !TRIAGE_UNWATCHED.contains(name))) {
+            watch(entry.path(), depth + 1, existing);
         }
     }
 }
 
-void triage_thread(size_t thread_id, const std::vector<std::filesystem::path> &crashes, std::string cmd_split1, std::string cmd_split2,
-                   const std::filesystem::path triage_folder, const std::filesystem::path binary_folder, TRIAGE_RESULT &results, size_t repeat,
-                   std::string parser_str) {
-
-    enum PARSER { ASAN, UBSAN, GDB, MALLOC } parser;
-
-    if (parser_str == "ASAN") {
-        parser = PARSER::ASAN;
-    } else if (parser_str == "UBSAN") {
-        parser = PARSER::UBSAN;
-    } else if (parser_str == "GDB") {
-        parser = PARSER::GDB;
-    } else if (parser_str == "MALLOC") {
-        parser = PARSER::MALLOC;
-    } else {
-        std::cerr << "Error: Unknown parser" << std::endl;
-        exit(EXIT_FAILURE);
-    }
+void TRIAGE_WATCHER::list_crashes(const std::filesystem::path &folder) {
 
-    size_t num_elements = crashes.size();
+    std::error_code ec;
 
-    for (int i = 0; i < num_elements; i++) {
+    for (auto &entry : std::filesystem::directory_iterator(folder, ec)) {
 
-        if (thread_id == 0 && i % 10 == 0) {
-            std::cout << "Current run: " << i + 1 << " / " << num_elements << std::endl;
+        if (entry.is_regular_file(ec) && entry.path().filename().string() != "README.txt") {
+            found.push_back(entry.path());
         }
+    }
+}
 
-        std::string cmd = cmd_split1 + " " + bash_escape(crashes[i].string()) + cmd_split2;
+std::vector<std::filesystem::path> TRIAGE_WATCHER::wait(int timeout_ms) {
 
-        switch (parser) {
+    // Crashes found by watch() are reported first, the pending events are still read
+    if (!found.empty()) {
+        timeout_ms = 0;
+    }
 
-        case PARSER::ASAN:
-            triage_asan(cmd, crashes[i], triage_folder, binary_folder, results, repeat);
-            break;
+    struct pollfd pfd = {fd, POLLIN, 0};
 
-        case PARSER::UBSAN:
+    if (poll(&pfd, 1, timeout_ms) > 0) {
 
-            break;
+        alignas(struct inotify_event) char buffer[64 * 1024];
 
-        case PARSER::GDB:
-            triage_gdb(cmd, crashes[i], triage_folder, binary_folder, results, repeat);
-            break;
+        ssize_t size;
 
-        case PARSER::MALLOC:
-            triage_malloc(cmd, crashes[i], triage_folder, binary_folder, results, repeat);
-            break;
-        }
-    }
-}
+        while ((size = read(fd, buffer, sizeof(buffer))) > 0) {
 
-void merge_triage_results(TRIAGE_RESULT &merged_results, const std::vector<TRIAGE_RESULT> &triage_results, std::string parser) {
+            for (char *ptr = buffer; ptr < buffer + size;) {
 
-    // TRIAGE_RESULT merged_results;
+                struct inotify_event *event = (struct inotify_event *)ptr;
+                ptr += sizeof(struct inotify_event) + event->len;
 
-    size_t num_threads = triage_results.size();
+                // Events were lost: every crashes/ folder is listed again, the caller skips what it has seen
+                if (event->mask & IN_Q_OVERFLOW) {
 
-    // Merge the outputs of the threads
+                    for (auto &[wd, watched] : watches) {
+                        if (watched.first.filename().string() == findings) {
+                            list_crashes(watched.first);
+                        }
+                    }
 
-    if (parser == "ASAN") {
+                    continue;
+                }
 
-        if (merged_results.triage_asan_result == nullptr) {
-            merged_results.triage_asan_result = new TRIAGE_ASAN_RESULT();
-        }
+                auto it = watches.find(event->wd);
+
+                if (it == watches.end()) {
+                    continue;
+                }
 
-        for (size_t i = 0; i < num_threads; ++i) {
+                if (event->mask & IN_IGNORED) {
+                    watches.erase(it);
+                    continue;
+                }
 
-            for (auto &it : triage_results[i].triage_asan_result->bugs) {
+                if (event->len == 0) {
+                    continue;
+                }
 
-                FR_NOSYM_BUG bug = std::get<0>(it);
+                // watch() adds to watches
+                auto [folder, depth] = it->second;
 
-                std::vector<FR_CRASH> fr_crashes = std::get<1>(it);
+                std::filesystem::path path = folder / event->name;
 
-                auto &bugs = merged_results.triage_asan_result->bugs;
+                if (event->mask & IN_ISDIR) {
 
-                if (bugs.count(bug) > 0) {
-                    bugs[bug].insert(bugs[bug].end(), fr_crashes.begin(), fr_crashes.end());
+                    if (folder.filename().string() != findings && depth < TRIAGE_WATCH_DEPTH &&
+                        (event->name == findings || !TRIAGE_UNWATCHED.contains(event->name))) {
+                        watch(path, depth + 1, true);
+                    }
 
-                } else {
-                    bugs.insert({bug, {fr_crashes}});
+                } else if (folder.filename().string() == findings && path.filename().string() != "README.txt") {
+                    found.push_back(path);
                 }
             }
-
-            auto &aborted = triage_results[i].triage_asan_result->aborted;
-            auto &unknown = triage_results[i].triage_asan_result->unknown;
-
-            merged_results.triage_asan_result->aborted.insert(merged_results.triage_asan_result->aborted.end(), aborted.begin(), aborted.end());
-            merged_results.triage_asan_result->unknown.insert(merged_results.triage_asan_result->unknown.end(), unknown.begin(), unknown.end());
         }
+    }
 
-    } else if (parser == "UBSAN") {
+    std::vector<std::filesystem::path> crashes;
+    crashes.swap(found);
 
-    } else if (parser == "GDB") {
+    return crashes;
+}
 
-        if (merged_results.triage_gdb_result == nullptr) {
-            merged_results.triage_gdb_result = new TRIAGE_GDB_RESULT();
-        }
+void lower_priority() {
 
-        for (size_t i = 0; i < num_threads; ++i) {
+    struct sched_param param = {};
 
-            for (auto &it : triage_results[i].triage_gdb_result->bugs) {
+    if (sched_setscheduler(0, SCHED_IDLE, &param) == 0) {
+        std::cout << "- Priority: SCHED_IDLE" << std::endl;
+        return;
+    }
 
-                GDB_BUG bug = std::get<0>(it);
+    if (setpriority(PRIO_PROCESS, 0, 19) == 0) {
+        std::cout << "- Priority: nice 19" << std::endl;
+        return;
+    }
 
-                std::vector<FR_CRASH> fr_crashes = std::get<1>(it);
+    std::cerr << "Warning: could not lower the priority: " << strerror(errno) << std::endl;
+}
 
-                auto &bugs = merged_results.triage_gdb_result->bugs;
+// cmd, triage_folder, binary_folder, results, repeat);
 
-                if (bugs.count(bug) > 0) {
-                    bugs[bug].insert(bugs[bug].end(), fr_crashes.begin(), fr_crashes.end());
+size_t measure_baseline_ms(std::string cmd_split1, std::string cmd_split2, const std::vector<std::filesystem::path> &crashes) {
 
-                } else {
-                    bugs.insert({bug, {fr_crashes}});
-                }
-            }
-        }
+    // Nothing to measure yet (follow mode on an empty campaign)
+    if (crashes.empty()) {
+        return TRIAGE_MAX_TIMEOUT_MS / TRIAGE_TIMEOUT_FACTOR;
+    }
 
-    } else if (parser == "MALLOC") {
+    size_t baseline_ms = 0;
 
-        if (merged_results.triage_malloc_result == nullptr) {
-            merged_results.triage_malloc_result = new TRIAGE_MALLOC_RESULT();
-        }
+    for (size_t i = 0; i < std::min<size_t>(crashes.size(), 3); i++) {
 
-        for (size_t i = 0; i < num_threads; ++i) {
+        std::string cmd = cmd_split1 + " " + bash_escape(crashes[i].string()) + cmd_split2;
 
-            for (FR_CRASH &crash : triage_results[i].triage_malloc_result->detected) {
+        auto begin = std::chrono::steady_clock::now();
 
-                merged_results.triage_malloc_result->detected.push_back(crash);
-            }
-        }
+        run(cmd, TRIAGE_MAX_TIMEOUT_MS);
+
+        baseline_ms = std::max<size_t>(baseline_ms,
+                                       std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count());
     }
 
-    // return merged_results;
+    return baseline_ms;
 }
 
-// cmd, triage_folder, binary_folder, results, repeat);
+// Set by SIGINT in follow mode
+static volatile sig_atomic_t follow_interrupted = 0;
 
-void triage(std::string parser, std::vector<std::filesystem::path> crashes_folders, size_t repeat, const FRglobal &ctx) {
+static void stop_following(int) { follow_interrupted = 1; }
+
+void triage(std::string parser, std::vector<std::filesystem::path> crashes_folders, size_t repeat, const FRglobal &ctx, bool resume,
+            size_t top_frames, bool follow, bool minimize) {
 
     std::filesystem::path triage_folder;
 
@@ -1737,6 +4153,10 @@ void triage(std::string parser, std::vector<std::filesystem::path> crashes_folde
         triage_folder = "__COV";
     } else if (parser == "MALLOC") {
         triage_folder = "__COV";
+    } else if (parser == "COV") {
+        triage_folder = "__COV";
+    } else if (parser == "HANG") {
+        triage_folder = "__COV";
     }
 
     if (parser == "ASAN") {
@@ -1747,9 +4167,19 @@ void triage(std::string parser, std::vector<std::filesystem::path> crashes_folde
         std::cout << " /*/*/* PARSER = GDB *\\*\\*\\" << std::endl;
     } else if (parser == "MALLOC") {
         std::cout << " /*/*/* PARSER = MALLOC *\\*\\*\\" << std::endl;
+    } else if (parser == "COV") {
+        std::cout << " /*/*/* PARSER = GDB + MALLOC *\\*\\*\\" << std::endl;
+    } else if (parser == "HANG") {
+        std::cout << " /*/*/* PARSER = HANG *\\*\\*\\" << std::endl;
     }
     std::cout << std::endl;
 
+    // Hangs are profiled by the crash catcher, gdb can't sample the target
+    if (parser == "HANG" && !CRASH_CATCHER_SUPPORTED) {
+        std::cerr << "Error: the HANG parser is only available on x86-64" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
     std::filesystem::path binary_path = triage_folder / ctx.campaign->binary_rel_path;
 
     // TODO: Check if the binary is executable
@@ -1780,85 +4210,234 @@ void triage(std::string parser, std::vector<std::filesystem::path> crashes_folde
 
     auto begin = std::chrono::high_resolution_clock::now();
 
-    for (auto &folder : crashes_folders) {
+    // Check that numThreads is greater than 0
+    if (ctx.numThreads == 0) {
+        std::cerr << "Error: numThreads must be greater than 0" << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
-        std::cout << "Processing folder " << folder << " ..." << std::endl;
-        std::cout << std::endl;
+    TRIAGE_WATCHER watcher;
 
-        std::vector<std::filesystem::path> read_crashes = AFL_get_crashes(folder);
+    if (follow) {
 
-        // Check that numThreads is greater than 0
-        if (ctx.numThreads == 0) {
-            std::cerr << "Error: numThreads must be greater than 0" << std::endl;
+        // The fuzzers keep the CPU. The baseline below is measured under the same load, so the timeout accounts for it
+        lower_priority();
+
+        // Before listing the crashes, so that none lands in between unseen
+        if (!watcher.open(crashes_folders, parser == "HANG" ? "hangs" : "crashes")) {
             exit(EXIT_FAILURE);
         }
 
-        std::vector<std::vector<std::filesystem::path>> crashes(ctx.numThreads);
+        std::cout << std::endl;
+    }
+
+    TRIAGE_QUEUE queue;
+
+    for (auto &folder : crashes_folders) {
+
+        std::vector<std::filesystem::path> read_crashes = parser == "HANG" ? AFL_get_hangs(folder) : AFL_get_crashes(folder);
+
+        std::cout << "- Folder " << folder << ": " << read_crashes.size() << (parser == "HANG" ? " hangs" : " crashes") << std::endl;
+
+        queue.crashes.insert(queue.crashes.end(), read_crashes.begin(), read_crashes.end());
+    }
+
+    std::cout << std::endl;
+
+    total_crashes = queue.crashes.size();
+
+    // Follow mode: every crash file triaged so far
+    std::unordered_set<std::filesystem::path> seen;
+
+    if (follow) {
+        seen.insert(queue.crashes.begin(), queue.crashes.end());
+    }
+
+    // AFL++ instances sync crashes between them: most files are byte-identical copies
+    CRASH_DUPLICATES duplicates;
+
+    std::vector<std::optional<CRASH_KEY>> keys;
+
+    std::vector<std::filesystem::path> unique_crashes = dedupe_crashes(queue.crashes, ctx.numThreads, duplicates, keys);
+
+    std::cout << "- Unique crashes: " << unique_crashes.size() << " / " << total_crashes << std::endl;
+
+    // Crashes triaged by previous runs against the same binary are not executed again
+    std::string binary_key = read_build_id(binary_path);
+
+    if (binary_key == "") {
+        uint64_t binary_hash = 0;
+        hash_file(binary_path, binary_hash);
+        binary_key = std::format("{:016x}", binary_hash);
+    }
+
+    // Bugs bucketed on another number of frames don't compare
+    binary_key += "/frames:" + std::to_string(top_frames);
+
+    std::filesystem::path journal_folder = ctx.campaign->campaign_path / "triage";
+
+    if (!resume) {
+        std::filesystem::remove(journal_folder / (parser + ".journal"));
+        std::filesystem::remove(journal_folder / (parser + ".reports"));
+    }
+
+    TRIAGE_JOURNAL journal;
 
-        // Fill the array with the crashes from config.crashes
-        size_t i = 0;
-        for (auto &crash : read_crashes) {
-            crashes[i].push_back(crash);
-            i = (i + 1) % ctx.numThreads;
+    if (!journal.open(journal_folder, parser, binary_key)) {
+        exit(EXIT_FAILURE);
+    }
+
+    results.journal = &journal;
+
+    // Bugs of earlier campaigns, in the global DB
+    TRIAGE_KNOWN_BUGS known;
+    TRIAGE_KNOWN_BUGS *known_bugs = nullptr;
+
+    if (parser == "ASAN" && known.open(ctx.global_db, ctx.campaign->campaign_path.string())) {
+        known_bugs = &known;
+    }
+
+    TRIAGE_RESULT previous_results;
+
+    previous_results.triage_asan_result = new TRIAGE_ASAN_RESULT();
+    previous_results.triage_gdb_result = new TRIAGE_GDB_RESULT();
+    previous_results.triage_malloc_result = new TRIAGE_MALLOC_RESULT();
+    previous_results.triage_ubsan_result = new TRIAGE_UBSAN_RESULT();
+    previous_results.triage_hang_result = new TRIAGE_HANG_RESULT();
+
+    queue.crashes.clear();
+
+    for (size_t i = 0; i < unique_crashes.size(); i++) {
+
+        if (keys[i].has_value() && journal.contains(*keys[i])) {
+            journal.restore(*keys[i], unique_crashes[i], previous_results);
+
+        } else {
+            queue.crashes.push_back(unique_crashes[i]);
+            queue.keys.push_back(keys[i]);
         }
+    }
 
-        // std::vector<TRIAGE_RESULT> outputs(ctx.numThreads);
-        // std::vector<DUMPER_RESULT> dumper_outputs(ctx.numThreads);
+    std::cout << "- Already triaged: " << unique_crashes.size() - queue.crashes.size() << std::endl;
+    std::cout << std::endl;
 
-        std::string cmd_split1 = cmd;
-        std::string cmd_split2 = "";
+    std::string cmd_split1 = cmd;
+    std::string cmd_split2 = "";
 
-        size_t pos;
-        if ((pos = cmd.find(" @@")) != std::string::npos) {
-            cmd_split1 = cmd.substr(0, pos);
-            cmd_split2 = cmd.substr(pos + 3);
+    size_t pos;
+    if ((pos = cmd.find(" @@")) != std::string::npos) {
+        cmd_split1 = cmd.substr(0, pos);
+        cmd_split2 = cmd.substr(pos + 3);
+    }
+
+    if (putenv("ASAN_OPTIONS=symbolize=0") != 0) {
+        std::cerr << "Error: could not set symbolize=0" << std::endl;
+        exit(1);
+    }
+
+    if (parser == "UBSAN" && setenv("UBSAN_OPTIONS", UBSAN_TRIAGE_OPTIONS.c_str(), 1) != 0) {
+        std::cerr << "Error: could not set UBSAN_OPTIONS" << std::endl;
+        exit(1);
+    }
+
+    std::vector<std::filesystem::path> baseline_inputs = unique_crashes;
+
+    // A hang would run until the timeout, the normal execution time of the binary is measured on an empty input instead
+    std::filesystem::path empty_input = journal_folder / "baseline_input";
+
+    if (parser == "HANG") {
+        baseline_inputs.clear();
+
+        if (write_file(empty_input.string(), "")) {
+            baseline_inputs.push_back(empty_input);
         }
+    }
 
-        if (putenv("ASAN_OPTIONS=symbolize=0") != 0) {
-            std::cerr << "Error: could not set symbolize=0" << std::endl;
-            exit(1);
+    size_t baseline_ms = measure_baseline_ms(cmd_split1, cmd_split2, baseline_inputs);
+
+    std::filesystem::remove(empty_input);
+
+    queue.timeout_ms = std::clamp(baseline_ms * TRIAGE_TIMEOUT_FACTOR, TRIAGE_MIN_TIMEOUT_MS, TRIAGE_MAX_TIMEOUT_MS);
+
+    std::cout << "- Baseline execution time: " << baseline_ms << "ms, timeout: " << queue.timeout_ms << "ms" << std::endl;
+    std::cout << std::endl;
+
+    std::filesystem::path forkserver_shim = "";
+
+    if (ctx.use_forkserver) {
+
+        // GDB, COV and HANG run the target under ptrace
+        if (parser == "ASAN" || parser == "UBSAN" || parser == "MALLOC") {
+            forkserver_shim = build_forkserver_shim(ctx.FRFUZZ_PATH);
+        } else {
+            std::cout << "- The forkserver is not available for the " << parser << " parser" << std::endl << std::endl;
         }
+    }
 
-        std::vector<std::thread> threads;
+    // Each candidate would run for the whole timeout
+    if (minimize && parser == "HANG") {
+        std::cout << "- Hangs are not minimized" << std::endl << std::endl;
+        minimize = false;
+    }
+
+    // Candidates are checked under the crash catcher, there's no gdb fallback for them
+    if (minimize && (parser == "GDB" || parser == "COV") && !CRASH_CATCHER_SUPPORTED) {
+        std::cout << "- " << parser << " crashes are only minimized on x86-64" << std::endl << std::endl;
+        minimize = false;
+    }
+
+    std::vector<TRIAGE_WORKER_STATS> worker_stats(ctx.numThreads);
 
-        std::vector<TRIAGE_RESULT> triage_results(ctx.numThreads);
+    // Runs the crashes of batch and adds them to results, along with the restored ones and the copies of both
+    auto run_workers = [&](TRIAGE_QUEUE &batch, TRIAGE_RESULT &restored, const CRASH_DUPLICATES &batch_duplicates) {
+        TRIAGE_SHARED_RESULT shared_results;
+
+        shared_results.insert(restored);
+
+        delete restored.triage_asan_result;
+        delete restored.triage_gdb_result;
+        delete restored.triage_malloc_result;
+        delete restored.triage_ubsan_result;
+        delete restored.triage_hang_result;
+
+        std::vector<std::thread> threads;
 
         for (size_t i = 0; i < ctx.numThreads; ++i) {
 
-            threads.push_back(std::thread(triage_thread, i, std::cref(crashes[i]), cmd_split1, cmd_split2, triage_folder, binary_path.parent_path(),
-                                          std::ref(triage_results[i]), repeat, parser));
+            threads.push_back(std::thread(triage_thread, std::ref(batch), cmd_split1, cmd_split2, triage_folder, binary_path.parent_path(),
+                                          std::ref(shared_results), repeat, parser, std::ref(worker_stats[i]), forkserver_shim, std::ref(journal),
+                                          top_frames));
         }
 
         for (auto &th : threads) {
             th.join();
         }
 
-        /*
-        if (parser == "MALLOC") {
+        shared_results.drain(results, parser);
 
-            for (size_t i = 0; i < ctx.numThreads; ++i) {
+        attach_duplicates(results, batch_duplicates);
 
-                threads.push_back(std::thread(dumper_thread, i, std::cref(crashes[i]), cmd_split1, cmd_split2, triage_folder,
-        binary_path.parent_path(), std::ref(dumper_outputs[i]), repeat));
-            }
-
-        } else {
-
-            for (size_t i = 0; i < ctx.numThreads; ++i) {
-
-                threads.push_back(std::thread(triage_thread, i, std::cref(crashes[i]), cmd_split1, cmd_split2, triage_folder,
-        binary_path.parent_path(), std::ref(outputs[i]), repeat));
-            }
+        if (minimize) {
+            minimize_results(results, parser, cmd_split1, cmd_split2, triage_folder, binary_path.parent_path(), forkserver_shim, repeat,
+                             queue.timeout_ms, top_frames, ctx.numThreads, journal_folder / "minimized" / parser);
         }
-        */
+    };
 
-        merge_triage_results(results, triage_results, parser);
+    run_workers(queue, previous_results, duplicates);
 
-        total_crashes += read_crashes.size();
+    uint64_t wall_ms = std::max<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - begin).count(), 1);
 
-        std::cout << std::endl;
+    std::cout << std::endl;
+    std::cout << "Worker utilization:" << std::endl;
+
+    for (size_t i = 0; i < ctx.numThreads; ++i) {
+        std::cout << "- Worker " << i << ": " << worker_stats[i].crashes << " crashes, " << worker_stats[i].busy_ms / 1000 << "s busy ("
+                  << worker_stats[i].busy_ms * 100 / wall_ms << "%)" << std::endl;
     }
 
+    std::cout << std::endl;
+
     auto end = std::chrono::high_resolution_clock::now();
     uint64_t seconds = std::chrono::duration_cast<std::chrono::seconds>(end - begin).count();
 
@@ -1869,7 +4448,7 @@ void triage(std::string parser, std::vector<std::filesystem::path> crashes_folde
     if (parser == "ASAN") {
 
         // Now it's time to symbolize the results
-        symbolize_results(results, triage_folder);
+        symbolize_results(results, triage_folder, ctx.campaign->campaign_path / "symbols", ctx.numThreads, known_bugs);
     }
 
     // Display the summary
@@ -1886,6 +4465,8 @@ void triage(std::string parser, std::vector<std::filesystem::path> crashes_folde
 
         std::cout << "Unique bugs found: " << results.triage_asan_result->sym_bugs.size() << std::endl;
 
+        std::cout << "Known bugs from earlier campaigns: " << results.triage_asan_result->known.size() << std::endl;
+
         std::cout << std::endl;
 
         size_t bugged_files = 0;
@@ -1894,21 +4475,58 @@ void triage(std::string parser, std::vector<std::filesystem::path> crashes_folde
             bugged_files += bug.second.size();
         }
 
+        for (auto &bug : results.triage_asan_result->known) {
+            bugged_files += bug.second.size();
+        }
+
         std::cout << "Total bugged files: " << bugged_files << std::endl;
 
         std::cout << "Aborted: " << num_aborted << std::endl;
 
         std::cout << "Bugs + Aborted = " << bugged_files + num_aborted << std::endl;
 
+        size_t flaky = 0;
+
+        for (auto &bug : results.triage_asan_result->sym_bugs) {
+            flaky += std::count_if(bug.second.begin(), bug.second.end(), [](const FR_CRASH &crash) { return crash.attempts > 1; });
+        }
+
+        std::cout << "Flaky (reproduced after retries): " << flaky << std::endl;
+        std::cout << "Not reproduced in " << repeat << " runs: " << results.triage_asan_result->unknown.size() << std::endl;
+
     } else if (parser == "GDB") {
 
         std::cout << "Total crashes: " << total_crashes << std::endl;
 
         std::cout << "Total detections: " << results.triage_gdb_result->bugs.size() << std::endl;
 
+    } else if (parser == "UBSAN") {
+
+        std::cout << "Total crashes: " << total_crashes << std::endl;
+
+        std::cout << "Unique runtime errors: " << results.triage_ubsan_result->bugs.size() << std::endl;
+
+        std::cout << "Without runtime errors in " << repeat << " runs: " << results.triage_ubsan_result->unknown.size() << std::endl;
+
     } else if (parser == "MALLOC") {
 
         std::cout << "Total detections: " << results.triage_malloc_result->detected.size() << std::endl;
+
+    } else if (parser == "COV") {
+
+        std::cout << "Total crashes: " << total_crashes << std::endl;
+
+        std::cout << "GDB detections: " << results.triage_gdb_result->bugs.size() << std::endl;
+
+        std::cout << "MALLOC detections: " << results.triage_malloc_result->detected.size() << std::endl;
+
+    } else if (parser == "HANG") {
+
+        std::cout << "Total hangs: " << total_crashes << std::endl;
+
+        std::cout << "Unique hot loops: " << results.triage_hang_result->bugs.size() << std::endl;
+
+        std::cout << "Did not hang in " << repeat << " runs: " << results.triage_hang_result->unknown.size() << std::endl;
     }
 
     // Write an HTML summary
@@ -1922,6 +4540,10 @@ void triage(std::string parser, std::vector<std::filesystem::path> crashes_folde
         summary_path /= "summary__gdb.html";
     } else if (parser == "MALLOC") {
         summary_path /= "summary__malloc.html";
+    } else if (parser == "COV") {
+        summary_path /= "summary__cov.html";
+    } else if (parser == "HANG") {
+        summary_path /= "summary__hang.html";
     }
     if (std::filesystem::exists(summary_path)) {
         summary_path = summary_path.string().erase(summary_path.string().size() - 5, 5);
@@ -1930,19 +4552,9 @@ void triage(std::string parser, std::vector<std::filesystem::path> crashes_folde
         summary_path += ".html";
     }
 
-    std::ofstream file;
-
-    file.open(summary_path);
-
-    std::string html_summary;
-
-    html_summary = triage_summary(results, crashes_folders, total_crashes, parser);
-
-    //}
-
-    file << html_summary;
-
-    file.close();
+    if (!triage_summary(summary_path, results, crashes_folders, total_crashes, parser)) {
+        exit(EXIT_FAILURE);
+    }
 
     std::cout << std::endl;
 
@@ -1957,7 +4569,110 @@ void triage(std::string parser, std::vector<std::filesystem::path> crashes_folde
 
     } else if (parser == "MALLOC") {
         std::cout << "- MALLOC summary written to " << summary_path << std::endl;
+
+    } else if (parser == "COV") {
+        std::cout << "- GDB + MALLOC summary written to " << summary_path << std::endl;
+
+    } else if (parser == "HANG") {
+        std::cout << "- HANG summary written to " << summary_path << std::endl;
+    }
+
+    std::cout << std::endl;
+
+    if (!follow) {
+        return;
+    }
+
+    follow_interrupted = 0;
+    signal(SIGINT, stop_following);
+
+    std::cout << "Following the crashes folders, Ctrl+C to stop..." << std::endl;
+    std::cout << std::endl;
+
+    std::vector<std::filesystem::path> pending;
+
+    auto first_pending = std::chrono::steady_clock::now();
+
+    while (!follow_interrupted) {
+
+        size_t landed = 0;
+
+        for (auto &crash : watcher.wait(pending.empty() ? TRIAGE_FOLLOW_MAX_WAIT_MS : TRIAGE_FOLLOW_SETTLE_MS)) {
+
+            if (seen.insert(crash).second) {
+
+                if (pending.empty()) {
+                    first_pending = std::chrono::steady_clock::now();
+                }
+
+                pending.push_back(crash);
+                landed++;
+            }
+        }
+
+        // Crashes still landing are waited for, up to TRIAGE_FOLLOW_MAX_WAIT_MS. Those pending on SIGINT are left to the next run
+        if (follow_interrupted || pending.empty() ||
+            (landed > 0 && std::chrono::steady_clock::now() - first_pending < std::chrono::milliseconds(TRIAGE_FOLLOW_MAX_WAIT_MS))) {
+            continue;
+        }
+
+        total_crashes += pending.size();
+
+        CRASH_DUPLICATES batch_duplicates;
+
+        std::vector<std::optional<CRASH_KEY>> batch_keys;
+
+        std::vector<std::filesystem::path> batch_unique = dedupe_crashes(pending, ctx.numThreads, batch_duplicates, batch_keys);
+
+        TRIAGE_QUEUE batch;
+
+        batch.timeout_ms = queue.timeout_ms;
+
+        TRIAGE_RESULT restored;
+
+        restored.triage_asan_result = new TRIAGE_ASAN_RESULT();
+        restored.triage_gdb_result = new TRIAGE_GDB_RESULT();
+        restored.triage_malloc_result = new TRIAGE_MALLOC_RESULT();
+        restored.triage_ubsan_result = new TRIAGE_UBSAN_RESULT();
+        restored.triage_hang_result = new TRIAGE_HANG_RESULT();
+
+        for (size_t i = 0; i < batch_unique.size(); i++) {
+
+            if (batch_keys[i].has_value() && journal.contains(*batch_keys[i])) {
+                journal.restore(*batch_keys[i], batch_unique[i], restored);
+
+            } else {
+                batch.crashes.push_back(batch_unique[i]);
+                batch.keys.push_back(batch_keys[i]);
+            }
+        }
+
+        size_t num_new = batch.crashes.size();
+
+        run_workers(batch, restored, batch_duplicates);
+
+        if (parser == "ASAN") {
+
+            // Rebuilt from all the bugs, the symbols cache makes it cheap
+            results.triage_asan_result->sym_bugs.clear();
+            results.triage_asan_result->known.clear();
+            results.triage_asan_result->first_seen.clear();
+            symbolize_results(results, triage_folder, ctx.campaign->campaign_path / "symbols", ctx.numThreads, known_bugs);
+        }
+
+        if (!triage_summary(summary_path, results, crashes_folders, total_crashes, parser)) {
+            exit(EXIT_FAILURE);
+        }
+
+        std::cout << "- " << pending.size() << " new crashes: " << batch_unique.size() << " unique, " << num_new << " triaged. Summary updated"
+                  << std::endl;
+
+        pending.clear();
     }
 
+    signal(SIGINT, SIG_DFL);
+
+    std::cout << std::endl;
+    std::cout << "- Stopped following, " << total_crashes << " crashes in " << summary_path << std::endl;
     std::cout << std::endl;
 }
\ No newline at end of file
@@ -1,17 +1,44 @@
 /* SPDX-License-Identifier: AGPL-3.0-only */
 #pragma once
 
+#include <poll.h>
+#include <sched.h>
+#include <sys/inotify.h>
+#include <zlib.h>
+
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
 #include <filesystem>
+#include <format>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <regex>
+#include <set>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "fuzzer/engines/afl.h"
 #include "global.h"
+#include "grmELF/symbolizer.h"
+#include "utils/crash_catcher.h"
+#include "utils/forkserver.h"
+#include "utils/minimizer.h"
+#include "utils/pattern_matcher.h"
 #include "utils/process.h"
 #include "utils/utils.h"
 
@@ -35,6 +62,13 @@ enum class BUG_TYPE {
     STACK_OVERFLOW,              //" stack-overflow "
     NEGATIVE_SIZE,               //" negative-size-param "
     INVALID_FREE,                //" attempting free on address which was not malloc "
+    DOUBLE_FREE,                 //" attempting double-free "
+    ALLOC_DEALLOC_MISMATCH,      //" alloc-dealloc-mismatch "
+    USE_AFTER_RETURN,            //" stack-use-after-return "
+    USE_AFTER_SCOPE,             //" stack-use-after-scope "
+    PARAM_OVERLAP,               //" memcpy-param-overlap "
+    UNINITIALIZED_VALUE,         //" use-of-uninitialized-value "
+    DATA_RACE,                   //" data race "
     UNKNOWN                      //" unknown crash"
 };
 
@@ -81,38 +115,35 @@ template <> struct std::hash<FR_BUG> {
 
 const size_t MAX_STACK_DEPTH = 8;
 
+// 128-bit hash of everything that identifies a bug, computed once when the bug is parsed. The low half is the std::hash of the bug, the
+// high half picks its TRIAGE_BUCKETS shard
+struct STACK_SIGNATURE {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const STACK_SIGNATURE &) const = default;
+};
+
+// Second xxhash64 seed, for the high half
+const uint64_t STACK_SIGNATURE_SEED = 0x9e3779b97f4a7c15ULL;
+
 struct FR_NOSYM_BUG {
     SANITIZER sanitizer = SANITIZER::NONE;
     BUG_TYPE type = BUG_TYPE::UNKNOWN;
 
-    // file, address
+    // file, address. Only the top frames the bugs are bucketed on are filled in
     std::tuple<std::filesystem::path, uint64_t> stack_trace[MAX_STACK_DEPTH];
 
-    // std::array<std::string, MAX_STACK_DEPTH> stack_trace;
+    STACK_SIGNATURE signature;
 
-    // std::filesystem::path file = "";
-    // uint64_t address;
+    // Fills signature. Call it once the fields above are set
+    void sign();
 
-    bool operator==(const FR_NOSYM_BUG &) const = default; // since C++20
+    bool operator==(const FR_NOSYM_BUG &other) const { return signature == other.signature; }
 };
 
 template <> struct std::hash<FR_NOSYM_BUG> {
-    std::size_t operator()(const FR_NOSYM_BUG &s) const noexcept {
-        std::size_t h1 = std::hash<SANITIZER>{}(s.sanitizer);
-        std::size_t h2 = std::hash<BUG_TYPE>{}(s.type);
-
-        std::string stack_trace_str = "";
-
-        for (size_t i = 0; i < MAX_STACK_DEPTH; i++) {
-            stack_trace_str += std::get<0>(s.stack_trace[i]).string() + ":";
-            stack_trace_str += std::to_string(std::get<1>(s.stack_trace[i])) + "__";
-        }
-
-        std::size_t h3 = std::hash<std::filesystem::path>{}(stack_trace_str);
-
-        // return h1 ^ (h2 << 1); // or use boost::hash_combine
-        return h1 ^ (h2 << 1) ^ (h3 << 1);
-    }
+    std::size_t operator()(const FR_NOSYM_BUG &s) const noexcept { return s.signature.low; }
 };
 
 struct GDB_BUG {
@@ -121,30 +152,80 @@ struct GDB_BUG {
     std::string gdb_file;
     std::size_t gdb_line;
 
-    bool operator==(const GDB_BUG &) const = default; // since C++20
+    STACK_SIGNATURE signature;
+
+    void sign();
+
+    bool operator==(const GDB_BUG &other) const { return signature == other.signature; }
 };
 
 template <> struct std::hash<GDB_BUG> {
-    std::size_t operator()(const GDB_BUG &s) const noexcept {
+    std::size_t operator()(const GDB_BUG &s) const noexcept { return s.signature.low; }
+};
 
-        std::size_t h1 = std::hash<std::string>{}(s.gdb_func);
+// UBSAN runtime error: the check that fired and where. Location is what the report gives when it has no file:line:column, like
+// "(binary+0x1234)" for a deadly signal
+struct UBSAN_BUG {
+    std::string check; // "signed-integer-overflow", "SEGV"...
+    std::string file;
+    std::size_t line = 0;
+    std::size_t column = 0;
 
-        std::size_t h2 = std::hash<std::string>{}(s.gdb_arg);
+    STACK_SIGNATURE signature;
 
-        std::size_t h3 = std::hash<std::string>{}(s.gdb_file);
+    void sign();
 
-        std::size_t h4 = std::hash<std::size_t>{}(s.gdb_line);
+    bool operator==(const UBSAN_BUG &other) const { return signature == other.signature; }
+};
 
-        // return h1 ^ (h2 << 1); // or use boost::hash_combine
-        return h1 ^ (h2 << 1) ^ (h3 << 1) ^ (h4 << 1);
-    }
+template <> struct std::hash<UBSAN_BUG> {
+    std::size_t operator()(const UBSAN_BUG &s) const noexcept { return s.signature.low; }
+};
+
+// Hang: where the target spins, the innermost function of its own code in most of the samples. Bucketed on that function, the line is the
+// hottest one of the first hang of the bucket
+struct HANG_BUG {
+    std::string module;
+    std::string function; // module+0x<offset> of the hottest address in it when there are no symbols
+    std::string file;
+    std::size_t line = 0;
+
+    STACK_SIGNATURE signature;
+
+    void sign();
+
+    bool operator==(const HANG_BUG &other) const { return signature == other.signature; }
+};
+
+template <> struct std::hash<HANG_BUG> {
+    std::size_t operator()(const HANG_BUG &s) const noexcept { return s.signature.low; }
+};
+
+struct FR_FRAME {
+    std::string function = "";
+    std::string file = "";
+    std::size_t line = 0;
+};
+
+// Object file path, <address, symbolized frame>
+typedef std::unordered_map<std::filesystem::path, std::unordered_map<uint64_t, FR_FRAME>> SYMBOL_TABLE;
+
+// Compressed crash report in the .reports file of a TRIAGE_JOURNAL
+struct REPORT_REF {
+    uint64_t offset = 0;
+    uint64_t size = 0;     // Compressed
+    uint64_t raw_size = 0; // 0: no report
 };
 
 struct FR_CRASH {
     std::filesystem::path crash_path;
     uint64_t oob_bytes = 0;
-    std::string description = "";
+    std::string description = ""; // Until the journal records the crash, then it's in report. See TRIAGE_RESULT::description()
+    REPORT_REF report;
     std::string malloc_msg;
+    uint64_t attempts = 1;  // Runs until it reproduced, or all of them if it never did
+    double flakiness = 0.0; // Share of those runs that did not reproduce it
+    std::filesystem::path minimized = ""; // Smallest reproducer of its bucket only: the minimized copy
 };
 
 struct TRIAGE_ASAN_RESULT {
@@ -152,6 +233,61 @@ struct TRIAGE_ASAN_RESULT {
     std::unordered_map<FR_BUG, std::vector<FR_CRASH>> sym_bugs;
     std::vector<FR_CRASH> aborted;
     std::vector<FR_CRASH> unknown;
+
+    // Bugs first found by another campaign, kept out of sym_bugs. See TRIAGE_KNOWN_BUGS
+    std::unordered_map<FR_BUG, std::vector<FR_CRASH>> known;
+    std::unordered_map<FR_BUG, std::string> first_seen; // Campaign of each known bug
+};
+
+// Bugs of every campaign, in the known_bugs table of the global DB. A bug is identified by the hash of its symbolized fields but the line,
+// which moves between versions of a project. known_bug_stacks maps the unsymbolized stacks seen so far to them: objects are identified by
+// build-id, so a known bug of a build triaged before is not symbolized again
+class TRIAGE_KNOWN_BUGS {
+
+  private:
+    struct KNOWN_BUG {
+        std::string function;
+        std::filesystem::path file;
+        std::string campaign; // First seen in
+    };
+
+    struct KNOWN_STACK {
+        std::string signature;
+        size_t line;
+    };
+
+    grDB *db = nullptr;
+
+    std::string campaign = "";
+    std::string date = "";
+
+    std::unordered_map<std::string, KNOWN_BUG> bugs;     // By signature
+    std::unordered_map<std::string, KNOWN_STACK> stacks; // By stack_key()
+
+    std::unordered_map<std::filesystem::path, std::string> object_keys;
+
+    // Not in the DB yet. See save()
+    data::TypedTable new_bugs;
+    data::TypedTable new_stacks;
+
+    std::string stack_key(const FR_NOSYM_BUG &bug);
+
+  public:
+    TRIAGE_KNOWN_BUGS() {}
+
+    // Loads the known bugs. false if there is no DB, nothing is looked up or recorded then
+    bool open(grDB *db, std::string campaign);
+
+    static std::string signature(const FR_BUG &bug);
+
+    // Symbolized bug of a stack seen before, without symbolizing it
+    std::optional<FR_BUG> lookup(const FR_NOSYM_BUG &bug);
+
+    // Records the bug and its stack if they are new. Returns the campaign that found it first when it's another one, "" otherwise
+    std::string learn(const FR_NOSYM_BUG &bug, const FR_BUG &sym_bug);
+
+    // Writes what learn() recorded
+    void save();
 };
 
 struct TRIAGE_GDB_RESULT {
@@ -162,6 +298,148 @@ struct TRIAGE_MALLOC_RESULT {
     std::vector<FR_CRASH> detected;
 };
 
+// glibc heap consistency errors. The first one in this order names the bug
+const std::string_view MALLOC_MESSAGES[] = {
+
+    "break adjusted to free malloc space",
+
+    "corrupted double-linked list",
+    "corrupted size vs. prev_size",
+
+    "double free or corruption",
+
+    "free(): corrupted unsorted chunks",
+    "free(): double free detected in tcache",
+    "free(): invalid next size (fast)",
+    "free(): invalid next size (normal)",
+    "free(): invalid pointer",
+    "free(): invalid size",
+    "free(): too many chunks detected in tcache",
+
+    "_int_memalign(): unaligned chunk detected",
+
+    "invalid chunk size",
+    "invalid fastbin entry",
+
+    "malloc(): corrupted unsorted chunks",
+    "malloc(): corrupted top size",
+    "malloc(): invalid next->prev_inuse",
+    "malloc(): invalid next size",
+    "malloc(): invalid size",
+    "malloc(): largebin double linked list corrupted",
+    "malloc(): memory corruption",
+    "malloc(): mismatching next->prev_size",
+    "malloc(): smallbin double linked list corrupted",
+    "malloc: top chunk is corrupt",
+    "malloc(): unaligned fastbin chunk detected",
+    "malloc(): unaligned tcache chunk detected",
+    "malloc(): unsorted double linked list corrupted",
+
+    "malloc_check_get_size: memory corruption",
+
+    "malloc_consolidate(): invalid chunk size",
+
+    "munmap_chunk(): invalid pointer",
+    "mremap_chunk(): invalid pointer",
+
+    "realloc(): invalid old size",
+    "realloc(): invalid next size",
+    "realloc(): invalid pointer",
+
+    "unaligned fastbin chunk detected",
+    "unaligned tcache chunk detected",
+
+    "Fatal glibc error: malloc.c",
+
+    "glibc error"
+
+};
+
+struct SANITIZER_HEADER {
+    std::string_view name;
+    SANITIZER sanitizer;
+};
+
+// MSAN and TSAN report as WARNING, the rest as ERROR
+const SANITIZER_HEADER SANITIZER_HEADERS[] = {
+    {"AddressSanitizer: ", SANITIZER::ASAN},
+    {"MemorySanitizer: ", SANITIZER::MSAN},
+    {"UndefinedBehaviorSanitizer: ", SANITIZER::UBSAN},
+    {"ThreadSanitizer: ", SANITIZER::TSAN},
+    {"Control Flow Integrity Sanitizer: ", SANITIZER::CFISAN},
+};
+
+// Signals of a gdb report. SIGSEGV first, wherever the SIGABRT is
+const std::string_view GDB_SIGNALS[] = {"SIGSEGV", "SIGABRT"};
+
+// One run of an input can land in several buckets, one per distinct runtime error
+struct TRIAGE_UBSAN_RESULT {
+    std::unordered_map<UBSAN_BUG, std::vector<FR_CRASH>> bugs;
+    std::vector<FR_CRASH> unknown; // No report in any of the runs
+};
+
+struct TRIAGE_HANG_RESULT {
+    std::unordered_map<HANG_BUG, std::vector<FR_CRASH>> bugs;
+    std::vector<FR_CRASH> unknown; // Finished before the timeout in every run
+};
+
+// Hangs are profiled for the whole timeout, one sample every HANG_SAMPLE_INTERVAL_US or less often so that a run takes HANG_MAX_SAMPLES
+// at most. Fewer than HANG_MIN_SAMPLES don't make a profile
+const size_t HANG_SAMPLE_INTERVAL_US = 1000;
+const size_t HANG_MAX_SAMPLES = 2000;
+const size_t HANG_MIN_SAMPLES = 20;
+
+// Share of the samples a function must be in to hold the hot loop, the callees that take part of its time are below it
+const double HANG_LOOP_SHARE = 0.8;
+
+// Hottest addresses listed in the report of a hang
+const size_t HANG_TOP_ADDRESSES = 10;
+
+// Identity of a crash input: size and xxhash64 of its contents
+struct CRASH_KEY {
+    uintmax_t size = 0;
+    uint64_t hash = 0;
+
+    auto operator<=>(const CRASH_KEY &) const = default;
+};
+
+// Bounds of the per-run timeout, which is derived from the baseline execution time of the binary
+const size_t TRIAGE_MIN_TIMEOUT_MS = 1000;
+const size_t TRIAGE_MAX_TIMEOUT_MS = 60000;
+const size_t TRIAGE_TIMEOUT_FACTOR = 20;
+
+// One run of a crash. A run that does not reproduce it goes back to the queue as the next attempt, so any idle worker can retry it
+struct TRIAGE_TASK {
+    size_t index = 0; // In TRIAGE_QUEUE::crashes
+    size_t attempt = 0;
+    size_t timeout_ms = TRIAGE_MAX_TIMEOUT_MS;
+};
+
+// Crashes of all the folders. Workers pop the next one until the queue is drained, so a slow crash only holds its own worker
+struct TRIAGE_QUEUE {
+    std::vector<std::filesystem::path> crashes;
+    std::vector<std::optional<CRASH_KEY>> keys; // Same order as crashes. nullopt for unreadable files, which are not journaled
+    size_t next = 0;
+
+    size_t timeout_ms = TRIAGE_MAX_TIMEOUT_MS; // Of the first attempt, doubled on every retry
+
+    std::deque<TRIAGE_TASK> retries;
+    size_t pending = 0; // Crashes being run or waiting for a retry
+
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+// Representative crash, byte-identical copies of it
+typedef std::unordered_map<std::filesystem::path, std::vector<std::filesystem::path>> CRASH_DUPLICATES;
+
+struct TRIAGE_WORKER_STATS {
+    size_t crashes = 0;
+    uint64_t busy_ms = 0; // Time spent triaging crashes, as opposed to waiting
+};
+
+class TRIAGE_JOURNAL;
+
 struct TRIAGE_RESULT {
 
     std::string parser = "";
@@ -169,6 +447,181 @@ struct TRIAGE_RESULT {
     TRIAGE_ASAN_RESULT *triage_asan_result = nullptr;
     TRIAGE_GDB_RESULT *triage_gdb_result = nullptr;
     TRIAGE_MALLOC_RESULT *triage_malloc_result = nullptr;
+    TRIAGE_UBSAN_RESULT *triage_ubsan_result = nullptr;
+    TRIAGE_HANG_RESULT *triage_hang_result = nullptr;
+
+    // Holds the reports of the crashes it recorded
+    const TRIAGE_JOURNAL *journal = nullptr;
+
+    // Report of crash, read back from the journal if it's been moved there
+    std::string description(const FR_CRASH &crash) const;
+};
+
+// Shards of TRIAGE_BUCKETS, each with its own lock
+const size_t TRIAGE_SHARDS = 64;
+
+// Bug -> crashes map shared by all the triage workers, which insert into it directly. Two workers only wait on each other when their
+// bugs land in the same shard, and a bug is hashed by reading its signature.
+template <typename BUG> class TRIAGE_BUCKETS {
+
+  private:
+    struct SHARD {
+        std::mutex mutex;
+        std::unordered_map<BUG, std::vector<FR_CRASH>> bugs;
+    };
+
+    std::array<SHARD, TRIAGE_SHARDS> shards;
+
+  public:
+    TRIAGE_BUCKETS() {}
+
+    void insert(const BUG &bug, std::vector<FR_CRASH> &&crashes) {
+
+        SHARD &shard = shards[bug.signature.high % TRIAGE_SHARDS];
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        std::vector<FR_CRASH> &bucket = shard.bugs[bug];
+
+        if (bucket.empty()) {
+            bucket = std::move(crashes);
+        } else {
+            bucket.insert(bucket.end(), std::make_move_iterator(crashes.begin()), std::make_move_iterator(crashes.end()));
+        }
+    }
+
+    // Moves every bucket to bugs, after the crashes bugs already has. Only once the workers are done
+    void drain(std::unordered_map<BUG, std::vector<FR_CRASH>> &bugs) {
+
+        for (SHARD &shard : shards) {
+
+            for (auto &[bug, crashes] : shard.bugs) {
+
+                std::vector<FR_CRASH> &bucket = bugs[bug];
+
+                if (bucket.empty()) {
+                    bucket = std::move(crashes);
+                } else {
+                    bucket.insert(bucket.end(), std::make_move_iterator(crashes.begin()), std::make_move_iterator(crashes.end()));
+                }
+            }
+
+            shard.bugs.clear();
+        }
+    }
+};
+
+// Results of a whole triage run, filled by all the workers at once
+struct TRIAGE_SHARED_RESULT {
+
+    TRIAGE_BUCKETS<FR_NOSYM_BUG> asan_bugs;
+    TRIAGE_BUCKETS<GDB_BUG> gdb_bugs;
+    TRIAGE_BUCKETS<UBSAN_BUG> ubsan_bugs;
+    TRIAGE_BUCKETS<HANG_BUG> hang_bugs;
+
+    // Not bucketed, one lock for all of them
+    std::mutex mutex;
+    std::vector<FR_CRASH> asan_aborted;
+    std::vector<FR_CRASH> asan_unknown;
+    std::vector<FR_CRASH> malloc_detected;
+    std::vector<FR_CRASH> ubsan_unknown;
+    std::vector<FR_CRASH> hang_unknown;
+
+    // Moves the contents of result in. Thread-safe
+    void insert(TRIAGE_RESULT &result);
+
+    // Adds everything to the results of parser. Only once the workers are done
+    void drain(TRIAGE_RESULT &results, std::string parser);
+};
+
+// Where a triaged crash ended up. COV records can be in a GDB and a MALLOC bucket at once
+enum class JOURNAL_BUCKET : uint8_t {
+    NONE,
+    ASAN_BUG,
+    ASAN_ABORTED,
+    ASAN_UNKNOWN,
+    GDB_BUG,
+    MALLOC_DETECTED,
+    UBSAN_BUG,
+    UBSAN_UNKNOWN,
+    HANG_BUG,
+    HANG_UNKNOWN
+};
+
+// zlib level of the reports, they are written by the workers as crashes are triaged
+const int JOURNAL_REPORT_LEVEL = 1;
+
+// Persistent record of the crashes already triaged with a parser against a given binary, so re-runs only execute new crashes and
+// interrupted runs resume. <parser>.journal holds one record per crash. The reports are compressed one by one and appended to
+// <parser>.reports, the records keep where: reports are the bulk of a triage run, so they stay on disk and are read back when the summary
+// is written.
+class TRIAGE_JOURNAL {
+
+  private:
+    std::string parser;
+
+    int journal_fd = -1;
+    int reports_fd = -1;
+
+    uint64_t reports_size = 0;
+
+    // Record of each crash key, as stored in the journal
+    std::map<CRASH_KEY, std::string> records;
+
+    std::mutex mutex;
+
+  public:
+    TRIAGE_JOURNAL() {}
+
+    ~TRIAGE_JOURNAL() { close(); }
+
+    // binary_key identifies the build being triaged. A journal written against another build is discarded
+    bool open(std::filesystem::path folder, std::string parser, std::string binary_key);
+
+    void close();
+
+    inline size_t size() const { return records.size(); }
+
+    inline bool contains(const CRASH_KEY &key) const { return records.contains(key); }
+
+    // Adds the recorded result of key to results, as crash_path
+    void restore(const CRASH_KEY &key, const std::filesystem::path &crash_path, TRIAGE_RESULT &results) const;
+
+    // Records the result of a single crash. The reports move out of result to the journal. Thread-safe
+    void append(const CRASH_KEY &key, TRIAGE_RESULT &result);
+
+    // Thread-safe
+    std::string read_report(const REPORT_REF &report) const;
+};
+
+// Rows shown at once by each table of the HTML summary
+const size_t SUMMARY_ROWS_PER_PAGE = 100;
+
+// A chunk is written as soon as it reaches either limit
+const size_t SUMMARY_CHUNK_ENTRIES = 256;
+const size_t SUMMARY_CHUNK_BYTES = 1 << 20;
+
+// Crash reports of an HTML summary. They go to a folder next to the page in chunk_<n>.js files, each one a JSON array wrapped in a
+// frfuzz_chunk(n, [...]) call, and the page loads a chunk when one of its reports is expanded. Only the current chunk is kept in memory.
+class SUMMARY_DETAILS {
+
+  private:
+    std::filesystem::path folder;
+
+    std::string chunk;
+    size_t chunk_id = 0;
+    size_t entries = 0;
+
+  public:
+    SUMMARY_DETAILS() {}
+
+    // Previous contents of folder are removed
+    bool open(std::filesystem::path folder);
+
+    // Returns the <details> placeholder of description for the page
+    std::string add(const std::string &description);
+
+    void flush();
 };
 
 /*
@@ -194,21 +647,111 @@ struct std::hash<FR_BUG>
 };
 */
 
-std::optional<std::tuple<FR_NOSYM_BUG, FR_CRASH>> parse_sanitizer_output_NOSYM(std::string output, const std::filesystem::path triage_folder,
-                                                                               const std::filesystem::path binary_folder);
+// Single forward pass over the report, the only copy made is the description of the returned crash. Bugs are bucketed on their top_frames
+// innermost frames
+std::optional<std::tuple<FR_NOSYM_BUG, FR_CRASH>> parse_sanitizer_output_NOSYM(std::string_view output, const std::filesystem::path triage_folder,
+                                                                               const std::filesystem::path binary_folder,
+                                                                               size_t top_frames = MAX_STACK_DEPTH);
+
+// UBSAN runs go on after a runtime error and name the check in the SUMMARY line, so one run reports all the errors an input triggers
+const std::string UBSAN_TRIAGE_OPTIONS = "halt_on_error=0:report_error_type=1:print_summary=1:symbolize=0";
+
+// Every runtime error of a run, in order. The runtime reports each source location once per run
+std::vector<std::tuple<UBSAN_BUG, FR_CRASH>> parse_ubsan_output(std::string_view output, const std::filesystem::path binary_folder);
 
 std::optional<std::tuple<FR_BUG, FR_CRASH>> parse_sanitizer_output(std::string output, const std::filesystem::path triage_folder,
                                                                    const std::filesystem::path binary_folder);
 
-void merge_triage_results(TRIAGE_RESULT &merged_results, const std::vector<TRIAGE_RESULT> &triage_results, std::string parser);
+// One representative per unique content, and its key. The rest go to duplicates. Unreadable files have no key and are never duplicates
+std::vector<std::filesystem::path> dedupe_crashes(const std::vector<std::filesystem::path> &crashes, size_t num_threads, CRASH_DUPLICATES &duplicates,
+                                                  std::vector<std::optional<CRASH_KEY>> &keys);
+
+// Every copy goes to the same bucket as its representative
+void attach_duplicates(TRIAGE_RESULT &results, const CRASH_DUPLICATES &duplicates);
+
+// Crashes that do not reproduce are retried up to repeat times in total. forkserver_shim = "" runs every crash in a new process.
+// Each triaged crash is recorded in journal and goes straight to results
+void triage_thread(TRIAGE_QUEUE &queue, std::string cmd_split1, std::string cmd_split2, const std::filesystem::path triage_folder,
+                   const std::filesystem::path binary_folder, TRIAGE_SHARED_RESULT &results, size_t repeat, std::string parser_str,
+                   TRIAGE_WORKER_STATS &stats, std::filesystem::path forkserver_shim, TRIAGE_JOURNAL &journal, size_t top_frames);
+
+// Follow mode: crashes landing within TRIAGE_FOLLOW_SETTLE_MS of each other are triaged together, AFL++ instances often find the same bug
+// at once. A steady stream of crashes is still triaged every TRIAGE_FOLLOW_MAX_WAIT_MS
+const int TRIAGE_FOLLOW_SETTLE_MS = 2000;
+const int TRIAGE_FOLLOW_MAX_WAIT_MS = 30000;
+
+// inotify watches on the crashes/ (or hangs/) folders under some folders, including those of the AFL++ instances started afterwards. Like
+// AFL_get_crashes, but only TRIAGE_WATCH_DEPTH levels deep and the queues are not watched
+const size_t TRIAGE_WATCH_DEPTH = 3;
+
+class TRIAGE_WATCHER {
+
+  private:
+    int fd = -1;
+
+    // Name of the folders the crashes are in
+    std::string findings = "crashes";
+
+    // Watch descriptor -> folder, depth
+    std::unordered_map<int, std::pair<std::filesystem::path, size_t>> watches;
+
+    // Crashes already in the crashes/ folders that appeared after open()
+    std::vector<std::filesystem::path> found;
+
+    // existing = true also reports the crashes already in the crashes/ folders found
+    void watch(const std::filesystem::path &folder, size_t depth, bool existing);
+
+    void list_crashes(const std::filesystem::path &folder);
+
+  public:
+    TRIAGE_WATCHER() {}
+    ~TRIAGE_WATCHER();
+
+    // The crashes already there are not reported. findings = "hangs" follows the hangs instead
+    bool open(const std::vector<std::filesystem::path> &folders, std::string findings = "crashes");
+
+    // Crashes written since the last call. Waits up to timeout_ms for one, returns nothing on timeout or if a signal came first
+    std::vector<std::filesystem::path> wait(int timeout_ms);
+};
+
+// The calling thread and everything it starts afterwards, threads and targets, only get the CPU time the fuzzers leave: SCHED_IDLE, or
+// the lowest nice value where that's not allowed
+void lower_priority();
+
+// Bucket a reproducer is minimized against, and the crash that gets the result
+struct MINIMIZE_TARGET {
+    JOURNAL_BUCKET bucket; // ASAN_BUG, GDB_BUG, MALLOC_DETECTED or UBSAN_BUG
+    STACK_SIGNATURE signature;
+    std::string malloc_msg = "";
+    FR_CRASH *crash;
+};
+
+// Candidates go to input, the forkserver (ASAN, UBSAN and MALLOC) and the crash catcher (GDB and COV) are kept between them
+struct MINIMIZE_WORKER {
+    std::filesystem::path input;
+    forkserver fsrv;
+    crash_catcher catcher;
+};
+
+// Minimizes the smallest reproducer of each bucket with ddmin, using the bucket itself as the oracle: a candidate must still land in it, not
+// merely crash. The candidates of a round run on num_threads workers, each up to as many times as the original needed to reproduce (at most
+// repeat). Results are kept in folder and reused while they reproduce. Buckets that already have a minimized crash are skipped
+void minimize_results(TRIAGE_RESULT &results, std::string parser, std::string cmd_split1, std::string cmd_split2,
+                      const std::filesystem::path triage_folder, const std::filesystem::path binary_folder, std::filesystem::path forkserver_shim,
+                      size_t repeat, size_t timeout_ms, size_t top_frames, size_t num_threads, const std::filesystem::path folder);
 
-void triage_thread(size_t thread_id, const std::vector<std::filesystem::path> &crashes, std::string cmd_split1, std::string cmd_split2,
-                   const std::filesystem::path triage_folder, const std::filesystem::path binary_folder, TRIAGE_RESULT &results, size_t repeat,
-                   std::string parser_str);
+// Slowest run of the binary on the first few crash inputs. Most targets reject an empty input long before they'd reach a crash
+size_t measure_baseline_ms(std::string cmd_split1, std::string cmd_split2, const std::vector<std::filesystem::path> &crashes);
 
-std::string triage_summary(TRIAGE_RESULT &results, const std::vector<std::filesystem::path> &crashes_folders, size_t total_crashes,
-                           std::string parser);
+// Writes the HTML report to summary_path as it goes. Crash reports are kept out of the page, see SUMMARY_DETAILS
+bool triage_summary(const std::filesystem::path &summary_path, TRIAGE_RESULT &results, const std::vector<std::filesystem::path> &crashes_folders,
+                    size_t total_crashes, std::string parser);
 
-void symbolize_results(TRIAGE_RESULT &results, std::filesystem::path triage_folder);
+// known != nullptr moves the bugs of earlier campaigns to TRIAGE_ASAN_RESULT::known, the stacks it already knows are not symbolized
+void symbolize_results(TRIAGE_RESULT &results, std::filesystem::path triage_folder, std::filesystem::path cache_folder, size_t num_threads,
+                       TRIAGE_KNOWN_BUGS *known = nullptr);
 
-void triage(std::string parser, std::vector<std::filesystem::path> crashes_folders, size_t repeat, const FRglobal &ctx);
+// resume = false discards the results of previous runs. Sanitizer bugs are bucketed on their top_frames innermost frames. follow = true keeps
+// triaging the new crashes at idle priority and updating the summary until SIGINT. minimize = true minimizes a reproducer of each bug
+void triage(std::string parser, std::vector<std::filesystem::path> crashes_folders, size_t repeat, const FRglobal &ctx, bool resume = true,
+            size_t top_frames = MAX_STACK_DEPTH, bool follow = false, bool minimize = false);
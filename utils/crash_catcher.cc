@@ -0,0 +1,541 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#include "crash_catcher.h"
+
+#if defined(__x86_64__)
+
+// Signals gdb would stop at, the ones a crash ends with
+static bool is_fatal_signal(int sig) {
+
+    switch (sig) {
+    case SIGSEGV:
+    case SIGBUS:
+    case SIGFPE:
+    case SIGILL:
+    case SIGABRT:
+    case SIGSYS:
+    case SIGTRAP:
+        return true;
+    }
+
+    return false;
+}
+
+#endif
+
+CRASH_MODULE *crash_catcher::get_module(const std::filesystem::path &path) {
+
+    auto it = modules.find(path);
+
+    if (it != modules.end()) {
+        return it->second.get();
+    }
+
+    auto module = std::make_unique<CRASH_MODULE>();
+
+    // Unreadable objects are cached too, as nullptr
+    if (!module->elf.open_sections(path)) {
+        modules[path] = nullptr;
+        return nullptr;
+    }
+
+    module->has_frame = module->frame.load(module->elf);
+
+    // System libraries are usually stripped, ELF::open would complain about each of them
+    size_t size;
+    if (module->elf.get_section(".symtab", size) != nullptr && module->elf.get_section(".debug_info", size) != nullptr &&
+        module->elf.get_section(".debug_line", size) != nullptr) {
+        module->has_symbols = module->symbolizer.open(path);
+    }
+
+    return (modules[path] = std::move(module)).get();
+}
+
+std::vector<CRASH_MAPPING> crash_catcher::read_maps(pid_t pid) {
+
+    std::vector<CRASH_MAPPING> maps;
+
+    // 55d0c8a4d000-55d0c8a52000 r-xp 00002000 fd:01 1234   /usr/bin/target
+    std::ifstream file("/proc/" + std::to_string(pid) + "/maps");
+
+    std::string line;
+
+    while (std::getline(file, line)) {
+
+        std::istringstream ss(line);
+
+        std::string range, perms, offset, dev, inode, path;
+
+        if (!(ss >> range >> perms >> offset >> dev >> inode)) {
+            continue;
+        }
+
+        std::getline(ss >> std::ws, path);
+
+        if (!path.starts_with("/") || perms.find('x') == std::string::npos) {
+            continue;
+        }
+
+        size_t dash = range.find('-');
+
+        maps.push_back({std::stoull(range.substr(0, dash), nullptr, 16), std::stoull(range.substr(dash + 1), nullptr, 16),
+                        std::stoull(offset, nullptr, 16), path});
+    }
+
+    return maps;
+}
+
+#if defined(__x86_64__)
+
+static bool read_word(pid_t tid, uint64_t addr, uint64_t &value) {
+
+    errno = 0;
+
+    long word = ptrace(PTRACE_PEEKDATA, tid, addr, nullptr);
+
+    if (errno != 0) {
+        return false;
+    }
+
+    value = word;
+
+    return true;
+}
+
+void crash_catcher::unwind(pid_t tid, const struct user_regs_struct &r, std::vector<CRASH_FRAME> &frames, bool symbolize) {
+
+    std::vector<CRASH_MAPPING> maps = read_maps(tid);
+
+    // DWARF register numbering, the return address column holds the pc
+    uint64_t regs[DW_REG_COUNT] = {r.rax, r.rdx, r.rcx, r.rbx, r.rsi, r.rdi, r.rbp, r.rsp, r.r8,
+                                   r.r9,  r.r10, r.r11, r.r12, r.r13, r.r14, r.r15, r.rip};
+
+    for (size_t i = 0; i < CRASH_MAX_FRAMES; i++) {
+
+        uint64_t pc = regs[DW_REG_RA];
+
+        if (pc == 0) {
+            break;
+        }
+
+        // Return addresses point after the call, which may already be the next function or line
+        uint64_t lookup_pc = i == 0 ? pc : pc - 1;
+
+        CRASH_FRAME frame;
+        frame.pc = pc;
+
+        CRASH_MODULE *module = nullptr;
+        uint64_t bias = 0;
+
+        for (const CRASH_MAPPING &mapping : maps) {
+
+            if (lookup_pc >= mapping.start && lookup_pc < mapping.end) {
+
+                module = get_module(mapping.path);
+
+                if (module != nullptr && module->elf.get_type() == ET_DYN) {
+                    bias = mapping.start - module->elf.offset_to_address(mapping.offset).value_or(mapping.offset);
+                }
+
+                frame.module = mapping.path;
+                frame.offset = pc - bias;
+                break;
+            }
+        }
+
+        if (symbolize && module != nullptr && module->has_symbols) {
+
+            auto symbol = module->symbolizer.symbolize(lookup_pc - bias);
+
+            if (symbol.has_value()) {
+                frame.function = symbol->function;
+                frame.file = symbol->file;
+                frame.line = symbol->line;
+            }
+        }
+
+        frames.push_back(frame);
+
+        uint64_t caller[DW_REG_COUNT];
+        std::copy(std::begin(regs), std::end(regs), std::begin(caller));
+
+        bool unwound = false;
+
+        if (module != nullptr && module->has_frame) {
+
+            auto row = module->frame.lookup(lookup_pc - bias);
+
+            if (row.has_value() && !row->cfa_expression && row->cfa_register < DW_REG_COUNT) {
+
+                // Outermost frame (_start, clone)
+                if (row->regs[DW_REG_RA].rule == DWARF_RULE::UNDEFINED) {
+                    break;
+                }
+
+                uint64_t cfa = regs[row->cfa_register] + row->cfa_offset;
+
+                unwound = true;
+
+                for (size_t reg = 0; reg < DW_REG_COUNT && unwound; reg++) {
+
+                    const DWARF_reg_rule &rule = row->regs[reg];
+
+                    if (rule.rule == DWARF_RULE::OFFSET) {
+                        unwound = read_word(tid, cfa + rule.value, caller[reg]);
+                    } else if (rule.rule == DWARF_RULE::VAL_OFFSET) {
+                        caller[reg] = cfa + rule.value;
+                    } else if (rule.rule == DWARF_RULE::REGISTER && rule.value < DW_REG_COUNT) {
+                        caller[reg] = regs[rule.value];
+                    }
+                }
+
+                caller[DW_REG_RSP] = cfa;
+            }
+        }
+
+        // No CFI (JIT code, PLT, vdso): [rbp] = caller rbp, [rbp + 8] = return address
+        if (!unwound) {
+
+            uint64_t rbp = regs[DW_REG_RBP];
+
+            if (rbp == 0 || !read_word(tid, rbp, caller[DW_REG_RBP]) || !read_word(tid, rbp + 8, caller[DW_REG_RA])) {
+                break;
+            }
+
+            caller[DW_REG_RSP] = rbp + 16;
+        }
+
+        // The stack grows down, a caller below the callee means the unwind went wrong
+        if (caller[DW_REG_RSP] <= regs[DW_REG_RSP]) {
+            break;
+        }
+
+        std::copy(std::begin(caller), std::end(caller), std::begin(regs));
+    }
+}
+
+#endif
+
+void crash_catcher::symbolize(CRASH_FRAME &frame, bool innermost) {
+
+    if (frame.module.empty()) {
+        return;
+    }
+
+    CRASH_MODULE *module = get_module(frame.module);
+
+    if (module == nullptr || !module->has_symbols) {
+        return;
+    }
+
+    auto symbol = module->symbolizer.symbolize(innermost ? frame.offset : frame.offset - 1);
+
+    if (symbol.has_value()) {
+        frame.function = symbol->function;
+        frame.file = symbol->file;
+        frame.line = symbol->line;
+    }
+}
+
+#if defined(__x86_64__)
+
+// State R in /proc/<tid>/stat, after the parenthesized command name
+static bool is_running(pid_t tid) {
+
+    std::ifstream file("/proc/" + std::to_string(tid) + "/stat");
+
+    std::string stat;
+    std::getline(file, stat);
+
+    size_t pos = stat.rfind(')');
+
+    return pos != std::string::npos && pos + 2 < stat.size() && stat[pos + 2] == 'R';
+}
+
+CRASH_INFO crash_catcher::run(const std::vector<std::string> &argv, size_t timeout_ms, size_t max_output, size_t sample_interval_us) {
+
+    CRASH_INFO info;
+
+    if (argv.empty()) {
+        return info;
+    }
+
+    int output_fd = memfd_create("frfuzz_crash_output", MFD_CLOEXEC);
+
+    if (output_fd < 0) {
+        perror("memfd_create");
+        return info;
+    }
+
+    // Built before fork, the child of a multithreaded process must not allocate
+    std::vector<char *> args;
+    for (const std::string &arg : argv) {
+        args.push_back((char *)arg.c_str());
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        perror("fork");
+        close(output_fd);
+        return info;
+    }
+
+    if (pid == 0) {
+
+        // Own process group, so everything the target spawns is killed with it
+        setpgid(0, 0);
+
+        int null_fd = open("/dev/null", O_RDONLY);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(output_fd, STDOUT_FILENO);
+        dup2(output_fd, STDERR_FILENO);
+
+        struct rlimit core = {0, 0};
+        setrlimit(RLIMIT_CORE, &core);
+
+        if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0) {
+            _exit(127);
+        }
+
+        // Wait for the options to be set before exec
+        raise(SIGSTOP);
+
+        execvp(args[0], args.data());
+
+        _exit(127);
+    }
+
+    int status;
+
+    if (waitpid(pid, &status, __WALL) != pid || !WIFSTOPPED(status)) {
+        close(output_fd);
+        return info;
+    }
+
+    // Threads and forked children are traced too, the crash may happen in any of them. EXITKILL: nothing survives us
+    ptrace(PTRACE_SETOPTIONS, pid, nullptr,
+           PTRACE_O_EXITKILL | PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACEEXEC);
+
+    ptrace(PTRACE_CONT, pid, nullptr, nullptr);
+
+    std::set<pid_t> tids = {pid};
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    // Polling, waitpid has no timeout. Short at first, most targets crash or exit in a few milliseconds
+    auto backoff = std::chrono::microseconds(20);
+
+    auto interval = std::chrono::microseconds(sample_interval_us);
+    auto next_sample = std::chrono::steady_clock::now() + interval;
+
+    // Threads stopped for a sample, until their SIGSTOP is seen
+    std::set<pid_t> sampling;
+
+    while (true) {
+
+        pid_t tid = waitpid(-pid, &status, __WALL | WNOHANG);
+
+        if (tid == 0) {
+
+            auto now = std::chrono::steady_clock::now();
+
+            if (timeout_ms != 0 && now > deadline) {
+                info.timed_out = true;
+                break;
+            }
+
+            if (sample_interval_us != 0 && info.started && sampling.empty() && now >= next_sample) {
+
+                for (pid_t t : tids) {
+                    if (is_running(t) && syscall(SYS_tkill, t, SIGSTOP) == 0) {
+                        sampling.insert(t);
+                    }
+                }
+
+                // Blocked: where it waits
+                if (sampling.empty() && syscall(SYS_tkill, pid, SIGSTOP) == 0) {
+                    sampling.insert(pid);
+                }
+
+                next_sample = now + interval;
+            }
+
+            auto sleep = backoff;
+
+            if (sample_interval_us != 0 && sampling.empty()) {
+                sleep = std::clamp(std::chrono::duration_cast<std::chrono::microseconds>(next_sample - now), std::chrono::microseconds(1), backoff);
+            }
+
+            std::this_thread::sleep_for(sleep);
+            backoff = std::min(backoff * 2, std::chrono::microseconds(2000));
+            continue;
+        }
+
+        if (tid < 0) {
+
+            if (errno == EINTR) {
+                continue;
+            }
+
+            break;
+        }
+
+        backoff = std::chrono::microseconds(20);
+
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+
+            tids.erase(tid);
+            sampling.erase(tid);
+
+            if (tid == pid) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (!WIFSTOPPED(status)) {
+            continue;
+        }
+
+        int sig = WSTOPSIG(status);
+
+        int event = status >> 16;
+
+        if (event != 0) {
+
+            if (event == PTRACE_EVENT_CLONE || event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK) {
+
+                unsigned long new_tid;
+                if (ptrace(PTRACE_GETEVENTMSG, tid, nullptr, &new_tid) == 0) {
+                    tids.insert(new_tid);
+                }
+
+            } else if (event == PTRACE_EVENT_EXEC) {
+                info.started = true;
+            }
+
+            ptrace(PTRACE_CONT, tid, nullptr, nullptr);
+            continue;
+        }
+
+        if (is_fatal_signal(sig) && info.started) {
+
+            info.crashed = true;
+            info.signal = sig;
+
+            siginfo_t siginfo;
+            if (sig != SIGABRT && ptrace(PTRACE_GETSIGINFO, tid, nullptr, &siginfo) == 0) {
+                info.fault_address = (uint64_t)siginfo.si_addr;
+            }
+
+            if (ptrace(PTRACE_GETREGS, tid, nullptr, &info.regs) == 0) {
+                unwind(tid, info.regs, info.frames, true);
+            }
+
+            break;
+        }
+
+        // Our own SIGSTOP, not delivered
+        if (sig == SIGSTOP && sampling.erase(tid) != 0) {
+
+            struct user_regs_struct regs;
+
+            if (ptrace(PTRACE_GETREGS, tid, nullptr, &regs) == 0) {
+                info.samples.emplace_back();
+                unwind(tid, regs, info.samples.back(), false);
+            }
+
+            ptrace(PTRACE_CONT, tid, nullptr, nullptr);
+            continue;
+        }
+
+        // New threads and children start with a SIGSTOP of their own
+        ptrace(PTRACE_CONT, tid, nullptr, sig == SIGSTOP ? nullptr : (void *)(uintptr_t)sig);
+    }
+
+    kill(-pid, SIGKILL);
+
+    for (pid_t tid : tids) {
+        kill(tid, SIGKILL);
+    }
+
+    // Reap the whole tree, including the children that left the process group
+    while (waitpid(-pid, &status, __WALL) > 0 || errno == EINTR) {
+    }
+
+    for (pid_t tid : tids) {
+        waitpid(tid, &status, __WALL);
+    }
+
+    off_t size = lseek(output_fd, 0, SEEK_END);
+
+    if (size > 0) {
+
+        info.output.resize(std::min((size_t)size, max_output));
+
+        ssize_t n = pread(output_fd, info.output.data(), info.output.size(), 0);
+
+        info.output.resize(n > 0 ? n : 0);
+    }
+
+    close(output_fd);
+
+    return info;
+}
+
+std::string crash_report(const CRASH_INFO &info) {
+
+    std::string report = "";
+
+    if (!info.crashed) {
+        return report;
+    }
+
+    report += "Program received signal SIG" + std::string(sigabbrev_np(info.signal)) + ", " + strsignal(info.signal) + ".\n";
+
+    if (info.fault_address != 0 || info.signal == SIGSEGV || info.signal == SIGBUS) {
+        report += std::format("Fault address: 0x{:x}\n", info.fault_address);
+    }
+
+    for (size_t i = 0; i < info.frames.size(); i++) {
+
+        const CRASH_FRAME &frame = info.frames[i];
+
+        report += std::format("#{:<3}0x{:016x} in {} ()", i, frame.pc, frame.function.empty() ? "??" : frame.function);
+
+        if (!frame.file.empty()) {
+            report += " at " + frame.file.string() + ":" + std::to_string(frame.line);
+        } else if (!frame.module.empty()) {
+            report += " from " + frame.module.string() + std::format(" (+0x{:x})", frame.offset);
+        }
+
+        report += "\n";
+    }
+
+    const struct user_regs_struct &r = info.regs;
+
+    const std::pair<const char *, uint64_t> regs[] = {{"rax", r.rax}, {"rbx", r.rbx}, {"rcx", r.rcx}, {"rdx", r.rdx}, {"rsi", r.rsi},
+                                                      {"rdi", r.rdi}, {"rbp", r.rbp}, {"rsp", r.rsp}, {"r8", r.r8},   {"r9", r.r9},
+                                                      {"r10", r.r10}, {"r11", r.r11}, {"r12", r.r12}, {"r13", r.r13}, {"r14", r.r14},
+                                                      {"r15", r.r15}, {"rip", r.rip}, {"eflags", r.eflags}};
+
+    report += "\n";
+
+    for (const auto &[name, value] : regs) {
+        report += std::format("{:<15}0x{:x}\n", name, value);
+    }
+
+    return report;
+}
+
+#else
+
+CRASH_INFO crash_catcher::run(const std::vector<std::string> &argv, size_t timeout_ms, size_t max_output, size_t sample_interval_us) {
+    return CRASH_INFO();
+}
+
+std::string crash_report(const CRASH_INFO &info) { return ""; }
+
+#endif
@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#pragma once
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grmELF/frame.h"
+#include "grmELF/symbolizer.h"
+
+// Frames unwound at most, deeper stacks are cut
+const size_t CRASH_MAX_FRAMES = 64;
+
+// The registers and the unwinder are x86-64 only. Elsewhere run() never starts the target (CRASH_INFO::started is false), callers fall
+// back to gdb or refuse what needs it
+#if defined(__x86_64__)
+const bool CRASH_CATCHER_SUPPORTED = true;
+#else
+const bool CRASH_CATCHER_SUPPORTED = false;
+#endif
+
+struct CRASH_FRAME {
+    uint64_t pc = 0;
+    std::filesystem::path module = "";
+    uint64_t offset = 0; // Link time address inside module
+    std::string function = "";
+    std::filesystem::path file = "";
+    size_t line = 0;
+};
+
+struct CRASH_INFO {
+    bool started = false; // false if the target could not be run under ptrace
+    bool crashed = false;
+    bool timed_out = false;
+    int signal = 0;
+    uint64_t fault_address = 0;
+    struct user_regs_struct regs = {};
+    std::vector<CRASH_FRAME> frames; // Innermost first
+    std::string output = "";         // stdout and stderr of the target
+
+    // Profiling only: stacks of the running threads at each sample, not symbolized. See crash_catcher::symbolize()
+    std::vector<std::vector<CRASH_FRAME>> samples;
+};
+
+// An ELF object mapped by the target, parsed once
+struct CRASH_MODULE {
+    ELF elf;
+    DWARF_frame frame;
+    bool has_frame = false;
+    Symbolizer symbolizer;
+    bool has_symbols = false;
+};
+
+struct CRASH_MAPPING {
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;
+    std::filesystem::path path;
+};
+
+// Runs a target under ptrace and stops it at the first fatal signal, like `gdb --batch -ex run` but without gdb: the registers are read
+// directly and the stack is unwound with the .eh_frame of each module, frame pointers as a fallback. Modules are parsed once and cached,
+// so keep one instance per worker thread. ptrace only answers the thread that started the target, run() must not be shared across threads.
+class crash_catcher {
+
+  private:
+    std::map<std::filesystem::path, std::unique_ptr<CRASH_MODULE>> modules;
+
+    CRASH_MODULE *get_module(const std::filesystem::path &path);
+
+    std::vector<CRASH_MAPPING> read_maps(pid_t pid);
+
+    void unwind(pid_t tid, const struct user_regs_struct &r, std::vector<CRASH_FRAME> &frames, bool symbolize);
+
+  public:
+    crash_catcher() {}
+
+    // argv is run directly (PATH lookup, no shell). timeout_ms = 0 means no timeout. sample_interval_us != 0 also profiles the target: the
+    // threads running at each interval are stopped and their stacks go to CRASH_INFO::samples, or the main thread's if none is running
+    CRASH_INFO run(const std::vector<std::string> &argv, size_t timeout_ms, size_t max_output = 64 * 1024 * 1024, size_t sample_interval_us = 0);
+
+    // Function, file and line of a frame unwound without them. innermost: the frame's pc is not a return address
+    void symbolize(CRASH_FRAME &frame, bool innermost);
+};
+
+// gdb-like report: the signal, the backtrace and the registers
+std::string crash_report(const CRASH_INFO &info);
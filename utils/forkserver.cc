@@ -0,0 +1,350 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#include "forkserver.h"
+
+const std::string FORKSRV_SHIM_SOURCE = R"(
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define FORKSRV_FD )" + std::to_string(FORKSRV_FD) + R"(
+
+typedef int (*main_fn)(int, char **, char **);
+
+static main_fn real_main;
+
+static int forkserver_main(int argc, char **argv, char **envp) {
+
+    const char *output_env = getenv("FRFUZZ_FORKSRV_OUTPUT");
+
+    unsetenv("LD_PRELOAD");
+
+    if (output_env == NULL || fcntl(FORKSRV_FD, F_GETFD) == -1 || fcntl(FORKSRV_FD + 1, F_GETFD) == -1) {
+        return real_main(argc, argv, envp);
+    }
+
+    char output[PATH_MAX];
+    strncpy(output, output_env, sizeof(output) - 1);
+    output[sizeof(output) - 1] = 0;
+
+    unsetenv("FRFUZZ_FORKSRV_OUTPUT");
+
+    uint32_t msg = 0;
+
+    if (write(FORKSRV_FD + 1, &msg, 4) != 4) {
+        return real_main(argc, argv, envp);
+    }
+
+    while (1) {
+
+        if (read(FORKSRV_FD, &msg, 4) != 4) {
+            _exit(0);
+        }
+
+        pid_t child = fork();
+
+        if (child < 0) {
+            _exit(1);
+        }
+
+        if (child == 0) {
+
+            close(FORKSRV_FD);
+            close(FORKSRV_FD + 1);
+
+            int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+            if (fd >= 0) {
+                dup2(fd, 1);
+                dup2(fd, 2);
+                close(fd);
+            }
+
+            return real_main(argc, argv, envp);
+        }
+
+        int32_t child_pid = child;
+        if (write(FORKSRV_FD + 1, &child_pid, 4) != 4) {
+            _exit(1);
+        }
+
+        int status;
+        if (waitpid(child, &status, 0) < 0) {
+            _exit(1);
+        }
+
+        if (write(FORKSRV_FD + 1, &status, 4) != 4) {
+            _exit(1);
+        }
+    }
+}
+
+// Constructors (sanitizer runtimes, static initializers) have already run when main is called, so they are part of the snapshot
+int __libc_start_main(main_fn main, int argc, char **argv, void (*init)(void), void (*fini)(void), void (*rtld_fini)(void), void *stack_end) {
+
+    int (*orig)(main_fn, int, char **, void (*)(void), void (*)(void), void (*)(void), void *) = dlsym(RTLD_NEXT, "__libc_start_main");
+
+    real_main = main;
+
+    return orig(forkserver_main, argc, argv, init, fini, rtld_fini, stack_end);
+}
+)";
+
+std::filesystem::path build_forkserver_shim(std::filesystem::path folder) {
+
+    std::filesystem::path shim = folder / (FORKSRV_SHIM_NAME + ".so");
+
+    if (std::filesystem::exists(shim)) {
+        return shim;
+    }
+
+    std::filesystem::path source = folder / (FORKSRV_SHIM_NAME + ".c");
+    std::filesystem::path tmp = folder / (FORKSRV_SHIM_NAME + ".so.tmp");
+
+    if (!write_file(source.string(), FORKSRV_SHIM_SOURCE)) {
+        std::cerr << "Error: could not write " << source << std::endl;
+        return "";
+    }
+
+    std::string output = run("cc -shared -fPIC -O2 -o " + bash_escape(tmp.string()) + " " + bash_escape(source.string()) + " -ldl");
+
+    if (!std::filesystem::exists(tmp)) {
+        std::cerr << "Error: could not compile the forkserver shim" << std::endl;
+        std::cerr << output << std::endl;
+        return "";
+    }
+
+    std::filesystem::rename(tmp, shim);
+
+    return shim;
+}
+
+bool forkserver::start(std::string command, std::filesystem::path shim, const std::vector<std::string> &extra_env) {
+
+    char dir_template[] = "/tmp/frfuzz_forkserver_XXXXXX";
+
+    if (mkdtemp(dir_template) == nullptr) {
+        perror("mkdtemp");
+        return false;
+    }
+
+    work_dir = dir_template;
+    input_file = work_dir / "cur_input";
+    output_file = work_dir / "output";
+
+    if (command.find("@@") == std::string::npos) {
+        command += " @@";
+    }
+
+    size_t pos;
+    while ((pos = command.find("@@")) != std::string::npos) {
+        command.replace(pos, 2, bash_escape(input_file.string()));
+    }
+
+    // The variable prefix only reaches the exec'd target, not bash itself
+    std::string preload = shim.string();
+
+    const char *current_preload = getenv("LD_PRELOAD");
+    if (current_preload != nullptr && current_preload[0] != '\0') {
+        preload += ":" + std::string(current_preload);
+    }
+
+    std::string script = "LD_PRELOAD=" + bash_escape(preload) + " exec " + command;
+
+    int ctl_pipe[2];
+    int st_pipe[2];
+
+    if (pipe2(ctl_pipe, O_CLOEXEC) != 0 || pipe2(st_pipe, O_CLOEXEC) != 0) {
+        perror("pipe2");
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, ctl_pipe[0], FORKSRV_FD);
+    posix_spawn_file_actions_adddup2(&actions, st_pipe[1], FORKSRV_FD + 1);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    // ASAN refuses to start when it is not the first preloaded library
+    std::vector<std::string> env = merge_environment(extra_env);
+    bool asan_options = false;
+
+    for (auto &e : env) {
+
+        if (e.starts_with("ASAN_OPTIONS=")) {
+            e += ":verify_asan_link_order=0";
+            asan_options = true;
+        }
+    }
+
+    if (!asan_options) {
+        env.push_back("ASAN_OPTIONS=verify_asan_link_order=0");
+    }
+
+    env.push_back("FRFUZZ_FORKSRV_OUTPUT=" + output_file.string());
+
+    std::vector<char *> envp;
+    for (auto &e : env) {
+        envp.push_back(e.data());
+    }
+    envp.push_back(nullptr);
+
+    char *argv[] = {(char *)"bash", (char *)"-c", script.data(), nullptr};
+
+    int ret = posix_spawn(&pid, "/bin/bash", &actions, nullptr, argv, envp.data());
+
+    posix_spawn_file_actions_destroy(&actions);
+
+    close(ctl_pipe[0]);
+    close(st_pipe[1]);
+
+    ctl_fd = ctl_pipe[1];
+    st_fd = st_pipe[0];
+
+    if (ret != 0) {
+        std::cerr << "posix_spawn error: " << strerror(ret) << std::endl;
+        pid = -1;
+        stop();
+        return false;
+    }
+
+    // Hello message. The target may not be dynamically linked, or the shim may not be loaded
+    int32_t hello;
+    if (!read_status(hello, 10000)) {
+        stop();
+        return false;
+    }
+
+    return true;
+}
+
+void forkserver::stop() {
+
+    if (ctl_fd != -1) {
+        close(ctl_fd);
+        ctl_fd = -1;
+    }
+
+    if (st_fd != -1) {
+        close(st_fd);
+        st_fd = -1;
+    }
+
+    if (pid > 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        pid = -1;
+    }
+
+    if (!work_dir.empty()) {
+        std::error_code ec;
+        std::filesystem::remove_all(work_dir, ec);
+        work_dir.clear();
+    }
+}
+
+// timeout_ms = -1 means no timeout
+// A write to a dead forkserver must fail with EPIPE, not kill us. SIGPIPE is blocked for this thread only while writing, and the one the
+// write raised is consumed, so the disposition of the process is left alone
+static bool write_control(int fd, uint32_t msg) {
+
+    sigset_t sigpipe, old_mask, pending;
+
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+
+    pthread_sigmask(SIG_BLOCK, &sigpipe, &old_mask);
+
+    // One already pending is not ours
+    sigpending(&pending);
+    bool was_pending = sigismember(&pending, SIGPIPE);
+
+    ssize_t n = write(fd, &msg, 4);
+
+    if (n == -1 && errno == EPIPE && !was_pending) {
+        struct timespec zero = {};
+        sigtimedwait(&sigpipe, nullptr, &zero);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+
+    return n == 4;
+}
+
+bool forkserver::read_status(int32_t &value, int timeout_ms) {
+
+    struct pollfd pfd = {st_fd, POLLIN, 0};
+
+    int ret;
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret == -1 && errno == EINTR);
+
+    if (ret <= 0) {
+        return false;
+    }
+
+    return read(st_fd, &value, 4) == 4;
+}
+
+std::string forkserver::run(const std::filesystem::path &input, size_t timeout_ms, bool *timed_out) {
+
+    if (timed_out != nullptr) {
+        *timed_out = false;
+    }
+
+    if (!is_running()) {
+        return "";
+    }
+
+    std::error_code ec;
+    std::filesystem::copy_file(input, input_file, std::filesystem::copy_options::overwrite_existing, ec);
+
+    if (ec) {
+        std::cerr << "Error: could not copy " << input << " to " << input_file << std::endl;
+        return "";
+    }
+
+    uint32_t msg = 0;
+
+    int32_t child_pid;
+    int32_t status;
+
+    if (!write_control(ctl_fd, msg) || !read_status(child_pid, 10000)) {
+        std::cerr << "Error: the forkserver died" << std::endl;
+        stop();
+        return "";
+    }
+
+    if (!read_status(status, timeout_ms == 0 ? -1 : timeout_ms)) {
+
+        kill(child_pid, SIGKILL);
+
+        if (timed_out != nullptr) {
+            *timed_out = true;
+        }
+
+        if (!read_status(status, -1)) {
+            std::cerr << "Error: the forkserver died" << std::endl;
+            stop();
+            return "";
+        }
+    }
+
+    std::ifstream file(output_file, std::ios::binary);
+
+    std::string output((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // Same report the shell gives for a killed process
+    if (WIFSIGNALED(status)) {
+        output += std::string(strsignal(WTERMSIG(status))) + "\n";
+    }
+
+    return output;
+}
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "utils/process.h"
+
+// Control and status pipes of the forkserver. Not AFL's 198/199, so AFL-instrumented builds keep running normally under the shim
+const int FORKSRV_FD = 220;
+
+// Bump the version when the shim changes, so the cached library gets rebuilt
+const std::string FORKSRV_SHIM_NAME = "forkserver_shim_v1";
+
+// Builds (once) the LD_PRELOAD shim into folder and returns its path, or "" if it could not be compiled
+std::filesystem::path build_forkserver_shim(std::filesystem::path folder);
+
+// Replays inputs against a non-AFL binary without paying exec + dynamic linking for each one. The shim stops the target right before main()
+// and forks a fresh child from that snapshot for every input. Inputs are delivered through a fixed file that replaces "@@" in the command.
+class forkserver {
+
+  private:
+    pid_t pid = -1;
+
+    int ctl_fd = -1;
+    int st_fd = -1;
+
+    std::filesystem::path work_dir;
+    std::filesystem::path input_file;
+    std::filesystem::path output_file;
+
+    bool read_status(int32_t &value, int timeout_ms);
+
+  public:
+    forkserver() {}
+
+    ~forkserver() { stop(); }
+
+    // command is the target command line, with "@@" where the input goes (appended at the end if missing)
+    // env: "NAME=value" entries added to the environment of the target
+    bool start(std::string command, std::filesystem::path shim, const std::vector<std::string> &env = {});
+
+    void stop();
+
+    inline bool is_running() const { return pid > 0; }
+
+    // Combined stdout and stderr of the run. timeout_ms = 0 means no timeout. timed_out, if given, is set when the child had to be killed
+    std::string run(const std::filesystem::path &input, size_t timeout_ms, bool *timed_out = nullptr);
+};
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#include "minimizer.h"
+
+size_t minimizer::first_removable(const std::string &input, size_t num_chunks) {
+
+    std::atomic<size_t> next = 0;
+    std::atomic<size_t> found = num_chunks;
+
+    auto worker = [&](size_t id) {
+        std::string candidate;
+
+        // Chunks after an accepted one are skipped, those before it still run: one of them may be accepted too and come first
+        for (size_t i = next++; i < found; i = next++) {
+
+            size_t begin = i * input.size() / num_chunks;
+            size_t end = (i + 1) * input.size() / num_chunks;
+
+            candidate.assign(input, 0, begin);
+            candidate.append(input, end);
+
+            runs++;
+
+            if (!oracle(id, candidate)) {
+                continue;
+            }
+
+            size_t current = found;
+
+            while (i < current && !found.compare_exchange_weak(current, i)) {
+            }
+        }
+    };
+
+    size_t num_threads = std::min(num_workers, num_chunks);
+
+    if (num_threads == 1) {
+        worker(0);
+        return found;
+    }
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < num_threads; i++) {
+        threads.push_back(std::thread(worker, i));
+    }
+
+    for (auto &th : threads) {
+        th.join();
+    }
+
+    return found;
+}
+
+std::string minimizer::minimize(const std::string &input) {
+
+    std::string current = input;
+
+    size_t num_chunks = 2;
+
+    while (current.size() >= 2) {
+
+        num_chunks = std::min(num_chunks, current.size());
+
+        size_t i = first_removable(current, num_chunks);
+
+        if (i < num_chunks) {
+
+            size_t begin = i * current.size() / num_chunks;
+            size_t end = (i + 1) * current.size() / num_chunks;
+
+            current.erase(begin, end - begin);
+
+            num_chunks = std::max<size_t>(num_chunks - 1, 2);
+
+        } else if (num_chunks == current.size()) {
+            // No single byte can go
+            break;
+
+        } else {
+            num_chunks = std::min(num_chunks * 2, current.size());
+        }
+    }
+
+    return current;
+}
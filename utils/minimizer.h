@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Delta debugging (Zeller and Hildebrandt, ddmin) over the bytes of an input. Each round splits the input in n chunks and tries it without
+// each of them: the n candidates are independent, so they run on all the workers at once and the first one (in chunk order) that the oracle
+// accepts wins, which keeps the result the same as the sequential algorithm.
+class minimizer {
+
+  public:
+    // Runs candidate and returns true if it still shows the bug. Called from several threads at once, worker is in [0, num_workers) and
+    // no two calls share it
+    typedef std::function<bool(size_t worker, const std::string &candidate)> ORACLE;
+
+    minimizer(size_t num_workers, ORACLE oracle) : num_workers(std::max<size_t>(num_workers, 1)), oracle(oracle) {}
+
+    // input is assumed to show the bug
+    std::string minimize(const std::string &input);
+
+    inline size_t executions() const { return runs; }
+
+  private:
+    size_t num_workers;
+
+    ORACLE oracle;
+
+    std::atomic<size_t> runs = 0;
+
+    // Index of the first chunk of input whose removal the oracle accepts, or num_chunks
+    size_t first_removable(const std::string &input, size_t num_chunks);
+};
@@ -0,0 +1,220 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#include "pattern_matcher.h"
+
+pattern_matcher::pattern_matcher(const std::vector<std::string_view> &patterns) {
+
+    for (std::string_view pattern : patterns) {
+        add(pattern);
+    }
+
+    compile();
+}
+
+size_t pattern_matcher::add(std::string_view pattern) {
+
+    for (size_t id = 0; id < patterns.size(); id++) {
+        if (patterns[id] == pattern) {
+            return id;
+        }
+    }
+
+    patterns.emplace_back(pattern);
+
+    delta.clear();
+
+    return patterns.size() - 1;
+}
+
+void pattern_matcher::compile() {
+
+    // Class 0 is every byte that is in no pattern, it always leads back to the root
+    byte_class.fill(0);
+    num_classes = 1;
+
+    for (const std::string &pattern : patterns) {
+        for (unsigned char c : pattern) {
+            if (byte_class[c] == 0) {
+                byte_class[c] = num_classes++;
+            }
+        }
+    }
+
+    // Trie, NO_PATTERN for missing edges
+    std::vector<uint32_t> trie(num_classes, NO_PATTERN);
+    output.assign(1, NO_PATTERN);
+
+    for (size_t id = 0; id < patterns.size(); id++) {
+
+        if (patterns[id].empty()) {
+            continue;
+        }
+
+        uint32_t state = 0;
+
+        for (unsigned char c : patterns[id]) {
+
+            uint32_t &next = trie[state * num_classes + byte_class[c]];
+
+            if (next == NO_PATTERN) {
+                next = output.size();
+                output.push_back(NO_PATTERN);
+                trie.resize(trie.size() + num_classes, NO_PATTERN);
+            }
+
+            // trie may have moved
+            state = trie[state * num_classes + byte_class[c]];
+        }
+
+        output[state] = id;
+    }
+
+    size_t num_states = output.size();
+
+    // Failure links in breadth first order, so that the failure state of each state is complete before its children. Missing edges are
+    // replaced by the edge of the failure state, which gives the full automaton
+    delta.assign(num_states * num_classes, 0);
+    output_link.assign(num_states, 0);
+
+    std::vector<uint32_t> fail(num_states, 0);
+    std::vector<uint32_t> queue = {0};
+
+    for (size_t i = 0; i < queue.size(); i++) {
+
+        uint32_t state = queue[i];
+
+        for (size_t c = 0; c < num_classes; c++) {
+
+            uint32_t next = trie[state * num_classes + c];
+
+            if (next == NO_PATTERN) {
+                delta[state * num_classes + c] = state == 0 ? 0 : delta[fail[state] * num_classes + c];
+                continue;
+            }
+
+            fail[next] = state == 0 ? 0 : delta[fail[state] * num_classes + c];
+            output_link[next] = output[fail[next]] != NO_PATTERN ? fail[next] : output_link[fail[next]];
+
+            delta[state * num_classes + c] = next;
+            queue.push_back(next);
+        }
+    }
+
+    start_bytes.clear();
+
+    for (size_t c = 0; c < 256; c++) {
+        if (delta[byte_class[c]] != 0) {
+            start_bytes.push_back(c);
+        }
+    }
+
+#if defined(__SSE2__)
+    num_start_vectors = 0;
+
+    if (start_bytes.size() <= PATTERN_MAX_SIMD_START_BYTES) {
+        for (uint8_t c : start_bytes) {
+            start_vectors[num_start_vectors++] = _mm_set1_epi8(c);
+        }
+    }
+#endif
+}
+
+const uint8_t *pattern_matcher::skip(const uint8_t *ptr, const uint8_t *end) const {
+
+#if defined(__SSE2__)
+    if (num_start_vectors != 0) {
+
+        for (; ptr + 16 <= end; ptr += 16) {
+
+            __m128i block = _mm_loadu_si128((const __m128i *)ptr);
+            __m128i hits = _mm_setzero_si128();
+
+            for (size_t i = 0; i < num_start_vectors; i++) {
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, start_vectors[i]));
+            }
+
+            int mask = _mm_movemask_epi8(hits);
+
+            if (mask != 0) {
+                return ptr + __builtin_ctz(mask);
+            }
+        }
+    }
+#endif
+
+    while (ptr < end && delta[byte_class[*ptr]] == 0) {
+        ptr++;
+    }
+
+    return ptr;
+}
+
+template <typename F> void pattern_matcher::scan(std::string_view text, F on_match) const {
+
+    if (delta.empty() || start_bytes.empty()) {
+        return;
+    }
+
+    const uint8_t *begin = (const uint8_t *)text.data();
+    const uint8_t *end = begin + text.size();
+
+    uint32_t state = 0;
+
+    for (const uint8_t *ptr = begin; ptr < end;) {
+
+        if (state == 0 && (ptr = skip(ptr, end)) == end) {
+            break;
+        }
+
+        state = delta[state * num_classes + byte_class[*ptr++]];
+
+        // The pattern of the state itself is the longest, then the shorter ones down the suffix chain
+        for (uint32_t s = output[state] != NO_PATTERN ? state : output_link[state]; s != 0; s = output_link[s]) {
+            if (!on_match(output[s], ptr - begin)) {
+                return;
+            }
+        }
+    }
+}
+
+std::optional<PATTERN_MATCH> pattern_matcher::find_first(std::string_view text) const {
+
+    std::optional<PATTERN_MATCH> match;
+
+    scan(text, [&](size_t id, size_t end) {
+        match = PATTERN_MATCH{id, end - patterns[id].size()};
+        return false;
+    });
+
+    return match;
+}
+
+std::vector<PATTERN_MATCH> pattern_matcher::find_all(std::string_view text) const {
+
+    std::vector<size_t> offsets(patterns.size(), std::string_view::npos);
+
+    size_t remaining = 0;
+
+    for (const std::string &pattern : patterns) {
+        remaining += !pattern.empty();
+    }
+
+    scan(text, [&](size_t id, size_t end) {
+
+        if (offsets[id] == std::string_view::npos) {
+            offsets[id] = end - patterns[id].size();
+            remaining--;
+        }
+
+        return remaining != 0;
+    });
+
+    std::vector<PATTERN_MATCH> matches;
+
+    for (size_t id = 0; id < offsets.size(); id++) {
+        if (offsets[id] != std::string_view::npos) {
+            matches.push_back({id, offsets[id]});
+        }
+    }
+
+    return matches;
+}
@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: AGPL-3.0-only */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct PATTERN_MATCH {
+    size_t id;     // Index of the pattern, in the order they were added
+    size_t offset; // Where the occurrence starts in the text
+};
+
+// Bytes the scan can skip with SIMD while no pattern is being matched: beyond that, checking each block costs more than the lookups
+const size_t PATTERN_MAX_SIMD_START_BYTES = 16;
+
+// Aho-Corasick automaton over a fixed set of patterns, compiled to a dense transition table: the text is scanned once whatever the number of
+// patterns, one lookup per byte. Bytes that are in no pattern share a class, which keeps the table small. While no pattern is being matched,
+// blocks of text without any first byte of a pattern are skipped 16 at a time (SSE2).
+class pattern_matcher {
+
+  public:
+    pattern_matcher() {}
+
+    explicit pattern_matcher(const std::vector<std::string_view> &patterns);
+
+    // Returns the id of the pattern, the one it already has if added before. Empty patterns never match
+    size_t add(std::string_view pattern);
+
+    // Again after add(), the matcher finds nothing until then
+    void compile();
+
+    inline size_t size() const { return patterns.size(); }
+
+    inline const std::string &pattern(size_t id) const { return patterns[id]; }
+
+    // The occurrence that ends first. For the same end, the longest pattern
+    std::optional<PATTERN_MATCH> find_first(std::string_view text) const;
+
+    // Every pattern found in text, at its first occurrence, sorted by id
+    std::vector<PATTERN_MATCH> find_all(std::string_view text) const;
+
+  private:
+    static const uint32_t NO_PATTERN = UINT32_MAX;
+
+    std::vector<std::string> patterns;
+
+    std::array<uint16_t, 256> byte_class = {}; // 0 for bytes in no pattern, up to 256 other classes
+    size_t num_classes = 1;
+
+    // state * num_classes + class -> state. State 0 is the root
+    std::vector<uint32_t> delta;
+
+    // Longest pattern ending at the state, and the next state down its suffix chain that ends a pattern
+    std::vector<uint32_t> output;
+    std::vector<uint32_t> output_link;
+
+    std::vector<uint8_t> start_bytes;
+
+#if defined(__SSE2__)
+    // Each start byte broadcast to a vector. A fixed array: the alignment attribute of __m128i would be dropped as a template argument
+    alignas(16) __m128i start_vectors[PATTERN_MAX_SIMD_START_BYTES];
+    size_t num_start_vectors = 0; // 0 if there are too many start bytes to skip with SIMD
+#endif
+
+    // Next byte at or after ptr that starts a pattern, or end
+    const uint8_t *skip(const uint8_t *ptr, const uint8_t *end) const;
+
+    // Calls on_match(id, end offset) for each pattern ending at each position, until it returns false
+    template <typename F> void scan(std::string_view text, F on_match) const;
+};
@@ -171,50 +171,354 @@ void execute(char *argv[]) {
     }
 }
 
-std::string run(std::string command) {
+std::vector<std::string> merge_environment(const std::vector<std::string> &env) {
 
-    command += " 2>&1";
+    std::vector<std::string> merged;
 
-    const size_t BUFFER_SIZE = 4096;
+    for (char **e = environ; *e != nullptr; e++) {
 
+        std::string_view entry = *e;
+        std::string_view name = entry.substr(0, entry.find('=') + 1);
+
+        if (std::none_of(env.begin(), env.end(), [&](const std::string &var) { return var.starts_with(name); })) {
+            merged.push_back(*e);
+        }
+    }
+
+    merged.insert(merged.end(), env.begin(), env.end());
+
+    return merged;
+}
+
+EXEC_RESULT execute(const std::vector<std::string> &argv, const EXEC_OPTIONS &options) {
+
+    EXEC_RESULT result;
+
+    if (argv.empty()) {
+        return result;
+    }
+
+    // stdout and stderr share one pipe, like 2>&1: a report stays in order with the output around it
+    int out_pipe[2];
+
+    if (pipe2(out_pipe, O_CLOEXEC) != 0) {
+        perror("pipe2");
+        return result;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (options.null_stdin) {
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    }
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDERR_FILENO);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    if (options.process_group) {
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+
+    std::vector<char *> args;
+    for (auto &arg : argv) {
+        args.push_back((char *)arg.c_str());
+    }
+    args.push_back(nullptr);
+
+    char **envp = environ;
+
+    std::vector<std::string> env;
+    std::vector<char *> env_ptrs;
+
+    if (!options.env.empty()) {
+
+        env = merge_environment(options.env);
+
+        for (auto &e : env) {
+            env_ptrs.push_back(e.data());
+        }
+
+        env_ptrs.push_back(nullptr);
+        envp = env_ptrs.data();
+    }
+
+    pid_t pid;
+
+    int ret = posix_spawnp(&pid, args[0], &actions, &attr, args.data(), envp);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    close(out_pipe[1]);
+
+    if (ret != 0) {
+        close(out_pipe[0]);
+        return result;
+    }
+
+    result.started = true;
+
+    // posix_spawn returns once the child has exec'd, so the limits apply from the dynamic loader on
+    struct rlimit core_limit = {options.max_core, options.max_core};
+    prlimit(pid, RLIMIT_CORE, &core_limit, nullptr);
+
+    if (options.max_memory != RLIM_INFINITY) {
+        struct rlimit memory_limit = {options.max_memory, options.max_memory};
+        prlimit(pid, RLIMIT_AS, &memory_limit, nullptr);
+    }
+
+    // Kernels older than 5.3 don't have pidfd_open: the exit is then noticed when the pipe is closed
+    int pid_fd = syscall(SYS_pidfd_open, pid, 0);
+
+    int timer_fd = -1;
+
+    if (options.timeout_ms > 0) {
+
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+        struct itimerspec spec = {};
+        spec.it_value.tv_sec = options.timeout_ms / 1000;
+        spec.it_value.tv_nsec = (options.timeout_ms % 1000) * 1000000;
+
+        timerfd_settime(timer_fd, 0, &spec, nullptr);
+    }
+
+    int out_fd = out_pipe[0];
+
+    const size_t BUFFER_SIZE = 65536;
     char buffer[BUFFER_SIZE];
-    std::string result;
 
-    // std::cout << "Command: " << command << std::endl;
+    // Bytes read, 0 if the pipe was closed, -1 if there was nothing to read
+    auto read_pipe = [&](int &fd) -> ssize_t {
+        ssize_t n = read(fd, buffer, BUFFER_SIZE);
 
-    // std::cout << "Opening reading pipe" << std::endl;
-    FILE *pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        std::cerr << "Couldn't start command." << std::endl;
-        std::cerr << "Command: " << command << std::endl;
-        return "";
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+            return -1;
+        }
+
+        if (n <= 0) {
+            close(fd);
+            fd = -1;
+            return 0;
+        }
+
+        size_t room = options.max_output - std::min(options.max_output, result.output.size());
+
+        if ((size_t)n > room) {
+            result.truncated = true;
+        }
+
+        result.output.append(buffer, std::min((size_t)n, room));
+
+        return n;
+    };
+
+    bool exited = false;
+
+    while (!exited && out_fd != -1) {
+
+        struct pollfd pfds[3];
+        nfds_t nfds = 0;
+
+        pfds[nfds++] = {out_fd, POLLIN, 0};
+
+        if (pid_fd != -1) {
+            pfds[nfds++] = {pid_fd, POLLIN, 0};
+        }
+
+        if (timer_fd != -1 && !result.timed_out) {
+            pfds[nfds++] = {timer_fd, POLLIN, 0};
+        }
+
+        if (poll(pfds, nfds, -1) < 0) {
+
+            if (errno == EINTR) {
+                continue;
+            }
+
+            perror("poll");
+            break;
+        }
+
+        for (nfds_t i = 0; i < nfds; i++) {
+
+            if (pfds[i].revents == 0) {
+                continue;
+            }
+
+            if (pfds[i].fd == pid_fd) {
+                exited = true;
+
+            } else if (pfds[i].fd == timer_fd) {
+                result.timed_out = true;
+                kill(options.process_group ? -pid : pid, SIGKILL);
+
+            } else {
+                read_pipe(out_fd);
+            }
+        }
     }
 
-    while (fgets(buffer, BUFFER_SIZE, pipe) != NULL) {
-        // std::cout << "Reading..." << std::endl;
-        result += buffer;
+    // Whatever the child wrote is already in the pipe. Descendants still holding it open are not waited for
+    if (out_fd != -1) {
+
+        fcntl(out_fd, F_SETFL, O_NONBLOCK);
+
+        while (read_pipe(out_fd) > 0) {
+        }
+
+        if (out_fd != -1) {
+            close(out_fd);
+        }
+    }
+
+    int status = 0;
+
+    while (wait4(pid, &status, 0, &result.usage) == -1 && errno == EINTR) {
+    }
+
+    if (WIFEXITED(status)) {
+        result.exit_code = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        result.signal = WTERMSIG(status);
     }
 
-    auto returnCode = pclose(pipe);
+    if (pid_fd != -1) {
+        close(pid_fd);
+    }
 
-    // std::cout << result.length() << std::endl;
-    //  std::cout << returnCode << std::endl;
+    if (timer_fd != -1) {
+        close(timer_fd);
+    }
 
     return result;
 }
 
-// timeout_ms = 0 means no timeout
-std::string run(std::string command, size_t timeout_ms) {
+std::optional<std::vector<std::string>> split_command(const std::string &command) {
+
+    std::vector<std::string> argv;
+
+    std::string word;
+    bool in_word = false;
+
+    for (size_t i = 0; i < command.size(); i++) {
+
+        char c = command[i];
+
+        if (c == ' ' || c == '\t') {
+
+            if (in_word) {
+                argv.push_back(word);
+                word = "";
+                in_word = false;
+            }
+
+        } else if (c == '\'') {
+
+            size_t end = command.find('\'', i + 1);
+            if (end == std::string::npos) {
+                return std::nullopt;
+            }
+
+            word += command.substr(i + 1, end - i - 1);
+            in_word = true;
+            i = end;
+
+        } else if (c == '"') {
+
+            in_word = true;
+
+            for (i++; i < command.size() && command[i] != '"'; i++) {
+
+                if (command[i] == '$' || command[i] == '`') {
+                    return std::nullopt;
+                }
+
+                if (command[i] == '\\' && i + 1 < command.size() && std::string("\"\\$`").find(command[i + 1]) != std::string::npos) {
+                    i++;
+                }
+
+                word += command[i];
+            }
+
+            if (i == command.size()) {
+                return std::nullopt;
+            }
+
+        } else if (c == '\\') {
+
+            if (i + 1 == command.size() || command[i + 1] == '\n') {
+                return std::nullopt;
+            }
+
+            word += command[++i];
+            in_word = true;
+
+        } else if (std::string("|&;<>()$`*?[]{}~#!\n").find(c) != std::string::npos) {
+            return std::nullopt;
+
+        } else {
+            word += c;
+            in_word = true;
+        }
+    }
+
+    if (in_word) {
+        argv.push_back(word);
+    }
+
+    // Variable assignments before the command
+    if (argv.empty() || argv[0].find('=') != std::string::npos) {
+        return std::nullopt;
+    }
+
+    return argv;
+}
+
+static std::string run(const std::string &command, const EXEC_OPTIONS &options, bool *timed_out) {
+
+    std::optional<std::vector<std::string>> argv = split_command(command);
+
+    if (!argv.has_value()) {
+        argv = {"/bin/sh", "-c", command};
+    }
+
+    EXEC_RESULT result = execute(argv.value(), options);
+
+    if (timed_out != nullptr) {
+        *timed_out = result.timed_out;
+    }
+
+    if (!result.started) {
+        std::cerr << "Couldn't start command." << std::endl;
+        std::cerr << "Command: " << command << std::endl;
+        return "";
+    }
+
+    // Same report the shell gives for a killed process
+    if (result.signal != 0 && !result.timed_out) {
+        result.output += std::string(strsignal(result.signal)) + "\n";
+    }
+
+    return result.output;
+}
+
+std::string run(std::string command) { return run(command, EXEC_OPTIONS(), nullptr); }
 
-    float seconds = timeout_ms / 1000.0;
+std::string run(std::string command, size_t timeout_ms, bool *timed_out) {
 
-    command = "timeout " + std::to_string(seconds) + " " + command;
+    EXEC_OPTIONS options;
+    options.timeout_ms = timeout_ms;
+    options.null_stdin = true;
+    options.process_group = true;
 
-    return run(command);
+    return run(command, options, timed_out);
 }
 
 void run_thread(size_t thread_id, const std::vector<std::filesystem::path> &input_files, size_t posInicial, size_t posFinal,
-                std::string partial_command, size_t timeout) {
+                std::string partial_command, size_t timeout, std::filesystem::path forkserver_shim, std::vector<std::string> env) {
 
     size_t num_elements = posFinal - posInicial + 1;
 
@@ -231,8 +535,27 @@ void run_thread(size_t thread_id, const std::vector<std::filesystem::path> &inpu
         cmd_split2 = partial_command.substr(pos + 2);
     }
 
+    forkserver fsrv;
+
+    if (!forkserver_shim.empty() && !fsrv.start(partial_command, forkserver_shim, env)) {
+        std::cerr << "Warning: could not start the forkserver, running a new process per input" << std::endl;
+    }
+
     for (int i = posInicial; i <= posFinal; i++) {
 
+        if (thread_id == 0 && i % 1000 == 0) {
+            debug() << "Current run: " << i - posInicial + 1 << " / " << num_elements << std::endl;
+        }
+
+        if (fsrv.is_running()) {
+
+            fsrv.run(input_files[i], timeout);
+
+            if (fsrv.is_running()) {
+                continue;
+            }
+        }
+
         std::string command;
 
         if (has_at) {
@@ -246,13 +569,23 @@ void run_thread(size_t thread_id, const std::vector<std::filesystem::path> &inpu
             command = partial_command + bash_escape(input_files[i].string());
         }
 
-        if (thread_id == 0 && i % 1000 == 0) {
-            debug() << "Current run: " << i - posInicial + 1 << " / " << num_elements << std::endl;
+        // std::cout << "Running command: " << command << std::endl;
+
+        std::optional<std::vector<std::string>> argv = split_command(command);
+
+        if (!argv.has_value()) {
+            argv = {"/bin/sh", "-c", command};
         }
 
-        // std::cout << "Running command: " << command << std::endl;
+        // Only the coverage counters matter, not the output
+        EXEC_OPTIONS options;
+        options.timeout_ms = timeout;
+        options.max_output = 0;
+        options.env = env;
+        options.null_stdin = true;
+        options.process_group = true;
 
-        run(command, timeout);
+        execute(argv.value(), options);
     }
 }
 
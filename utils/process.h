@@ -20,13 +20,22 @@
 #include <string.h>
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "utils/debug.h"
 #include "utils/filesys.h"
+#include "utils/forkserver.h"
 
 int launch_terminal(int width, int height, int X, int Y, char const *cmd);
 int launch_terminal(int width, int height, int X, int Y, std::string cmd, std::string custom_env);
@@ -36,12 +45,47 @@ std::string bash_escape(const std::string &s);
 
 void execute(char *argv[]);
 
+struct EXEC_OPTIONS {
+    size_t timeout_ms = 0;                // 0 means no timeout
+    size_t max_output = 64 * 1024 * 1024; // Bytes of output kept, the rest is read and dropped
+    rlim_t max_memory = RLIM_INFINITY;    // RLIMIT_AS of the child
+    rlim_t max_core = 0;                  // RLIMIT_CORE of the child
+    std::vector<std::string> env = {};    // "NAME=value" entries added to the environment of the child
+
+    // For targets being replayed: a run must not wait on the terminal, and a timeout kills the whole tree. Off for tools (make, lcov...),
+    // which keep the terminal's stdin and get its Ctrl-C
+    bool null_stdin = false;    // stdin from /dev/null
+    bool process_group = false; // In its own process group
+};
+
+struct EXEC_RESULT {
+    std::string output = ""; // stdout and stderr, interleaved as written
+    bool started = false;
+    int exit_code = -1; // -1 if the process was killed by a signal
+    int signal = 0;
+    bool timed_out = false;
+    bool truncated = false;
+    struct rusage usage = {};
+};
+
+// environ with the "NAME=value" entries of env, which replace the variables of the same name
+std::vector<std::string> merge_environment(const std::vector<std::string> &env);
+
+// Spawns argv directly (PATH lookup, no shell), with stdout and stderr on the same pipe
+EXEC_RESULT execute(const std::vector<std::string> &argv, const EXEC_OPTIONS &options);
+
+// Shell-like word splitting of command. nullopt if it needs an actual shell (pipes, redirections, variables, globs...)
+std::optional<std::vector<std::string>> split_command(const std::string &command);
+
 std::string run(std::string command);
 
-std::string run(std::string command, size_t timeout_ms);
+// For replaying targets: stdin from /dev/null and its own process group, killed as a whole on timeout. timeout_ms = 0 means no timeout
+// timed_out, if given, is set when the run was killed for exceeding timeout_ms
+std::string run(std::string command, size_t timeout_ms, bool *timed_out = nullptr);
 
+// forkserver_shim = "" runs every input in a new process. env: "NAME=value" entries added to the environment of the target
 void run_thread(size_t thread_id, const std::vector<std::filesystem::path> &input_files, size_t posInicial, size_t posFinal,
-                std::string partial_command, size_t timeout);
+                std::string partial_command, size_t timeout, std::filesystem::path forkserver_shim = "", std::vector<std::string> env = {});
 
 class process {
 
@@ -13,6 +13,7 @@
 #include <vector>
 
 #include <string.h>
+#include <sys/mman.h>
 #include <termios.h>
 
 #include <openssl/sha.h>
@@ -21,6 +22,12 @@
 
 std::array<unsigned char, 20> git_hash_object(std::filesystem::path p);
 
+// XXH64. Fast non-cryptographic hash, for content comparison only
+uint64_t xxhash64(const void *data, size_t size, uint64_t seed = 0);
+
+// xxhash64 of the file contents, read through mmap
+bool hash_file(const std::filesystem::path &path, uint64_t &hash);
+
 uint32_t HexToBytes(const std::string &hex, uint8_t *outBuf);
 
 std::string hex_decode(const std::string &hex);